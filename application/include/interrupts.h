@@ -13,6 +13,7 @@ Interrupt request handlers
 
 /* DEPENDENCIES */
 #include "stm32g0xx_hal.h"          // STM32G0 hardware abstraction layer
+#include "bootloader_common.h"      // Dispatch table for application-accessible bootloader functions
 
 /* CONSTANT DEFINITIONS AND MACROS */
 
@@ -24,6 +25,8 @@ Interrupt request handlers
 
 
 /* FUNCTIONS */
+__attribute__((naked)) void HardFault_Handler();
 void SysTick_Handler();
+void FLASH_IRQHandler();
 
 #endif
\ No newline at end of file
@@ -17,6 +17,22 @@ Interrupt request handlers
 
 /* FUNCTIONS */
 
+__attribute__((naked)) void HardFault_Handler() { // Branch to the bootloader hard fault handler with the exception frame untouched (it records the faulting address and resets)
+    __ASM("ldr r0, =__FLASH_BL_CORE_START");
+    __ASM("ldr r1, =__FLASH_BL_CORE_LEN");
+    __ASM("adds r0, r0, r1");
+    __ASM("movs r1, #(0x100 - " _BOOTLOADER_MACRO_STRING(_BOOTLOADER_HARDFAULT_HANDLER_OFFSET) ")"); // Dispatch table start (0x100 from the end of the bootloader core) plus _BOOTLOADER_HARDFAULT_HANDLER_OFFSET
+    __ASM("subs r0, r0, r1");
+    __ASM("ldr r0, [r0]");
+    __ASM("bx r0");
+    __ASM(".ltorg");
+}
+
 void SysTick_Handler() {
     HAL_IncTick();
+}
+
+void FLASH_IRQHandler() {
+    struct BootloaderFunctions *bootloader = _BOOTLOADER_FUNCTIONS; // Get pointer to bootloader functions
+    bootloader->asyncWriter_irqHandler(); // Asynchronous writer (the interrupt is only enabled while one is open)
 }
\ No newline at end of file
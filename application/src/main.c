@@ -139,11 +139,13 @@ void main() {
 
     // Install new application
     bootloader->enableProgrammingMode(); // Enable programming mode
-    if (bootloader->app1_erase() == BL_OK) { // Erase application space 1
+    if (bootloader->app_eraseRange(1, 0, APP_BINARY_SIZE) == BL_OK) { // Erase the pages of application space 1 the new application occupies
         if (bootloader->app1_write(0x00000000, (uint64_t *)APP_BINARY, APP_BINARY_SIZE/8) == BL_OK) { // Program dword aligned data to application space 1
-            if (bootloader->app1_writeInfo(APP_INFO) == BL_OK) { // Write application info
+            bootloader->beginMetadataTransaction(); // Write the application info and boot priority as one bootloader data record
+            if (bootloader->app1_writeInfo(APP_INFO) == BL_OK && bootloader->setBootPriority(BOOTPRIO_APP1) == BL_OK && bootloader->commitMetadataTransaction() == BL_OK) { // Write application info, update boot priority and commit both
                 bootloader->disableProgrammingMode(); // Disable programming mode
-                bootloader->setBootPriority(BOOTPRIO_APP1); // Update boot priority
+            } else {
+                bootloader->abortMetadataTransaction(); // Discard the changes (nothing is written)
             }
         }
     }
@@ -165,11 +167,13 @@ void main() {
 
     // Install new application
     bootloader->enableProgrammingMode(); // Enable programming mode
-    if (bootloader->app2_erase() == BL_OK) { // Erase application space 2        
+    if (bootloader->app_eraseRange(2, 0, APP_BINARY_SIZE) == BL_OK) { // Erase the pages of application space 2 the new application occupies
         if (bootloader->app2_write(0x00000000, (uint64_t *)APP_BINARY, APP_BINARY_SIZE/8) == BL_OK) { // Program dword aligned data to application space 2
-            if (bootloader->app2_writeInfo(APP_INFO) == BL_OK) { // Write application info
+            bootloader->beginMetadataTransaction(); // Write the application info and boot priority as one bootloader data record
+            if (bootloader->app2_writeInfo(APP_INFO) == BL_OK && bootloader->setBootPriority(BOOTPRIO_APP2) == BL_OK && bootloader->commitMetadataTransaction() == BL_OK) { // Write application info, update boot priority and commit both
                 bootloader->disableProgrammingMode(); // Disable programming mode
-                bootloader->setBootPriority(BOOTPRIO_APP2); // Update boot priority
+            } else {
+                bootloader->abortMetadataTransaction(); // Discard the changes (nothing is written)
             }
         }
     }
@@ -191,11 +195,13 @@ void main() {
 
     // Install new application
     bootloader->enableProgrammingMode(); // Enable programming mode
-    if (bootloader->app2_erase() == BL_OK) { // Erase application space 2        
+    if (bootloader->app_eraseRange(2, 0, APP_BINARY_SIZE) == BL_OK) { // Erase the pages of application space 2 the new application occupies
         if (bootloader->app2_write(0x00000000, (uint64_t *)APP_BINARY, APP_BINARY_SIZE/8) == BL_OK) { // Program dword aligned data to application space 2
-            if (bootloader->app2_writeInfo(APP_INFO) == BL_OK) { // Write application info
+            bootloader->beginMetadataTransaction(); // Write the application info and boot priority as one bootloader data record
+            if (bootloader->app2_writeInfo(APP_INFO) == BL_OK && bootloader->setBootPriority(BOOTPRIO_AUTOMATIC) == BL_OK && bootloader->commitMetadataTransaction() == BL_OK) { // Write application info, update boot priority and commit both
                 bootloader->disableProgrammingMode(); // Disable programming mode
-                bootloader->setBootPriority(BOOTPRIO_AUTOMATIC); // Update boot priority
+            } else {
+                bootloader->abortMetadataTransaction(); // Discard the changes (nothing is written)
             }
         }
     }
@@ -217,11 +223,13 @@ void main() {
 
     // Install new application
     bootloader->enableProgrammingMode(); // Enable programming mode
-    if (bootloader->app2_erase() == BL_OK) { // Erase application space 2        
+    if (bootloader->app_eraseRange(2, 0, APP_BINARY_SIZE) == BL_OK) { // Erase the pages of application space 2 the new application occupies
         if (bootloader->app2_write(0x00000000, (uint64_t *)APP_BINARY, APP_BINARY_SIZE/8) == BL_OK) { // Program dword aligned data to application space 2
-            if (bootloader->app2_writeInfo(APP_INFO) == BL_OK) { // Write application info
+            bootloader->beginMetadataTransaction(); // Write the application info and boot priority as one bootloader data record
+            if (bootloader->app2_writeInfo(APP_INFO) == BL_OK && bootloader->setBootPriority(BOOTPRIO_APP2) == BL_OK && bootloader->commitMetadataTransaction() == BL_OK) { // Write application info, update boot priority and commit both
                 bootloader->disableProgrammingMode(); // Disable programming mode
-                bootloader->setBootPriority(BOOTPRIO_APP2); // Update boot priority
+            } else {
+                bootloader->abortMetadataTransaction(); // Discard the changes (nothing is written)
             }
         }
     }
@@ -256,11 +264,13 @@ void main() {
 
     // Install new application
     bootloader->enableProgrammingMode(); // Enable programming mode
-    if (bootloader->app2_erase() == BL_OK) { // Erase application space 2        
+    if (bootloader->app_eraseRange(2, 0, APP_BINARY_SIZE) == BL_OK) { // Erase the pages of application space 2 the new application occupies
         if (bootloader->app2_write(0x00000000, (uint64_t *)APP_BINARY, APP_BINARY_SIZE/8) == BL_OK) { // Program dword aligned data to application space 2
-            if (bootloader->app2_writeInfo(APP_INFO) == BL_OK) { // Write application info
+            bootloader->beginMetadataTransaction(); // Write the application info and boot priority as one bootloader data record
+            if (bootloader->app2_writeInfo(APP_INFO) == BL_OK && bootloader->setBootPriority(BOOTPRIO_APP2) == BL_OK && bootloader->commitMetadataTransaction() == BL_OK) { // Write application info, update boot priority and commit both
                 bootloader->disableProgrammingMode(); // Disable programming mode
-                bootloader->setBootPriority(BOOTPRIO_APP2); // Update boot priority
+            } else {
+                bootloader->abortMetadataTransaction(); // Discard the changes (nothing is written)
             }
         }
     }
@@ -295,11 +305,13 @@ void main() {
 
     // Install new application
     bootloader->enableProgrammingMode(); // Enable programming mode
-    if (bootloader->app2_erase() == BL_OK) { // Erase application space 2        
+    if (bootloader->app_eraseRange(2, 0, APP_BINARY_SIZE) == BL_OK) { // Erase the pages of application space 2 the new application occupies
         if (bootloader->app2_write(0x00000000, (uint64_t *)APP_BINARY, APP_BINARY_SIZE/8) == BL_OK) { // Program dword aligned data to application space 2
-            if (bootloader->app2_writeInfo(APP_INFO) == BL_OK) { // Write application info
+            bootloader->beginMetadataTransaction(); // Write the application info and boot priority as one bootloader data record
+            if (bootloader->app2_writeInfo(APP_INFO) == BL_OK && bootloader->setBootPriority(BOOTPRIO_APP2) == BL_OK && bootloader->commitMetadataTransaction() == BL_OK) { // Write application info, update boot priority and commit both
                 bootloader->disableProgrammingMode(); // Disable programming mode
-                bootloader->setBootPriority(BOOTPRIO_APP2); // Update boot priority
+            } else {
+                bootloader->abortMetadataTransaction(); // Discard the changes (nothing is written)
             }
         }
     }
@@ -334,11 +346,13 @@ void main() {
 
     // Install new application
     bootloader->enableProgrammingMode(); // Enable programming mode
-    if (bootloader->app2_erase() == BL_OK) { // Erase application space 2        
+    if (bootloader->app_eraseRange(2, 0, APP_BINARY_SIZE) == BL_OK) { // Erase the pages of application space 2 the new application occupies
         if (bootloader->app2_write(0x00000000, (uint64_t *)APP_BINARY, APP_BINARY_SIZE/8) == BL_OK) { // Program dword aligned data to application space 2
-            if (bootloader->app2_writeInfo(APP_INFO) == BL_OK) { // Write application info
+            bootloader->beginMetadataTransaction(); // Write the application info and boot priority as one bootloader data record
+            if (bootloader->app2_writeInfo(APP_INFO) == BL_OK && bootloader->setBootPriority(BOOTPRIO_APP2) == BL_OK && bootloader->commitMetadataTransaction() == BL_OK) { // Write application info, update boot priority and commit both
                 bootloader->disableProgrammingMode(); // Disable programming mode
-                bootloader->setBootPriority(BOOTPRIO_APP2); // Update boot priority
+            } else {
+                bootloader->abortMetadataTransaction(); // Discard the changes (nothing is written)
             }
         }
     }
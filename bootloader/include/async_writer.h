@@ -0,0 +1,44 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Asynchronous writer (header)
+Application writer programmed from the flash end of operation interrupt, so the application can keep receiving while flash programs
+*/
+
+/* INCLUDE GUARD */
+#pragma once
+#ifndef ASYNC_WRITER_H
+#define ASYNC_WRITER_H
+
+/* DEPENDENCIES */
+#include <stdint.h>                 // Fixed width integer data types
+#include "bootloader.h"             // Bootloader functions
+
+/* CONSTANT DEFINITIONS AND MACROS */
+
+
+/* TYPE DEFINITIONS AND ENUMERATIONS */
+
+typedef enum { // Asynchronous writer flash operations
+    ASYNC_OPERATION_NONE,                   // No operation in progress (waiting for data)
+    ASYNC_OPERATION_ERASE,                  // Erasing the next page to be written
+    ASYNC_OPERATION_PROGRAM                 // Programming a double-word
+} AsyncWriterOperation_T;
+
+/* GLOBAL VARIABLES */
+extern AsyncWriter_T *activeAsyncWriter; // Asynchronous writer the flash interrupt is programming for (NULL if none) (.bss, cleared at boot)
+
+/* FUNCTIONS */
+
+BootloaderStatus_T asyncWriter_open(AsyncWriter_T *writer, uint8_t app, uint32_t address, uint8_t *buffer, uint32_t size, void (*callback)(AsyncWriter_T *writer)); // Open an asynchronous writer to an application space at address with a ring buffer of size bytes (flash unlocked, pages erased as they are written)
+BootloaderStatus_T asyncWriter_push(AsyncWriter_T *writer, const void *data, uint32_t length); // Queue data of any length to be programmed in the background (BL_BUSY, and nothing queued, until the ring buffer has room for all of it)
+uint32_t asyncWriter_getSpace(AsyncWriter_T *writer); // Get the number of bytes that can be queued now
+BootloaderStatus_T asyncWriter_close(AsyncWriter_T *writer); // Program any remaining data and finish (completes in the background)
+BootloaderStatus_T asyncWriter_getStatus(AsyncWriter_T *writer); // Get the status of an asynchronous writer (BL_BUSY until it finishes or fails)
+void asyncWriter_irqHandler(); // Flash interrupt handler for asynchronous writers (call from the application's FLASH_IRQHandler)
+void asyncWriter_next(AsyncWriter_T *writer); // Start the next flash operation of an asynchronous writer, or finish it once closed and all data is programmed (flash interrupt or interrupts masked)
+void asyncWriter_complete(AsyncWriter_T *writer); // Verify the data programmed by the operation that has ended and free its ring buffer space (flash interrupt)
+void asyncWriter_finish(AsyncWriter_T *writer, BootloaderStatus_T status); // Stop an asynchronous writer with its final status and call its callback
+
+#endif
@@ -0,0 +1,59 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Boot statistics (header)
+Boot and update timing and counters, kept in bootloader static SRAM and persisted to the bootloader data journal in batches
+*/
+
+/* INCLUDE GUARD */
+#pragma once
+#ifndef BOOT_STATS_H
+#define BOOT_STATS_H
+
+/* DEPENDENCIES */
+#include <stdint.h>                 // Fixed width integer data types
+#include "bootloader.h"             // Bootloader functions
+
+/* CONSTANT DEFINITIONS AND MACROS */
+#define BOOTSTATS_BATCH 16          // Boots counted in SRAM before the statistics are persisted (at the next full boot, fast boots never write flash)
+#define BOOTSTATS_SEAL 0x53544154   // Mixed into the check word of the statistics in SRAM, so SRAM filled with a repeated pattern never reads as valid
+
+/* TYPE DEFINITIONS AND ENUMERATIONS */
+
+typedef struct { // Struct type definition for the statistics kept in bootloader static SRAM (survive warm resets, lost on power-on)
+    BootStats_T stats; // Statistics
+    uint32_t check; // Exclusive-or of the statistics words and BOOTSTATS_SEAL (statistics are restored from flash if it does not match)
+} BootStatsBlock_T;
+
+typedef struct { // Struct type definition for a boot statistics entry in the bootloader data journal (followed in flash by a double-word checksum, padded to double-words)
+    BootloaderEntryHeader_T header; // Entry header (BL_STATS_TAG, payload length the size of BootStats_T when written)
+    BootStats_T stats; // Statistics
+} BootStatsRecord_T;
+_Static_assert(offsetof(BootStatsRecord_T, stats) == sizeof(BootloaderEntryHeader_T), "boot statistics do not follow the entry header");
+
+/* GLOBAL VARIABLES */
+extern BootStatsBlock_T bootStats; // Boot statistics (bootloader static SRAM, not cleared at boot)
+extern uint8_t bootStatsTimerStarted; // TIM2 started by bootStats_startTimer and not yet stopped (.bss, cleared at boot)
+
+/* FUNCTIONS */
+
+uint8_t bootStats_startTimer(); // Start TIM2 counting from zero if it is free (1 if started, 0 if the application or an outer measurement is using it)
+uint32_t bootStats_readTimer(); // Read the TIM2 count (cycles since bootStats_startTimer)
+uint32_t bootStats_stopTimer(uint8_t started); // Stop TIM2 if bootStats_startTimer started it, returning the cycles counted (0 if it did not start it)
+uint8_t bootStats_isTimerRunning(); // Check whether TIM2 is counting for a bootloader measurement (nested measurements can read it)
+
+uint32_t bootStats_checkWord(); // Calculate the check word of the statistics in SRAM
+uint8_t bootStats_isValid(); // Check the statistics in SRAM
+void bootStats_seal(); // Update the check word after changing the statistics in SRAM
+void bootStats_beginBoot(); // Restore the statistics from flash if SRAM lost them (power-on) and clear the per-boot figures
+void bootStats_countBoot(uint32_t cycles); // Count a boot that took cycles
+void bootStats_countVerify(uint8_t app, uint32_t cycles, uint8_t valid); // Count the verification of an application at boot
+void bootStats_countErase(uint32_t pages, uint32_t cycles, BootloaderStatus_T status); // Count application pages erased
+void bootStats_countProgram(uint32_t bytes, uint32_t cycles, BootloaderStatus_T status); // Count application bytes programmed
+uint8_t bootStats_isPersistDue(); // Check whether BOOTSTATS_BATCH boots have been counted since the statistics were last persisted
+BootloaderStatus_T bootStats_persist(); // Append the statistics to the bootloader data journal (flash unlocked)
+BootloaderStatus_T bootStats_write(uint8_t page, uint32_t offset); // Write a boot statistics entry at offset in a bootloader data page (flash unlocked, target erased)
+BootloaderStatus_T getBootStats(BootStats_T *stats); // Get the boot and update statistics
+
+#endif
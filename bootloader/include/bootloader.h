@@ -23,6 +23,32 @@ Bootloader and update functions
 #define FAULT_THRESHOLD 3           // Number of recorded application faults for application to be considered faulty and not used
 #define VECTOR_TABLE_SIZE 47        // Size of the vector table (words/entries) (STM32G071: 16 Cortex-M entries + 31 peripheral entries)
 
+// Application spaces
+#define APP_SLOT_DESCRIPTOR(region) {&__##region##_START, &__##region##_LEN}, // Application space descriptor initialiser for a memory_map.ld region
+#define IS_APP_SLOT(app) ((app) >= 1 && (app) <= BL_APP_SLOTS) // Check that an application space number exists (numbered from 1)
+#define APP_SLOT_START(app) ((uint32_t) appSlots[(app) - 1].start) // Start address of an application space
+#define APP_SLOT_LENGTH(app) ((uint32_t) appSlots[(app) - 1].length) // Length of an application space (bytes)
+
+// Verification cache
+#define VERIFICATION_RECHECK_INTERVAL 32 // Verifying boots per full re-verification of cached applications (1 to re-verify every boot) (the last boot of each interval re-verifies)
+#define VERIFICATION_RECORD_ERASED 0xFFFFFFFF // Verification record generation when not verified
+
+// Bootloader data journal (records and boot tick marks appended to a bootloader data page, compacted into the other page when it is full)
+#define BL_DATA_PAGES 2             // Number of bootloader data pages (FLASH_BL_DATA and FLASH_BL_DATA_B)
+#define BL_DATA_PAGE_ADDRESS(page) ((page) ? (uint32_t) &__FLASH_BL_DATA_B_START : (uint32_t) &__FLASH_BL_DATA_START) // Base address of a bootloader data page
+#define BL_RECORD_TAG 0x31444C42    // Tag at the start of a bootloader data record ("BLD1")
+#define BL_RECORD_SIZE_OF(length) ((((length) + 7) & ~7) + 8) // Size of a bootloader data record in flash with length bytes of header and data (padded to double-words, then the checksum double-word)
+#define BL_RECORD_SIZE BL_RECORD_SIZE_OF(sizeof(BootloaderRecord_T)) // Size of a bootloader data record in flash (current layout)
+#define BL_JOURNAL_MAX_RECORDS (FLASH_PAGE_SIZE/BL_RECORD_SIZE) // Maximum number of records in the journal (layouts only grow, so records of other layouts are never smaller)
+#define BL_JOURNAL_TICK 0x0000000000000000 // Journal entry for a verifying boot (boot tick mark)
+#define BL_JOURNAL_ERASED 0xFFFFFFFFFFFFFFFF // Erased journal entry (end of journal)
+#define BL_FASTBOOT_TAG 0x46424C00  // Tag of a fast boot mark ("\0LBF", application space in the low byte)
+#define BL_JOURNAL_FASTBOOT(app) (((uint64_t) ~(BL_FASTBOOT_TAG | (app)) << 32) | (BL_FASTBOOT_TAG | (app))) // Journal entry for a full boot that selected an application the fast boot path may start (tag and application space, then their inverse so an interrupted write is not mistaken for one)
+#define BL_STATS_TAG 0x31534C42     // Tag at the start of a boot statistics entry ("BLS1")
+#define BL_RESETS_TAG 0x31524C42    // Tag at the start of a reset counts entry ("BLR1")
+#define BL_TRIAL_TAG 0x31544C42     // Tag at the start of a trial boot entry ("BLT1")
+#define BL_ENTRY_SIZE(length) ((((length) + 8 + 7) & ~7) + 8) // Size of a tagged entry (boot statistics, reset counts or trial boot state) in flash with a payload of length bytes (tag and length, payload padded to double-words, then the checksum double-word)
+
 // Watchdog long interval (~30s)
 #define WDG_LONG_PRESC IWDG_PRESCALER_256
 #define WDG_LONG_RELOAD 3840
@@ -32,16 +58,92 @@ Bootloader and update functions
 // Watchdog short interval (~500ms)
 #define WDG_SHORT_PRESC IWDG_PRESCALER_32
 #define WDG_SHORT_RELOAD 512
+// Space on the stack for the copy of the fast row programming sequence (bytes)
+#define FASTROW_CODE_SIZE 128
+// Flash routines run from a copy in SRAM (.ramfunc, position independent: no calls outside .ramfunc, library calls or division)
+#ifndef HOST_SIM
+#define RAMFUNC __attribute__((section(".ramfunc"), noinline)) // Routine copied to application RAM by setFlashRam
+#define RAMFUNC_FASTROW __attribute__((section(".ramfunc.fastrow"), noinline)) // Fast row programming sequence (start of .ramfunc, also copied onto the stack by programFastRow, calls nothing)
+#define FLASH_WRITE_WORD(address, word) (*(volatile uint32_t *) (address) = (word)) // Word write to flash memory (taken by the flash controller while PG or FSTPG is set)
+#else
+#define RAMFUNC // The host runs the routines where they were built
+#define RAMFUNC_FASTROW
+#define FLASH_WRITE_WORD(address, word) simFlashWriteWord((address), (word)) // The host maps flash read-only, the simulated flash controller takes the write
+#endif
+// Bytes of the data written to an application space covered by its running checksum (the last double-word written is left out, so an application size anywhere in it can be checked)
+#define WRITE_CHECKSUM_LENGTH(length) (((length) == 0) ? 0 : ((length) - 1) & ~7UL)
 /* TYPE DEFINITIONS AND ENUMERATIONS */
 
+typedef struct { // Struct type definition for the result of a bootloader data journal scan
+    uint8_t page; // Bootloader data page scanned
+    uint16_t record[BL_JOURNAL_MAX_RECORDS]; // Offsets of the records in the page (oldest first)
+    uint32_t records; // Number of records in the page
+    uint32_t ticks; // Boot tick marks after the newest record
+    uint8_t fastBootApp; // Application space of the fast boot mark ending the journal (0 if the last entry is not a fast boot mark)
+    int32_t stats; // Offset of the newest completely written boot statistics entry in the page (-1 if none)
+    int32_t resets; // Offset of the newest completely written reset counts entry in the page (-1 if none)
+    int32_t trial; // Offset of the newest completely written trial boot entry in the page (-1 if none)
+    uint32_t end; // Offset of the end of the journal in the page (first erased double-word, or the page length if the page is full)
+} BootloaderJournal_T;
+
+typedef struct { // Struct type definition for an application space descriptor
+    const int *start; // Application space start (address of the memory map start symbol)
+    const int *length; // Application space length (address of the memory map length symbol)
+} AppSlot_T;
+
+typedef struct { // Struct type definition for the running checksum of the data written to an application space
+    uint8_t tracking; // Application space erased since boot and only written in sequence from its start
+    uint32_t length; // Bytes written
+    uint32_t checksum; // CRC32 checksum of the bytes written up to the last double-word written (WRITE_CHECKSUM_LENGTH bytes, as calculateChecksum)
+} WriteChecksum_T;
 
 /* GLOBAL VARIABLES */
-
+extern const AppSlot_T appSlots[BL_APP_SLOTS]; // Application space descriptors (from memory_map.ld regions)
+extern WriteChecksum_T writeChecksum[BL_APP_SLOTS]; // Running checksums of the data written to each application space (.bss, cleared at boot)
+extern uint32_t erasedPageCount; // Pages erased by the last application erase or lazily erasing streaming writer (.bss, cleared at boot)
+extern uint32_t verificationEpoch[BL_APP_SLOTS]; // Changes to each application space since boot (.bss, cleared at boot, incremented when its verification record is invalidated or a streaming writer programs it)
+extern const BootloaderData_T *currentBootloaderData; // Current bootloader data in flash (.bss, cleared at boot, found on first use and cleared when bootloader data is written)
+extern int __BL_RAMFUNC_START; // Start of the .ramfunc section in bootloader flash (bootloader.ld)
+extern int __BL_RAMFUNC_END; // End of the .ramfunc section in bootloader flash (bootloader.ld)
+extern int __BL_FASTROW_START; // Start of the fast row programming sequence in flash (bootloader.ld, start of .ramfunc)
+extern int __BL_FASTROW_END; // End of the fast row programming sequence in flash (bootloader.ld)
 
 /* FUNCTIONS */
 
-BootloaderData_T getBootloaderData(); // Get bootloader data from flash
+uint32_t calculateChecksum(void *data, uint32_t length); // Calculate the CRC32 checksum of data (standard CRC32, as binascii.crc32)
+uint32_t accumulateChecksum(uint32_t checksum, void *data, uint32_t length); // Continue a CRC32 checksum (as calculateChecksum, 0 to start) over more data
+void fillBytes(void *data, uint8_t value, uint32_t length); // Set length bytes of data to value (as memset, the bootloader links without the C library)
+void copyBytes(void *destination, const void *source, uint32_t length); // Copy length bytes from source to destination (as memcpy)
+uint8_t isEqualBytes(const void *a, const void *b, uint32_t length); // Check that length bytes at a and b are equal (as memcmp)
+
+void scanBootloaderJournal(uint8_t page, BootloaderJournal_T *journal); // Scan a bootloader data page for journal records, boot tick marks and free space
+uint32_t getBootloaderRecordSize(uint8_t page, uint32_t offset); // Get the size in flash of the bootloader data record at offset in a bootloader data page (0 if there is no record)
+const BootloaderData_T *getBootloaderRecordData(uint8_t page, uint32_t offset, uint32_t *length, uint32_t *layout); // Get a pointer to the bootloader data of the record at offset in a bootloader data page, with its length and layout version
+uint8_t isBootloaderRecordCommitted(uint8_t page, uint32_t offset); // Check that the bootloader data record at offset in a bootloader data page was completely written (checksum double-word programmed)
+uint8_t isBootloaderRecordValid(uint8_t page, uint32_t offset); // Check the checksum of the bootloader data record at offset in a bootloader data page
+uint8_t isBootloaderDataErased(uint8_t page, uint32_t offset, uint32_t length); // Check that length bytes at offset in a bootloader data page are erased (and lie within the page)
+int32_t findBootloaderRecord(BootloaderJournal_T *journal, uint8_t validate); // Find the newest valid (or, without validate, completely written) bootloader data record in either page, journal is set to the scan of its page (-1 if none, journal is set to the scan of page A)
+const BootloaderData_T *readBootloaderData(); // Get a pointer to the current bootloader data in flash (newest valid record in the journal, valid until bootloader data is next written)
+BootloaderData_T getBootloaderData(); // Get a copy of the current bootloader data (to change and write back), fields an older layout lacks read as erased
+uint32_t getBootloaderDataLayout(); // Get the layout version the current bootloader data was written in (0 for unjournaled data written by previous bootloader versions, or none)
+BootloaderStatus_T appendBootloaderData(BootloaderData_T *data); // Append a bootloader data record to the journal (flash unlocked)
+BootloaderStatus_T compactBootloaderJournal(); // Compact the bootloader data journal into the other page with bootloader data unchanged, carrying the boot tick marks over so the re-verification interval is kept (flash unlocked)
 BootloaderStatus_T writeBootloaderData(BootloaderData_T data); // Write bootloader data to flash
+BootloaderStatus_T programBootloaderData(uint8_t page, uint32_t offset, uint64_t value); // Program a double-word in a bootloader data page without erasing it (flash unlocked, target erased or value zero)
+int32_t findBootloaderEntry(uint32_t tag, uint8_t *page); // Find the newest completely written tagged entry (BL_STATS_TAG, BL_RESETS_TAG or BL_TRIAL_TAG) in the journal (offset in page, -1 if none)
+BootloaderStatus_T writeBootloaderEntry(uint8_t page, uint32_t offset, uint32_t tag, const void *payload, uint32_t length); // Write a tagged entry at offset in a bootloader data page (flash unlocked, target erased)
+BootloaderStatus_T appendBootloaderEntry(uint32_t tag, const void *payload, uint32_t length); // Append a tagged entry to the bootloader data journal, compacting it if the page is full (flash unlocked)
+
+uint8_t isVerificationCached(uint32_t generation, VerificationRecord_T record, uint32_t appChecksum); // Check whether a verification record is valid for an application generation and checksum
+BootloaderStatus_T setVerification(uint8_t app, VerificationRecord_T record); // Set the verification record of an application (flash unlocked)
+BootloaderStatus_T invalidateVerification(uint8_t app); // Invalidate the verification record of an application (flash unlocked)
+BootloaderStatus_T recordVerification(uint8_t app, VerificationRecord_T record, uint8_t valid); // Record the result of checking an entire application against its info (flash unlocked, nothing is written if the record already says so)
+uint32_t getVerificationTicks(); // Get the number of verifying boots since bootloader data was last written
+BootloaderStatus_T addVerificationTick(); // Record a verifying boot (flash unlocked)
+
+uint8_t getFastBootMarkApp(uint64_t entry); // Get the application space of a fast boot mark journal entry (0 if the entry is not a fast boot mark)
+BootloaderStatus_T setFastBootMark(uint8_t app); // Record that the fast boot path may start an application, until anything else is appended to the journal (flash unlocked)
+BootloaderStatus_T cancelFastBootMark(); // Stop the fast boot path starting an application until the next full boot (flash unlocked) (the mark is zeroed, so it reads as a boot tick mark)
 
 __attribute__((naked)) void startApplication(uint32_t stackPointer, uint32_t startupAddress); // Starts an application (sets the main stack pointer to stackPointer and jumps to startupAddress)
 
@@ -55,10 +157,24 @@ VerificationMode_T getVerificationMode(); // Get the current application verific
 BootloaderStatus_T setVerificationMode(VerificationMode_T mode); // Set the application verification mode
 WatchdogMode_T getWatchdogMode(); // Get the current watchdog mode
 BootloaderStatus_T setWatchdogMode(WatchdogMode_T mode); // Set the watchdog mode
+FastBootMode_T getFastBootMode(); // Get the current fast boot mode
+BootloaderStatus_T setFastBootMode(FastBootMode_T mode); // Set the fast boot mode
 
 BootloaderStatus_T enableProgrammingMode(); // Enable programming mode (to write new application)
 BootloaderStatus_T disableProgrammingMode(); // Disable programming mode (after writing application)
 
+uint8_t app_getFaultCount(uint8_t app); // Get the fault count of an application
+BootloaderStatus_T app_resetFaultCount(uint8_t app); // Reset the fault count of an application
+AppInfo_T app_getInfo(uint8_t app); // Get the app info of an application (erased, all 0xFF, if there is no such application space)
+BootloaderStatus_T getBootloaderView(BootloaderView_T *view); // Point a read-only view at the current bootloader data in flash (valid until bootloader data is next written)
+BootloaderStatus_T app_erase(uint8_t app); // Erase an application space
+BootloaderStatus_T app_eraseRange(uint8_t app, uint32_t address, uint32_t length); // Erase the pages of an application space that hold length bytes from address (erase 0 to the size of a new application to install it)
+BootloaderStatus_T eraseAppPages(uint8_t app, uint32_t page, uint32_t pages); // Erase the pages of an application space (numbered from the start of the application space) that are not already blank (flash unlocked)
+uint8_t isFlashPageBlank(uint32_t page); // Check that a flash page is erased (all 0xFF)
+uint32_t getErasedPageCount(); // Get the number of pages erased by the last application erase or lazily erasing streaming writer (pages that were already blank are not erased)
+BootloaderStatus_T app_write(uint8_t app, uint32_t address, uint64_t *data, uint32_t length); // Write data to an application space (in 64-bit/double-word pages)
+BootloaderStatus_T app_writeInfo(uint8_t app, AppInfo_T info); // Write the app info of an application to bootloader data
+
 uint8_t app1_getFaultCount(); // Get the fault count of application 1
 BootloaderStatus_T app1_resetFaultCount(); // Reset the fault count of application 1
 AppInfo_T app1_getInfo(); // Get the app info of application 1
@@ -73,4 +189,19 @@ BootloaderStatus_T app2_erase(); // Erase application space 2
 BootloaderStatus_T app2_write(uint32_t address, uint64_t *data, uint32_t length); // Write data to application space 2 (in 64-bit/double-word pages)
 BootloaderStatus_T app2_writeInfo(AppInfo_T info); // Write app 2 info to bootloader data
 
+BootloaderStatus_T appWriter_open(AppWriter_T *writer, uint8_t app, uint32_t address); // Open a streaming writer to an application space at address (flash unlocked, application space erased)
+BootloaderStatus_T appWriter_openErase(AppWriter_T *writer, uint8_t app, uint32_t address); // Open a streaming writer to an application space at address that erases each page just before its first write (flash unlocked, from address onwards the application space need not be erased)
+BootloaderStatus_T appWriter_init(AppWriter_T *writer, uint8_t app, uint32_t address); // Check the application space and address of a streaming writer and set it up (left closed)
+BootloaderStatus_T appWriter_push(AppWriter_T *writer, const void *data, uint32_t length); // Write data of any length and alignment through a streaming writer (programmed a row at a time)
+BootloaderStatus_T appWriter_close(AppWriter_T *writer); // Write any remaining data and close a streaming writer
+RAMFUNC_FASTROW void fastRowSequence(uint32_t address, const uint32_t *row); // Write a row to flash and wait for it to be programmed (fast programming set up, interrupts masked, runs from a copy in SRAM)
+BootloaderStatus_T programFastRow(uint32_t address, uint64_t *row); // Program an erased flash row in one fast programming operation (flash unlocked, row in SRAM)
+uint8_t appWriter_read(AppWriter_T *writer, uint32_t offset); // Read back a byte written through a streaming writer (offset in the application space, staged or in flash)
+BootloaderStatus_T appWriter_flush(AppWriter_T *writer); // Program and verify the staged row of a streaming writer (fast programming if the row is erased)
+
+void resetWriteChecksum(uint8_t app); // Start the running checksum of an application space (erased)
+void updateWriteChecksum(uint8_t app, uint32_t address, uint32_t length); // Add data programmed (and verified) at address in an application space to its running checksum
+BootloaderStatus_T getWriteChecksum(uint8_t app, uint32_t *length, uint32_t *checksum); // Get the length and CRC32 of the data written to an application space since it was erased (BL_ERROR unless written in sequence from its start)
+BootloaderStatus_T getWriteChecksumTo(uint8_t app, uint32_t length, uint32_t *checksum); // Get the CRC32 of the first length bytes written to an application space since it was erased (BL_ERROR unless written in sequence from its start and length ends in the last double-word written)
+
 #endif
\ No newline at end of file
@@ -13,15 +13,29 @@ Format for bootloader data (struct)
 
 /* DEPENDENCIES */
 #include <stdint.h>                 // Fixed width integer data types
+#include <stddef.h>                 // offsetof
 #include "app_info.h"               // Application information format
 #include "bootloader_common.h"      // Bootloader content accessible by applications
 
 /* CONSTANT DEFINITIONS AND MACROS */
-
+#define BL_DATA_LAYOUT 1            // Bootloader data layout version (BootloaderData_T, fields are only ever appended so older layouts are a prefix of newer ones)
+#define BL_DATA_LEGACY_LENGTH 64    // Length of the unjournaled bootloader data written by previous bootloader versions (packed, but with every field at the offset BootloaderData_T gives it)
 
 /* TYPE DEFINITIONS AND ENUMERATIONS */
 
-typedef struct __attribute__((packed)) { // Struct type definition for bootloader data
+typedef struct { // Struct type definition for a verification record (one double-word, so it can be set or invalidated without erasing the page)
+    uint32_t generation; // Application generation that was verified (erased if not verified, zero if invalidated)
+    uint32_t appChecksum; // Application checksum that was verified
+} VerificationRecord_T;
+
+typedef struct { // Struct type definition for the bootloader data of an application space
+    uint32_t infoChecksum; // Application information section checksum
+    uint8_t faultCount; // Application fault count (resets of the causes in the fault policy)
+    uint8_t _PADDING[3]; // Padding (3 bytes)
+    AppInfo_T info; // Application information
+} AppData_T;
+
+typedef struct { // Struct type definition for bootloader data (layout BL_DATA_LAYOUT, naturally aligned)
     // Bootloader information
     uint32_t blVersion; // Bootloader version number
 
@@ -29,21 +43,39 @@ typedef struct __attribute__((packed)) { // Struct type definition for bootloade
     BootPriority_T bootPriority; // Boot priority
     VerificationMode_T verificationMode; // Application verification mode
     WatchdogMode_T watchdogMode; // Watchdog mode
-    uint8_t _PADDING1[1]; // Padding (1 bytes)
+    FastBootMode_T fastBootMode; // Fast boot mode (was padding, bootloader data written by previous bootloader versions reads as off)
 
     // Application data
-    uint32_t app1_infoChecksum; // Application 1 information section checksum
-    uint8_t app1_faultCount; // Application 1 fault count (hard faults and watchdog resets, if enabled)
-    uint8_t _PADDING2[3]; // Padding (3 bytes)
-    AppInfo_T app1_info; // Application 1 information
-
-    uint32_t app2_infoChecksum; // Application 2 information section checksum
-    uint8_t app2_faultCount; // Application 2 fault count (hard faults and watchdog resets, if enabled)
-    uint8_t _PADDING3[3]; // Padding (3 bytes)
-    AppInfo_T app2_info; // Application 2 information
+    AppData_T app[BL_APP_SLOTS]; // Application data (application space n at index n - 1)
+
+    // Verification cache
+    uint32_t generation[BL_APP_SLOTS]; // Application generations (incremented when application info is written)
+    VerificationRecord_T verified[BL_APP_SLOTS]; // Application verified-at-generation records (invalidated by erase/write)
     
 } BootloaderData_T;
 
+typedef struct { // Struct type definition for a bootloader data record header (start of each record in the bootloader data journal)
+    uint32_t tag; // Record tag (BL_RECORD_TAG)
+    uint32_t sequence; // Record sequence number (incremented for each record appended to the journal)
+    uint16_t layout; // Bootloader data layout version (BL_DATA_LAYOUT when written)
+    uint16_t length; // Bootloader data length (bytes, the size of BootloaderData_T when written)
+} BootloaderRecordHeader_T;
+
+typedef struct { // Struct type definition for a tagged entry header (start of each boot statistics, reset counts or trial boot entry in the bootloader data journal, followed by the payload)
+    uint32_t tag; // Entry tag (BL_STATS_TAG, BL_RESETS_TAG or BL_TRIAL_TAG)
+    uint32_t length; // Payload length (bytes, so a scan can skip entries written by other bootloader versions)
+} BootloaderEntryHeader_T;
+
+typedef struct { // Struct type definition for a bootloader data record (followed in flash by a double-word checksum, padded to double-words)
+    BootloaderRecordHeader_T header; // Record header
+    BootloaderData_T data; // Bootloader data
+} BootloaderRecord_T;
+
+// Unjournaled bootloader data (previous bootloader versions) holds the same leading fields at the same offsets, so it is read in place until the boot migrates it
+_Static_assert(offsetof(BootloaderData_T, app) == 8 && offsetof(BootloaderData_T, generation) == BL_DATA_LEGACY_LENGTH, "legacy bootloader data fields moved");
+// Tagged entries are written header double-word first, then the payload from the next double-word
+_Static_assert(sizeof(BootloaderEntryHeader_T) == 8, "tagged entry header is not one double-word");
+
 
 /* GLOBAL VARIABLES */
 
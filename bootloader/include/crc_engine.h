@@ -0,0 +1,52 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+CRC engine (header)
+Standard CRC32 calculation with build-time selectable backends (word-wide hardware feed, DMA feed or table-driven software)
+*/
+
+/* INCLUDE GUARD */
+#pragma once
+#ifndef CRC_ENGINE_H
+#define CRC_ENGINE_H
+
+/* DEPENDENCIES */
+#include <stdint.h>                 // Fixed width integer data types
+#include "stm32g0xx_hal.h"          // STM32G0 hardware abstraction layer
+#include "stm32g071xx.h"            // STM32G071 device registers
+
+/* CONSTANT DEFINITIONS AND MACROS */
+// Backends (CRC_BACKEND, set by the makefile)
+#define CRC_BACKEND_WORD 1          // Word-wide hardware feed (the CPU writes whole words to the CRC unit, bit reversal by word in hardware)
+#define CRC_BACKEND_DMA 2           // DMA feed (DMA1 channel 2 moves words from memory to the CRC unit)
+#define CRC_BACKEND_SOFTWARE 3      // Table-driven software CRC, slicing-by-4 (ports without a CRC unit, 4K of tables in flash)
+#ifndef CRC_BACKEND
+#define CRC_BACKEND CRC_BACKEND_WORD
+#endif
+// Only the selected backend is built for the device, the host simulator builds all of them to benchmark them
+
+#define CRC_DMA_CHANNEL DMA1_Channel2 // DMA channel of the DMA backend (BL_CRC_DMA_CHANNEL, reserved for the bootloader, channel 1 receives recovery uploads)
+#define CRC_DMA_MIN_WORDS 16        // Words below which the DMA backend feeds the CRC unit from the CPU (channel set-up costs more than it saves)
+#define CRC_DMA_MAX_WORDS 0xFFFF    // Words per DMA transfer (CNDTR is 16 bits)
+
+/* TYPE DEFINITIONS AND ENUMERATIONS */
+
+
+/* GLOBAL VARIABLES */
+
+
+/* FUNCTIONS */
+
+uint32_t crc_accumulate(uint32_t checksum, const void *data, uint32_t length); // Continue a CRC32 checksum (0 to start, standard CRC32 as binascii.crc32) over more data with the selected backend
+
+uint8_t crc_hardwareBegin(CRC_HandleTypeDef *crcHandle, uint32_t checksum); // Enable and configure the CRC unit to continue a checksum (1 if its clock was already enabled)
+void crc_hardwareFeedBytes(CRC_HandleTypeDef *crcHandle, const uint8_t *bytes, uint32_t length); // Feed bytes to the CRC unit (bit reversal by byte)
+void crc_hardwareFeedWords(CRC_HandleTypeDef *crcHandle, const uint32_t *words, uint32_t count); // Feed words to the CRC unit from the CPU (bit reversal by word, so each word is processed as its four bytes in memory order)
+uint32_t crc_hardwareEnd(CRC_HandleTypeDef *crcHandle, uint8_t clockEnabled); // Read the checksum from the CRC unit and leave its clock as crc_hardwareBegin found it
+uint32_t crc_wordAccumulate(uint32_t checksum, const void *data, uint32_t length); // Continue a CRC32 checksum with the CPU feeding the CRC unit a word at a time
+void crc_dmaFeedWords(const uint32_t *words, uint32_t count); // Feed words to the CRC unit by DMA, waiting for the transfers (CRC unit configured for words)
+uint32_t crc_dmaAccumulate(uint32_t checksum, const void *data, uint32_t length); // Continue a CRC32 checksum with DMA feeding the CRC unit
+uint32_t crc_softwareAccumulate(uint32_t checksum, const void *data, uint32_t length); // Continue a CRC32 checksum in software (slicing-by-4)
+
+#endif
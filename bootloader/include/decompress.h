@@ -0,0 +1,46 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Compressed updates (header)
+Streaming decompressor for compressed update images (images made by make_compressed_update.py)
+*/
+
+/* INCLUDE GUARD */
+#pragma once
+#ifndef DECOMPRESS_H
+#define DECOMPRESS_H
+
+/* DEPENDENCIES */
+#include <stdint.h>                 // Fixed width integer data types
+#include "bootloader.h"             // Bootloader functions
+
+/* CONSTANT DEFINITIONS AND MACROS */
+#define COMPRESSED_COPY_BUFFER 32   // Match copy buffer (bytes, on the stack)
+
+/* TYPE DEFINITIONS AND ENUMERATIONS */
+
+typedef enum { // Compressed update image decompressor states
+    COMPRESSED_STATE_HEADER,                // Receiving the image header
+    COMPRESSED_STATE_TOKEN,                 // Waiting for a sequence token
+    COMPRESSED_STATE_LITERAL_LENGTH,        // Receiving literal length extension bytes
+    COMPRESSED_STATE_LITERALS,              // Receiving literals
+    COMPRESSED_STATE_OFFSET_LOW,            // Receiving the match offset (low byte)
+    COMPRESSED_STATE_OFFSET_HIGH,           // Receiving the match offset (high byte)
+    COMPRESSED_STATE_MATCH_LENGTH,          // Receiving match length extension bytes
+    COMPRESSED_STATE_END,                   // Application complete
+    COMPRESSED_STATE_ERROR                  // Image failed (no further data accepted)
+} CompressedImageState_T;
+
+/* GLOBAL VARIABLES */
+
+
+/* FUNCTIONS */
+
+BootloaderStatus_T compressedImage_open(CompressedImage_T *image, uint8_t app); // Start writing a compressed update image to an application space (flash unlocked, pages erased as they are written)
+BootloaderStatus_T compressedImage_push(CompressedImage_T *image, const void *data, uint32_t length); // Decompress and write the next part of a compressed update image (any length)
+BootloaderStatus_T compressedImage_close(CompressedImage_T *image); // Finish a compressed update image and check the application against the image header
+BootloaderStatus_T compressedImage_literals(CompressedImage_T *image); // Start the literal run of the current sequence (length known)
+BootloaderStatus_T compressedImage_match(CompressedImage_T *image); // Copy the match of the current sequence from the application written so far (length and offset known)
+
+#endif
@@ -0,0 +1,45 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Delta updates (header)
+Delta update patch applier (patches made by make_delta_update.py)
+*/
+
+/* INCLUDE GUARD */
+#pragma once
+#ifndef DELTA_H
+#define DELTA_H
+
+/* DEPENDENCIES */
+#include <stdint.h>                 // Fixed width integer data types
+#include "bootloader.h"             // Bootloader functions
+
+/* CONSTANT DEFINITIONS AND MACROS */
+
+
+/* TYPE DEFINITIONS AND ENUMERATIONS */
+
+typedef enum { // Delta update patch decoder states
+    DELTA_STATE_HEADER,                     // Receiving the patch header
+    DELTA_STATE_OPCODE,                     // Waiting for an operation
+    DELTA_STATE_LENGTH,                     // Decoding an operation length
+    DELTA_STATE_OFFSET,                     // Decoding a copy offset
+    DELTA_STATE_INSERT,                     // Receiving bytes to insert
+    DELTA_STATE_END,                        // End of patch received
+    DELTA_STATE_ERROR                       // Patch failed (no further data accepted)
+} DeltaPatchState_T;
+
+/* GLOBAL VARIABLES */
+
+
+/* FUNCTIONS */
+
+BootloaderStatus_T deltaPatch_open(DeltaPatch_T *patch, uint8_t oldApp, uint8_t app); // Start applying a delta update patch to the application in oldApp, writing the patched application to application space app (flash unlocked, pages erased as they are written)
+BootloaderStatus_T deltaPatch_push(DeltaPatch_T *patch, const void *data, uint32_t length); // Apply the next part of a delta update patch (any length)
+BootloaderStatus_T deltaPatch_close(DeltaPatch_T *patch); // Finish a delta update patch and check the patched application against the patch header
+BootloaderStatus_T deltaPatch_header(DeltaPatch_T *patch); // Check a received patch header against the old application and the application space being written
+BootloaderStatus_T deltaPatch_copy(DeltaPatch_T *patch, uint32_t offset); // Copy the current operation length of bytes from the old application (offset from the end of the previous copy, zigzag encoded)
+uint8_t deltaPatch_field(DeltaPatch_T *patch, uint8_t byte); // Add a byte to the variable-length field being decoded (1 when the field is complete)
+
+#endif
@@ -0,0 +1,36 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+RAM flash routines (header)
+Flash erase and program routines run from a copy in application RAM, so interrupts with RAM-resident handlers are taken while the single flash bank is busy
+*/
+
+/* INCLUDE GUARD */
+#pragma once
+#ifndef FLASH_RAM_H
+#define FLASH_RAM_H
+
+/* DEPENDENCIES */
+#include <stdint.h>                 // Fixed width integer data types
+#include "bootloader.h"             // Bootloader functions
+
+/* CONSTANT DEFINITIONS AND MACROS */
+#define FLASHRAM_IRQS 32            // NVIC interrupts (IRQn bits of FlashRam_T irqMask)
+
+/* TYPE DEFINITIONS AND ENUMERATIONS */
+
+typedef uint32_t (*FlashRamRoutine_T)(uint32_t control, uint32_t address, const uint32_t *data, uint32_t *timing); // Flash operation routine (flashRam_run, or its copy in RAM)
+
+/* GLOBAL VARIABLES */
+extern FlashRam_T *activeFlashRam; // RAM flash routines blocking flash operations run from (NULL to run them from flash with the HAL)
+
+/* FUNCTIONS */
+
+BootloaderStatus_T setFlashRam(FlashRam_T *ram, uint32_t irqMask, uint8_t fastRows); // Run blocking flash erases and writes from RAM routines copied into ram, with only the irqMask interrupts enabled (vector table in RAM, NULL to run them from flash again)
+HAL_StatusTypeDef flashRam_erase(FLASH_EraseInitTypeDef *erase, uint32_t *pageError); // Erase flash pages as HAL_FLASHEx_Erase does (from RAM a page at a time if setFlashRam enabled it)
+HAL_StatusTypeDef flashRam_program(uint32_t typeProgram, uint32_t address, uint64_t data); // Program a double-word or a fast programming row as HAL_FLASH_Program does (from RAM if setFlashRam enabled it)
+HAL_StatusTypeDef flashRam_operation(FlashRam_T *ram, uint32_t control, uint32_t address, const uint32_t *data); // Run a flash operation from the RAM routines with only the registered interrupts enabled, recording its timing
+RAMFUNC uint32_t flashRam_run(uint32_t control, uint32_t address, const uint32_t *data, uint32_t *timing); // Run a flash operation and wait for it to end, returning its error flags (runs from RAM, timing gets its duration and the time interrupts were masked in TIM2 counts)
+
+#endif
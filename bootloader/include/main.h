@@ -17,9 +17,13 @@ Bootloader logic code
 #include "bootloader.h"             // Bootloader functions
 #include "bootloader_data.h"        // Bootloader data format
 #include "bootloader_common.h"      // Bootloader content accessible by applications
+#include "recovery.h"               // Recovery transport
+#include "boot_stats.h"             // Boot statistics
+#include "reset_cause.h"            // Reset cause decoder and reset counts
+#include "trial_boot.h"             // Trial boots
 
 /* CONSTANT DEFINITIONS AND MACROS */
-#define BOOTLOADER_VERSION 0x00000001
+#define BOOTLOADER_VERSION BOOTLOADER_INTERFACE_VERSION // Stored in bootloader data and returned by getBootloaderVersion
 
 /* TYPE DEFINITIONS AND ENUMERATIONS */
 
@@ -28,6 +32,11 @@ Bootloader logic code
 
 
 /* FUNCTIONS */
+uint8_t isApplicationExcluded(uint8_t app, BootloaderData_T *bootloaderData); // Check for application exclusion factors (not installed or fault threshold exceeded)
+uint8_t isApplicationPreferred(uint8_t app, uint8_t other, BootloaderData_T *bootloaderData); // Check whether an application should be tried before another (boot priority, or same ID as application 1 and a higher version)
+uint8_t isVectorTableValid(uint8_t app); // Check that the initial stack pointer of an application lies in SRAM and its reset handler is a thumb address in its application space
+void fastBoot(uint8_t timed, ResetCause_T cause); // Start the application recorded by a fast boot mark if the reset allows it (returns if a full boot is needed), timed if the boot timer was started
+uint8_t verifyApplication(uint8_t app, BootloaderData_T *bootloaderData, uint8_t recheck); // Verify an application according to the verification mode
 void main(); // Main function (bootloader logic)
 
 #endif
\ No newline at end of file
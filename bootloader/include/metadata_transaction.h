@@ -0,0 +1,43 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Metadata transaction (header)
+Batches bootloader data changes in a RAM shadow, written to the bootloader data journal as one record
+*/
+
+/* INCLUDE GUARD */
+#pragma once
+#ifndef METADATA_TRANSACTION_H
+#define METADATA_TRANSACTION_H
+
+/* DEPENDENCIES */
+#include <stdint.h>                 // Fixed width integer data types
+#include "bootloader.h"             // Bootloader functions
+
+/* CONSTANT DEFINITIONS AND MACROS */
+
+
+/* TYPE DEFINITIONS AND ENUMERATIONS */
+
+typedef struct { // Struct type definition for a metadata transaction (bootloader .bss, so a reset discards an uncommitted transaction)
+    BootloaderData_T data; // Bootloader data with the changes made since the transaction began
+    uint8_t open; // Transaction open (setters change data instead of writing bootloader data)
+    uint8_t trialApp; // Application space installed in the transaction, put on trial when it is committed (0 if none)
+    BootPriority_T trialFallbackPriority; // Boot priority when that application was installed (restored if it is rolled back)
+} MetadataTransaction_T;
+
+/* GLOBAL VARIABLES */
+extern MetadataTransaction_T metadataTransaction; // Metadata transaction (.bss, cleared at boot)
+
+/* FUNCTIONS */
+
+const BootloaderData_T *transaction_readData(); // Get a pointer to the bootloader data as the application sees it (the transaction's changes while one is open, otherwise the current bootloader data in flash)
+BootloaderData_T transaction_getData(); // Get a copy of the bootloader data as the application sees it (to change and write back with transaction_writeData)
+BootloaderStatus_T transaction_writeData(BootloaderData_T data); // Write bootloader data to flash, or keep it in the transaction while one is open
+void transaction_stageInstall(const BootloaderData_T *data, uint8_t app); // Keep bootloader data with newly installed application info in the open transaction (the application is put on trial when it is committed)
+BootloaderStatus_T beginMetadataTransaction(); // Begin a metadata transaction (setters change a RAM shadow of bootloader data until it is committed)
+BootloaderStatus_T commitMetadataTransaction(); // Write the changes made in the metadata transaction as one bootloader data record and end it
+BootloaderStatus_T abortMetadataTransaction(); // Discard the changes made in the metadata transaction and end it (nothing is written)
+
+#endif
@@ -0,0 +1,73 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Recovery transport (header)
+Bootloader-resident application upload over USART2 (DMA circular double-buffered receive), used when no application can be started
+*/
+
+/* INCLUDE GUARD */
+#pragma once
+#ifndef RECOVERY_H
+#define RECOVERY_H
+
+/* DEPENDENCIES */
+#include <stdint.h>                 // Fixed width integer data types
+#include "bootloader.h"             // Bootloader functions
+#include "decompress.h"             // Compressed update images
+
+/* CONSTANT DEFINITIONS AND MACROS */
+#define RECOVERY_BAUD_RATE 1000000      // USART2 baud rate (ST-LINK virtual COM port on NUCLEO boards, exact from the 16MHz clock)
+#define RECOVERY_CLOCK_HZ 16000000      // USART2 kernel clock and SysTick clock (PCLK/HCLK, the bootloader runs from the 16MHz HSI)
+#define RECOVERY_BLOCK_SIZE 2048        // Receive buffer half (bytes) (one flash page, received while the other half is written)
+#define RECOVERY_BUFFER_SIZE (2*RECOVERY_BLOCK_SIZE) // DMA circular receive buffer (bytes)
+#define RECOVERY_DMA_REQUEST 52         // DMAMUX request for USART2 receive (RM0444 DMAMUX request table)
+#define RECOVERY_TIMEOUT_MS 500         // An upload is abandoned after at least this long without data (and the line must be idle this long before the next one)
+
+#define RECOVERY_MAGIC 0x52444C42       // Recovery upload header magic number ("BLDR")
+#define RECOVERY_READY 0x52             // Sent when waiting for an upload ('R')
+#define RECOVERY_ACK 0x06               // Sent when a block has been written (the host may then send the block after next)
+#define RECOVERY_RESULT 0x53            // Sent at the end of an upload, followed by the status byte ('S')
+
+/* TYPE DEFINITIONS AND ENUMERATIONS */
+
+typedef enum { // Recovery upload formats
+    RECOVERY_FORMAT_BINARY,                 // Application binary (double-word padded)
+    RECOVERY_FORMAT_COMPRESSED              // Compressed update image (make_compressed_update.py)
+} RecoveryFormat_T;
+
+typedef struct { // Struct type definition for a recovery upload header (sent before the application data)
+    uint32_t magic; // Header magic number (RECOVERY_MAGIC)
+    uint8_t app; // Application space to install to
+    uint8_t format; // Upload format (RecoveryFormat_T)
+    uint8_t _PADDING[2];
+    uint32_t length; // Application data bytes following the header
+    AppInfo_T info; // Application info (written once the application is installed and checked against it)
+    uint32_t headerChecksum; // CRC32 checksum of the preceding header fields
+} RecoveryHeader_T;
+
+typedef struct { // Struct type definition for a recovery upload in progress
+    RecoveryHeader_T header; // Upload header
+    uint32_t received; // Bytes received (header included)
+    AppWriter_T writer; // Streaming writer (binary uploads)
+    CompressedImage_T image; // Decompressor (compressed uploads)
+} RecoveryTransfer_T;
+
+/* GLOBAL VARIABLES */
+
+
+/* FUNCTIONS */
+
+void recoveryMode(); // Receive applications over the recovery transport until one is installed, then reset (does not return)
+void recovery_init(uint8_t *buffer); // Configure USART2 with DMA circular reception into buffer (RECOVERY_BUFFER_SIZE bytes) and the SysTick millisecond timer
+void recovery_start(uint8_t *buffer); // Restart DMA reception at the start of buffer
+uint32_t recovery_head(); // Offset in the receive buffer of the next byte DMA will write
+uint8_t recovery_tick(); // Check whether a millisecond has passed since the last check (at least one SysTick period)
+void recovery_drain(); // Discard received data until the line has been idle for RECOVERY_TIMEOUT_MS
+void recovery_transmit(uint8_t byte); // Send a byte to the host
+BootloaderStatus_T recovery_receive(RecoveryTransfer_T *transfer, const uint8_t *data, uint32_t length); // Process received upload data (header, then application data written as it arrives)
+BootloaderStatus_T recovery_open(RecoveryTransfer_T *transfer); // Check a received upload header and start writing its application space (flash unlocked)
+BootloaderStatus_T recovery_finish(RecoveryTransfer_T *transfer); // Finish an upload, check the application written against its info and write the info (flash unlocked)
+uint8_t recovery_isComplete(RecoveryTransfer_T *transfer); // Check whether all data of an upload has been received
+
+#endif
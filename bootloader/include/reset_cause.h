@@ -0,0 +1,54 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Reset cause (header)
+Reset cause decoder, hard fault breadcrumb, per-application reset counts and the fault policy
+*/
+
+/* INCLUDE GUARD */
+#pragma once
+#ifndef RESET_CAUSE_H
+#define RESET_CAUSE_H
+
+/* DEPENDENCIES */
+#include <stdint.h>                 // Fixed width integer data types
+#include "bootloader.h"             // Bootloader functions
+
+/* CONSTANT DEFINITIONS AND MACROS */
+#define RESETCAUSE_FAULT_MAGIC 0xFA17   // Reset record magic number written by the hard fault handler (breadcrumb for the next boot)
+#define RESETCAUSE_INFO_MAGIC 0x5253    // Reset record magic number once the boot has decoded the reset cause ("RS")
+
+/* TYPE DEFINITIONS AND ENUMERATIONS */
+
+typedef struct { // Struct type definition for the reset record kept in bootloader static SRAM (hard fault breadcrumb, then the decoded reset cause)
+    uint16_t magic; // RESETCAUSE_FAULT_MAGIC or RESETCAUSE_INFO_MAGIC (anything else is not a record, SRAM is undefined after power-on)
+    ResetCause_T cause; // Decoded reset cause
+    uint8_t app; // Application space that was running when the reset happened (0 if not known)
+    uint32_t faultAddress; // Address of the instruction that hard faulted (stacked PC, 0 for other causes)
+} ResetRecord_T;
+
+typedef struct { // Struct type definition for the reset counts (payload of a reset counts entry in the bootloader data journal)
+    uint16_t faultPolicy; // Reset causes counted as application faults (FAULT_POLICY bits)
+    uint8_t count[BL_APP_SLOTS][RESET_CAUSES]; // Resets of each cause while each application was running (application space n at index n - 1, saturate at 255)
+} ResetCounts_T;
+_Static_assert(offsetof(ResetCounts_T, count) == 2, "reset counts moved (entries already in the journal are read with this layout)");
+
+/* GLOBAL VARIABLES */
+extern uint8_t appSelection; // Application space selected at boot (bootloader static SRAM, kept across warm resets to attribute them)
+extern ResetRecord_T resetRecord; // Reset record (bootloader static SRAM, not cleared at boot)
+
+/* FUNCTIONS */
+
+ResetInfo_T resetCause_decode(); // Decode the cause of the last reset from the RCC reset flags and the hard fault breadcrumb, record it for getResetInfo and clear the flags
+uint8_t resetCause_isCounted(ResetCause_T cause); // Check whether resets of a cause are counted against the application that was running (FAULT_POLICY_COUNTED)
+uint8_t resetCause_readCounts(ResetCounts_T *counts); // Read the reset counts and fault policy from the bootloader data journal (1 if found, 0 and the defaults if none were written)
+uint8_t resetCause_count(uint8_t app, ResetCause_T cause); // Count a reset against an application (flash unlocked), 1 if the fault policy counts it as an application fault
+void resetCause_recordHardFault(uint32_t faultAddress); // Leave a hard fault breadcrumb for the next boot and reset (does not return)
+__attribute__((naked)) void hardFaultHandler(); // Hard fault handler (finds the stacked PC, moves the stack to the top of SRAM and records the hard fault)
+BootloaderStatus_T getResetInfo(ResetInfo_T *info); // Get the cause of the last reset
+uint8_t app_getResetCount(uint8_t app, ResetCause_T cause); // Get the number of resets of a cause while an application was running
+uint16_t getFaultPolicy(); // Get the reset causes counted as application faults
+BootloaderStatus_T setFaultPolicy(uint16_t policy); // Set the reset causes counted as application faults
+
+#endif
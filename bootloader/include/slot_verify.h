@@ -0,0 +1,39 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Slot verification (header)
+Background verification of an application space from the running application, a bounded number of bytes per step, with the result recorded for the next boot
+*/
+
+/* INCLUDE GUARD */
+#pragma once
+#ifndef SLOT_VERIFY_H
+#define SLOT_VERIFY_H
+
+/* DEPENDENCIES */
+#include <stdint.h>                 // Fixed width integer data types
+#include "bootloader.h"             // Bootloader functions
+
+/* CONSTANT DEFINITIONS AND MACROS */
+
+
+/* TYPE DEFINITIONS AND ENUMERATIONS */
+
+typedef enum { // Slot verifier states
+    SLOT_VERIFY_IDLE,                       // No pass in progress (the next step starts one)
+    SLOT_VERIFY_CHECKING,                   // Checksumming the application a step at a time
+    SLOT_VERIFY_RECORDING                   // Whole application checked, result waiting to be recorded in bootloader data
+} SlotVerifierState_T;
+
+/* GLOBAL VARIABLES */
+
+
+/* FUNCTIONS */
+
+BootloaderStatus_T slotVerify_begin(SlotVerifier_T *verifier, uint8_t app, const BootloaderData_T *bootloaderData); // Start a verification pass over an application space (BL_ERROR if it holds no application or its info is corrupt)
+uint8_t slotVerify_isCurrent(SlotVerifier_T *verifier, const BootloaderData_T *bootloaderData); // Check that the application space and its info have not changed since the pass started
+BootloaderStatus_T slotVerify_record(SlotVerifier_T *verifier); // Record the result of a finished pass in bootloader data (BL_BUSY while a metadata transaction is open, or if the application changed during the pass, which then starts again)
+BootloaderStatus_T verifySlotStep(SlotVerifier_T *verifier, uint8_t app, uint32_t budget); // Checksum up to budget bytes of an application (BL_BUSY until the pass ends, then BL_OK or BL_ERROR_CHECKSUM, recorded for the next boot)
+
+#endif
@@ -0,0 +1,39 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Trial boot (header)
+Trial boots of updated applications, rolled back unless the application confirms itself
+*/
+
+/* INCLUDE GUARD */
+#pragma once
+#ifndef TRIAL_BOOT_H
+#define TRIAL_BOOT_H
+
+/* DEPENDENCIES */
+#include <stdint.h>                 // Fixed width integer data types
+#include "bootloader.h"             // Bootloader functions
+
+/* CONSTANT DEFINITIONS AND MACROS */
+
+
+/* TYPE DEFINITIONS AND ENUMERATIONS */
+
+
+/* GLOBAL VARIABLES */
+
+
+/* FUNCTIONS */
+
+uint8_t trialBoot_read(TrialInfo_T *trial); // Read the trial boot state from the bootloader data journal (1 if found, 0 and trial boots off if none was written)
+uint8_t trialBoot_isOnTrial(const TrialInfo_T *trial, uint8_t app); // Check whether an application is on trial (installed since trial boots were turned on and not yet confirmed)
+uint8_t trialBoot_isExpired(const TrialInfo_T *trial); // Check whether the application on trial has used all its trial boots without being confirmed
+BootloaderStatus_T trialBoot_begin(uint8_t app, BootPriority_T fallbackPriority); // Put a newly installed application on trial if trial boots are on (flash unlocked)
+BootloaderStatus_T trialBoot_countBoot(TrialInfo_T *trial); // Use one of the trial boots of the application on trial (flash unlocked)
+BootloaderStatus_T trialBoot_rollBack(TrialInfo_T *trial, BootloaderData_T *bootloaderData); // Restore the boot priority from before the update on trial and exclude it like a faulty application (flash unlocked)
+BootloaderStatus_T confirmImage(); // Confirm the running application (ends its trial)
+BootloaderStatus_T getTrialInfo(TrialInfo_T *info); // Get the trial boot setting and the application on trial
+BootloaderStatus_T setTrialBoots(uint8_t boots); // Set the trial boots given to each update (0 for off, which also ends any trial)
+
+#endif
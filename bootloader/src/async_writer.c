@@ -0,0 +1,188 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Asynchronous writer (implementation)
+Application writer programmed from the flash end of operation interrupt, so the application can keep receiving while flash programs
+*/
+
+/* DEPENDENCIES */
+#include "async_writer.h"
+#include "boot_stats.h"             // Boot statistics
+
+/* CONSTANT DEFINITIONS AND MACROS */
+
+
+/* GLOBAL VARIABLES */
+AsyncWriter_T *activeAsyncWriter; // Asynchronous writer the flash interrupt is programming for (NULL if none) (.bss, cleared at boot)
+
+/* FUNCTIONS */
+
+BootloaderStatus_T asyncWriter_open(AsyncWriter_T *writer, uint8_t app, uint32_t address, uint8_t *buffer, uint32_t size, void (*callback)(AsyncWriter_T *writer)){ // Open an asynchronous writer to an application space at address with a ring buffer of size bytes (flash unlocked, pages erased as they are written)
+    writer->status = BL_ERROR;
+    if (activeAsyncWriter != NULL) {return BL_BUSY;} // One asynchronous writer at a time (the flash controller runs one operation at a time)
+    if (!IS_APP_SLOT(app)) {return BL_ERROR_OUT_OF_RANGE;} // Check application space
+    if (address % 8) {return BL_ERROR_DATA_ALIGNMENT;} // Check for correct address alignment (double-word aligned)
+    if (size == 0 || size % 8) {return BL_ERROR_DATA_ALIGNMENT;} // Whole double-words, so double-words never wrap around the ring buffer
+    if (address > APP_SLOT_LENGTH(app)) {return BL_ERROR_OUT_OF_RANGE;} // Check that write starts within application space
+
+    BootloaderStatus_T status = invalidateVerification(app); // Application is no longer verified
+    if (status != BL_OK) {return status;}
+
+    writer->buffer = buffer;
+    writer->bufferSize = size;
+    writer->base = APP_SLOT_START(app);
+    writer->length = APP_SLOT_LENGTH(app);
+    writer->origin = address;
+    writer->address = address;
+    writer->programmedAddress = address;
+    writer->operationAddress = address;
+    writer->erasedAddress = (address + FLASH_PAGE_SIZE - 1) & ~(FLASH_PAGE_SIZE - 1); // Page holding address (if not its start) is already being written
+    writer->callback = callback;
+    writer->operation = ASYNC_OPERATION_NONE;
+    writer->complete = 0;
+    writer->closing = 0;
+    writer->app = app;
+    erasedPageCount = 0;
+    if (address == 0) {
+        resetWriteChecksum(app); // Application space written from its start, pages erased as it is written
+    } else if (writer->erasedAddress < writeChecksum[app - 1].length) {
+        writeChecksum[app - 1].tracking = 0; // Data in the running checksum will be erased
+    }
+
+    writer->status = BL_BUSY;
+    activeAsyncWriter = writer;
+    NVIC_EnableIRQ(FLASH_IRQn); // End of operation interrupts start the next operation
+    return BL_OK;
+}
+
+BootloaderStatus_T asyncWriter_push(AsyncWriter_T *writer, const void *data, uint32_t length){ // Queue data of any length to be programmed in the background (BL_BUSY, and nothing queued, until the ring buffer has room for all of it)
+    if (writer->status != BL_BUSY) {return (writer->status == BL_OK) ? BL_ERROR : writer->status;} // Finished, or the error that stopped it
+    if (writer->closing) {return BL_ERROR;}
+    if (length > writer->length - writer->address) {return BL_ERROR_OUT_OF_RANGE;} // Check that write lies within application space
+    if (length > asyncWriter_getSpace(writer)) {return BL_BUSY;} // Try again once more has been programmed
+
+    const uint8_t *bytes = (const uint8_t *) data;
+    uint32_t offset = (writer->address - writer->origin) % writer->bufferSize;
+    for (uint32_t i = 0; i < length; i++) {
+        writer->buffer[offset] = bytes[i];
+        if (++offset == writer->bufferSize) {offset = 0;}
+    }
+    writer->address += length;
+
+    __disable_irq(); // Start programming if flash is idle (the interrupt starts the next operation otherwise)
+    asyncWriter_next(writer);
+    __enable_irq();
+    return BL_OK;
+}
+
+uint32_t asyncWriter_getSpace(AsyncWriter_T *writer){ // Get the number of bytes that can be queued now
+    if (writer->status != BL_BUSY || writer->closing) {return 0;}
+    uint32_t space = writer->bufferSize - (writer->address - writer->programmedAddress); // Ring buffer space is freed once data is programmed and verified
+    return (space < writer->length - writer->address) ? space : writer->length - writer->address;
+}
+
+BootloaderStatus_T asyncWriter_close(AsyncWriter_T *writer){ // Program any remaining data and finish (completes in the background)
+    if (writer->status != BL_BUSY) {return (writer->status == BL_OK) ? BL_ERROR : writer->status;}
+    writer->closing = 1;
+    __disable_irq();
+    asyncWriter_next(writer);
+    __enable_irq();
+    return BL_OK;
+}
+
+BootloaderStatus_T asyncWriter_getStatus(AsyncWriter_T *writer){ // Get the status of an asynchronous writer (BL_BUSY until it finishes or fails)
+    return writer->status;
+}
+
+void asyncWriter_irqHandler(){ // Flash interrupt handler for asynchronous writers (call from the application's FLASH_IRQHandler)
+    HAL_FLASH_IRQHandler(); // Ends the operation (HAL callbacks) and releases the HAL lock, so the next operation can only start afterwards
+    AsyncWriter_T *writer = activeAsyncWriter;
+    if (writer == NULL || !writer->complete) {return;}
+    writer->complete = 0;
+    asyncWriter_complete(writer);
+    asyncWriter_next(writer);
+}
+
+void asyncWriter_next(AsyncWriter_T *writer){ // Start the next flash operation of an asynchronous writer, or finish it once closed and all data is programmed (flash interrupt or interrupts masked)
+    if (writer->status != BL_BUSY || writer->operation != ASYNC_OPERATION_NONE) {return;} // Stopped, or the interrupt continues when the operation in progress ends
+    uint32_t start = writer->programmedAddress;
+    uint32_t queued = writer->address - start;
+    if (queued == 0 || (!writer->closing && queued < 8)) { // Wait for a whole double-word unless closing
+        if (queued == 0 && writer->closing) {asyncWriter_finish(writer, BL_OK);}
+        return;
+    }
+
+    if (start >= writer->erasedAddress) { // Lazy erase, first write to this page (skipped if already blank)
+        uint32_t page = (writer->base + writer->erasedAddress - FLASH_BASE)/FLASH_PAGE_SIZE;
+        writer->erasedAddress += FLASH_PAGE_SIZE;
+        if (!isFlashPageBlank(page)) {
+            // Flash erase parameters
+            FLASH_EraseInitTypeDef flashErase = {0};
+            flashErase.TypeErase = FLASH_TYPEERASE_PAGES;
+            flashErase.Page = page;
+            flashErase.NbPages = 1;
+            writer->operation = ASYNC_OPERATION_ERASE;
+            if (HAL_FLASHEx_Erase_IT(&flashErase) != HAL_OK) {
+                writer->operation = ASYNC_OPERATION_NONE;
+                asyncWriter_finish(writer, BL_ERROR_HAL);
+                return;
+            }
+            erasedPageCount++;
+            bootStats_countErase(1, 0, BL_OK); // Not timed (operations overlap the application)
+            return;
+        }
+    }
+
+    // One double-word per operation: fast row programming cannot run from the interrupt, as it masks interrupts and
+    // stalls the core for the whole row (HAL FLASH_Program_Fast), which would stop the application receiving
+    uint8_t *data = writer->buffer + (start - writer->origin) % writer->bufferSize; // Double-words are contiguous in the ring buffer
+    uint32_t count = (queued < 8) ? queued : 8;
+    writer->tail = 0xFFFFFFFFFFFFFFFF; // Last double-word when closing is padded with erased bytes
+    for (uint32_t i = 0; i < count; i++) {
+        ((uint8_t *) &writer->tail)[i] = data[i];
+    }
+    writer->operationAddress = start + count;
+    writer->operation = ASYNC_OPERATION_PROGRAM;
+    if (HAL_FLASH_Program_IT(FLASH_TYPEPROGRAM_DOUBLEWORD, writer->base + start, writer->tail) != HAL_OK) {
+        writer->operation = ASYNC_OPERATION_NONE;
+        asyncWriter_finish(writer, BL_ERROR_HAL);
+    }
+}
+
+void asyncWriter_complete(AsyncWriter_T *writer){ // Verify the data programmed by the operation that has ended and free its ring buffer space (flash interrupt)
+    uint8_t operation = writer->operation;
+    writer->operation = ASYNC_OPERATION_NONE;
+    if (operation != ASYNC_OPERATION_PROGRAM) {return;} // Page erased, its first row can be programmed
+
+    uint32_t start = writer->programmedAddress;
+    uint32_t length = writer->operationAddress - start;
+    uint8_t *data = writer->buffer + (start - writer->origin) % writer->bufferSize;
+    uint8_t *flash = (uint8_t *) (writer->base + start);
+    for (uint32_t i = 0; i < length; i++) { // Verify written data
+        if (flash[i] != data[i]) {
+            asyncWriter_finish(writer, BL_ERROR_WRITE_VERIFICATION);
+            return;
+        }
+    }
+    updateWriteChecksum(writer->app, start, length); // Add written data to the running checksum
+    bootStats_countProgram(length, 0, BL_OK); // Not timed (operations overlap the application)
+    writer->programmedAddress = writer->operationAddress;
+}
+
+void asyncWriter_finish(AsyncWriter_T *writer, BootloaderStatus_T status){ // Stop an asynchronous writer with its final status and call its callback
+    writer->status = status;
+    activeAsyncWriter = NULL;
+    if (status != BL_OK) {bootStats_countProgram(0, 0, status);} // Count the failure
+    if (writer->callback != NULL) {writer->callback(writer);}
+}
+
+void HAL_FLASH_EndOfOperationCallback(uint32_t ReturnValue){ // Flash operation ended (HAL callback from HAL_FLASH_IRQHandler, overrides the weak HAL function)
+    if (activeAsyncWriter != NULL) {activeAsyncWriter->complete = 1;}
+}
+
+void HAL_FLASH_OperationErrorCallback(uint32_t ReturnValue){ // Flash operation failed (HAL callback from HAL_FLASH_IRQHandler, overrides the weak HAL function)
+    if (activeAsyncWriter == NULL) {return;}
+    activeAsyncWriter->operation = ASYNC_OPERATION_NONE;
+    asyncWriter_finish(activeAsyncWriter, BL_ERROR_HAL);
+}
@@ -0,0 +1,145 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Boot statistics (implementation)
+Boot and update timing and counters, kept in bootloader static SRAM and persisted to the bootloader data journal in batches
+*/
+
+/* DEPENDENCIES */
+#include <stddef.h>                 // NULL
+#include "boot_stats.h"
+
+/* CONSTANT DEFINITIONS AND MACROS */
+
+
+/* GLOBAL VARIABLES */
+BootStatsBlock_T bootStats __attribute__((section(".sram_bl_static"))); // Boot statistics (bootloader static SRAM, not cleared at boot)
+uint8_t bootStatsTimerStarted; // TIM2 started by bootStats_startTimer and not yet stopped (.bss, cleared at boot)
+
+/* FUNCTIONS */
+
+uint8_t bootStats_startTimer(){ // Start TIM2 counting from zero if it is free (1 if started, 0 if the application or an outer measurement is using it)
+    if (RCC->APBENR1 & RCC_APBENR1_TIM2EN) {return 0;} // Clock enabled, the timer is in use (the bootloader leaves it disabled)
+    RCC->APBENR1 |= RCC_APBENR1_TIM2EN; // Enable TIM2 clock
+
+    // Free-running 32-bit up-counter at the kernel clock (overwrites any settings an application left)
+    TIM2->CR1 = 0;
+    TIM2->PSC = 0;
+    TIM2->ARR = 0xFFFFFFFF;
+    TIM2->EGR = TIM_EGR_UG; // Load the prescaler and clear the counter
+    TIM2->SR = 0;
+    TIM2->CR1 = TIM_CR1_CEN;
+    bootStatsTimerStarted = 1;
+    return 1;
+}
+
+uint32_t bootStats_readTimer(){ // Read the TIM2 count (cycles since bootStats_startTimer)
+    return TIM2->CNT;
+}
+
+uint32_t bootStats_stopTimer(uint8_t started){ // Stop TIM2 if bootStats_startTimer started it, returning the cycles counted (0 if it did not start it)
+    if (!started) {return 0;}
+    uint32_t cycles = TIM2->CNT;
+    TIM2->CR1 = 0; // Stop and clear the counter, then disable the clock (left as the application finds it after reset)
+    TIM2->CNT = 0;
+    RCC->APBENR1 &= ~RCC_APBENR1_TIM2EN;
+    bootStatsTimerStarted = 0;
+    return cycles;
+}
+
+uint8_t bootStats_isTimerRunning(){ // Check whether TIM2 is counting for a bootloader measurement (nested measurements can read it)
+    return bootStatsTimerStarted && (RCC->APBENR1 & RCC_APBENR1_TIM2EN); // Clock check covers a measurement cut short by a reset
+}
+
+
+uint32_t bootStats_checkWord(){ // Calculate the check word of the statistics in SRAM
+    uint32_t check = BOOTSTATS_SEAL;
+    for (uint32_t i = 0; i < sizeof(BootStats_T)/4; i++) {
+        check ^= ((uint32_t *) &bootStats.stats)[i];
+    }
+    return check;
+}
+
+uint8_t bootStats_isValid(){ // Check the statistics in SRAM
+    return bootStats_checkWord() == bootStats.check;
+}
+
+void bootStats_seal(){ // Update the check word after changing the statistics in SRAM
+    bootStats.check = bootStats_checkWord();
+}
+
+void bootStats_beginBoot(){ // Restore the statistics from flash if SRAM lost them (power-on) and clear the per-boot figures
+    if (!bootStats_isValid()) {
+        fillBytes(&bootStats.stats, 0, sizeof(BootStats_T)); // Counted from zero if none were persisted
+        uint8_t page;
+        int32_t offset = findBootloaderEntry(BL_STATS_TAG, &page);
+        if (offset >= 0) {
+            BootStatsRecord_T *record = (BootStatsRecord_T *)(BL_DATA_PAGE_ADDRESS(page) + offset);
+            copyBytes(&bootStats.stats, &record->stats, (record->header.length < sizeof(BootStats_T)) ? record->header.length : sizeof(BootStats_T)); // Fields added since it was written stay zero
+        }
+    }
+    for (uint8_t i = 0; i < BL_APP_SLOTS; i++) {
+        bootStats.stats.verifyCycles[i] = 0;
+    }
+    bootStats_seal();
+}
+
+void bootStats_countBoot(uint32_t cycles){ // Count a boot that took cycles
+    if (!bootStats_isValid()) {return;}
+    bootStats.stats.boots++;
+    bootStats.stats.bootCycles = cycles;
+    bootStats_seal();
+}
+
+void bootStats_countVerify(uint8_t app, uint32_t cycles, uint8_t valid){ // Count the verification of an application at boot
+    if (!bootStats_isValid() || !IS_APP_SLOT(app)) {return;}
+    bootStats.stats.verifyCycles[app - 1] = cycles;
+    if (!valid) {bootStats.stats.verifyFailures++;}
+    bootStats_seal();
+}
+
+void bootStats_countErase(uint32_t pages, uint32_t cycles, BootloaderStatus_T status){ // Count application pages erased
+    if (!bootStats_isValid()) {bootStats_beginBoot();} // Not counted since power-on (restored from flash)
+    bootStats.stats.erasePages += pages;
+    bootStats.stats.eraseCycles += cycles;
+    if (status != BL_OK) {bootStats.stats.writeFailures++;}
+    bootStats_seal();
+}
+
+void bootStats_countProgram(uint32_t bytes, uint32_t cycles, BootloaderStatus_T status){ // Count application bytes programmed
+    if (!bootStats_isValid()) {bootStats_beginBoot();} // Not counted since power-on (restored from flash)
+    bootStats.stats.programBytes += bytes;
+    bootStats.stats.programCycles += cycles;
+    if (status != BL_OK) {bootStats.stats.writeFailures++;}
+    bootStats_seal();
+}
+
+uint8_t bootStats_isPersistDue(){ // Check whether BOOTSTATS_BATCH boots have been counted since the statistics were last persisted
+    if (!bootStats_isValid()) {return 0;}
+    uint8_t page;
+    int32_t offset = findBootloaderEntry(BL_STATS_TAG, &page);
+    uint32_t persisted = (offset >= 0) ? ((BootStatsRecord_T *)(BL_DATA_PAGE_ADDRESS(page) + offset))->stats.boots : 0;
+    return bootStats.stats.boots - persisted >= BOOTSTATS_BATCH;
+}
+
+BootloaderStatus_T bootStats_persist(){ // Append the statistics to the bootloader data journal (flash unlocked)
+    if (!bootStats_isValid()) {return BL_ERROR;}
+    BootloaderJournal_T journal;
+    findBootloaderRecord(&journal, 0); // Appended after the newest record and its tick marks
+    if (!isBootloaderDataErased(journal.page, journal.end, BL_ENTRY_SIZE(sizeof(BootStats_T)))) { // Page full, compact the journal (the statistics are written after the compacted record)
+        return compactBootloaderJournal();
+    }
+    return bootStats_write(journal.page, journal.end);
+}
+
+BootloaderStatus_T bootStats_write(uint8_t page, uint32_t offset){ // Write a boot statistics entry at offset in a bootloader data page (flash unlocked, target erased)
+    return writeBootloaderEntry(page, offset, BL_STATS_TAG, &bootStats.stats, sizeof(BootStats_T));
+}
+
+BootloaderStatus_T getBootStats(BootStats_T *stats){ // Get the boot and update statistics
+    if (stats == NULL) {return BL_ERROR;}
+    if (!bootStats_isValid()) {bootStats_beginBoot();} // Not counted since power-on (restored from flash)
+    *stats = bootStats.stats;
+    return BL_OK;
+}
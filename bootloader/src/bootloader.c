@@ -7,12 +7,28 @@ Bootloader and update functions
 */
 
 /* DEPENDENCIES */
+#include <stddef.h>                 // offsetof
 #include "bootloader.h"
+#include "delta.h"                  // Delta update patch applier
+#include "decompress.h"             // Compressed update image decompressor
+#include "async_writer.h"           // Asynchronous writer
+#include "boot_stats.h"             // Boot statistics
+#include "reset_cause.h"            // Reset cause decoder and reset counts
+#include "trial_boot.h"             // Trial boots
+#include "metadata_transaction.h"   // Metadata transactions
+#include "crc_engine.h"             // CRC engine
+#include "slot_verify.h"            // Background slot verification
+#include "flash_ram.h"              // RAM flash routines
 
 /* CONSTANT DEFINITIONS AND MACROS */
 
 
 /* GLOBAL VARIABLES */
+const struct BootloaderExtensions dispatchExtensions = { // Functions added once the dispatch table was full (reached through its extensions entry)
+    BL_EXTENSIONS_VERSION,
+    setFlashRam
+};
+
 struct BootloaderFunctions dispatchTable __attribute__((section(".dispatch_table"))) = { // Dispatch table for application accessible bootloader functions
     getBootloaderVersion,
     getBootPriority,
@@ -35,76 +51,498 @@ struct BootloaderFunctions dispatchTable __attribute__((section(".dispatch_table
     app2_getInfo,
     app2_erase,
     app2_write,
-    app2_writeInfo
+    app2_writeInfo,
+    appWriter_open,
+    appWriter_push,
+    appWriter_close,
+    getWriteChecksum,
+    app_getFaultCount,
+    app_resetFaultCount,
+    app_getInfo,
+    app_erase,
+    app_write,
+    app_writeInfo,
+    app_eraseRange,
+    appWriter_openErase,
+    getErasedPageCount,
+    deltaPatch_open,
+    deltaPatch_push,
+    deltaPatch_close,
+    compressedImage_open,
+    compressedImage_push,
+    compressedImage_close,
+    asyncWriter_open,
+    asyncWriter_push,
+    asyncWriter_getSpace,
+    asyncWriter_close,
+    asyncWriter_getStatus,
+    asyncWriter_irqHandler,
+    getFastBootMode,
+    setFastBootMode,
+    getBootloaderView,
+    getBootStats,
+    hardFaultHandler,
+    getResetInfo,
+    app_getResetCount,
+    getFaultPolicy,
+    setFaultPolicy,
+    confirmImage,
+    getTrialInfo,
+    setTrialBoots,
+    beginMetadataTransaction,
+    commitMetadataTransaction,
+    abortMetadataTransaction,
+    verifySlotStep,
+    &dispatchExtensions
 };
+#ifndef HOST_SIM // Host pointers are wider (the offset holds on the device only)
+_Static_assert(offsetof(struct BootloaderFunctions, hardFaultHandler) == _BOOTLOADER_HARDFAULT_HANDLER_OFFSET, "_BOOTLOADER_HARDFAULT_HANDLER_OFFSET does not match the dispatch table");
+_Static_assert(sizeof(struct BootloaderFunctions) <= 0x100, "Dispatch table does not fit the last 256 bytes of bootloader flash");
+#endif
+_Static_assert(sizeof(struct BootloaderFunctions)/sizeof(void (*)(void)) <= _BOOTLOADER_FUNCTION_ENTRIES, "Dispatch table has more entries than the last 256 bytes of bootloader flash hold"); // Entry count (holds on the host too)
+_Static_assert(offsetof(struct BootloaderFunctions, hardFaultHandler)/sizeof(void (*)(void)) == _BOOTLOADER_HARDFAULT_HANDLER_OFFSET/4, "hardFaultHandler is not the dispatch table entry _BOOTLOADER_HARDFAULT_HANDLER_OFFSET points to"); // Entry number (holds on the host too)
+
+const AppSlot_T appSlots[BL_APP_SLOTS] = {BL_APP_SLOT_REGIONS(APP_SLOT_DESCRIPTOR)}; // Application space descriptors (from memory_map.ld regions)
+WriteChecksum_T writeChecksum[BL_APP_SLOTS]; // Running checksums of the data written to each application space (.bss, cleared at boot)
+uint32_t erasedPageCount; // Pages erased by the last application erase or lazily erasing streaming writer (.bss, cleared at boot)
+uint32_t verificationEpoch[BL_APP_SLOTS]; // Changes to each application space since boot (.bss, cleared at boot, incremented when its verification record is invalidated or a streaming writer programs it)
+const BootloaderData_T *currentBootloaderData; // Current bootloader data in flash (.bss, cleared at boot, found on first use and cleared when bootloader data is written)
+static uint16_t currentBootloaderDataLength; // Length of the current bootloader data (.bss, set with currentBootloaderData)
+static uint16_t currentBootloaderDataLayout; // Layout version of the current bootloader data (.bss, set with currentBootloaderData)
+static const uint8_t erasedBootloaderData[sizeof(BootloaderData_T)] = {[0 ... sizeof(BootloaderData_T) - 1] = 0xFF}; // Bootloader data read when the journal has no valid records (erased)
 
 /* FUNCTIONS */
 
-BootloaderData_T getBootloaderData(){ // Get bootloader data from flash
-    BootloaderData_T *bootloaderDataFlash = (BootloaderData_T *)&__FLASH_BL_DATA_START; // Pointer to bootloader data in flash
-    BootloaderData_T bootloaderData = *bootloaderDataFlash; // Copy bootloader data to RAM
-    return bootloaderData; // Return RAM copy of bootloader data
+uint32_t calculateChecksum(void *data, uint32_t length){ // Calculate the CRC32 checksum of data (standard CRC32, as binascii.crc32)
+    return accumulateChecksum(0, data, length);
 }
 
-BootloaderStatus_T writeBootloaderData(BootloaderData_T data){ // Write bootloader data to flash
-    uint32_t bootloaderDataAddress = (uint32_t) &__FLASH_BL_DATA_START; // Get base address of bootloader data
+uint32_t accumulateChecksum(uint32_t checksum, void *data, uint32_t length){ // Continue a CRC32 checksum (as calculateChecksum, 0 to start) over more data
+    return crc_accumulate(checksum, data, length); // Backend selected at build time (CRC_BACKEND)
+}
 
-    HAL_FLASH_Unlock(); // Unlock flash control
-    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS); // Clear flash flags
+void fillBytes(void *data, uint8_t value, uint32_t length){ // Set length bytes of data to value (as memset, the bootloader links without the C library)
+    for (uint32_t i = 0; i < length; i++) {
+        ((uint8_t *) data)[i] = value;
+    }
+}
 
-    // Flash erase procedure
-    uint32_t flashPage = (bootloaderDataAddress - FLASH_BASE)/FLASH_PAGE_SIZE; // Calculate the flash page number
-    uint32_t pageError; // Page error code (for HAL)
-    // Flash erase parameters
-    FLASH_EraseInitTypeDef flashErase = {0};
-    flashErase.TypeErase = FLASH_TYPEERASE_PAGES;
-    flashErase.Page = flashPage;
-    flashErase.NbPages = 1;
-    if (HAL_FLASHEx_Erase(&flashErase, &pageError) != HAL_OK) { // Erase flash page
-        HAL_FLASH_Lock();
-        return BL_ERROR_HAL; // Return error if erase fails
+void copyBytes(void *destination, const void *source, uint32_t length){ // Copy length bytes from source to destination (as memcpy)
+    for (uint32_t i = 0; i < length; i++) {
+        ((uint8_t *) destination)[i] = ((const uint8_t *) source)[i];
     }
+}
 
-    // Flash write procedure
-    uint64_t datachunk; // Data double-word to write to flash
-    for (uint32_t dw = 0; dw < sizeof(BootloaderData_T); dw += 8) { // Iterate through bootloader data in double-words
-        if (sizeof(BootloaderData_T) - dw >= 8){
-            datachunk = *((uint64_t*)((uint32_t)&data + dw)); // Get data double word
-        } else {
-            datachunk = *((uint64_t*)((uint32_t)&data + dw)) | ((uint64_t)0xFFFFFFFFFFFFFFFF >> (sizeof(BootloaderData_T) - dw)*8); // Get data double word and mask unused bytes
+uint8_t isEqualBytes(const void *a, const void *b, uint32_t length){ // Check that length bytes at a and b are equal (as memcmp)
+    for (uint32_t i = 0; i < length; i++) {
+        if (((const uint8_t *) a)[i] != ((const uint8_t *) b)[i]) {return 0;}
+    }
+    return 1;
+}
+
+
+void scanBootloaderJournal(uint8_t page, BootloaderJournal_T *journal){ // Scan a bootloader data page for journal records, boot tick marks and free space
+    uint32_t journalAddress = BL_DATA_PAGE_ADDRESS(page); // Get base address of the bootloader data page
+    uint32_t journalLength = (uint32_t) &__FLASH_BL_DATA_LEN;
+    journal->page = page;
+    journal->records = 0;
+    journal->ticks = 0;
+    journal->fastBootApp = 0;
+    journal->stats = -1;
+    journal->resets = -1;
+    journal->trial = -1;
+    journal->end = journalLength; // Journal is full unless an erased entry is found
+
+    uint32_t offset = 0;
+    while (offset + 8 <= journalLength) { // Iterate through journal entries
+        uint64_t entry = *((uint64_t *)(journalAddress + offset));
+#ifdef HOST_SIM
+        simFlashRead(2); // The host reads the journal for free, the simulated core does not
+#endif
+        if (entry == BL_JOURNAL_ERASED) { // End of journal
+            journal->end = offset;
+            break;
+        }
+        if (entry == BL_JOURNAL_TICK) { // Boot tick mark (counts boots since the last record)
+            journal->ticks++;
+            journal->fastBootApp = 0;
+            offset += 8;
+            continue;
+        }
+        if (getFastBootMarkApp(entry)) { // Fast boot mark (only counts if nothing follows it)
+            journal->fastBootApp = getFastBootMarkApp(entry);
+            offset += 8;
+            continue;
+        }
+
+        BootloaderEntryHeader_T *entryHeader = (BootloaderEntryHeader_T *)(journalAddress + offset);
+        if ((entryHeader->tag == BL_STATS_TAG || entryHeader->tag == BL_RESETS_TAG || entryHeader->tag == BL_TRIAL_TAG) && entryHeader->length < journalLength && offset + BL_ENTRY_SIZE(entryHeader->length) <= journalLength) { // Boot statistics, reset counts or trial boot state (do not end the boot tick marks)
+            uint32_t *checksum = (uint32_t *)(journalAddress + offset + BL_ENTRY_SIZE(entryHeader->length) - 8);
+            if (checksum[0] == ~checksum[1]) { // Completely written (checksum double-word programmed)
+                if (entryHeader->tag == BL_STATS_TAG) {
+                    journal->stats = offset;
+                } else if (entryHeader->tag == BL_RESETS_TAG) {
+                    journal->resets = offset;
+                } else {
+                    journal->trial = offset;
+                }
+            }
+            journal->fastBootApp = 0;
+            offset += BL_ENTRY_SIZE(entryHeader->length);
+            continue;
         }
 
-        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, bootloaderDataAddress + dw, datachunk) != HAL_OK) { // Write double word to flash
-            HAL_FLASH_Lock();
-            return BL_ERROR_HAL; // Return error if write fails
+        uint32_t recordSize = getBootloaderRecordSize(page, offset);
+        if (recordSize == 0 || offset + recordSize > journalLength) { // Unknown entry (legacy data, an interrupted erase or an interrupted write), the page must be compacted before it can be appended to
+            journal->fastBootApp = 0;
+            break;
         }
+        if (journal->records < BL_JOURNAL_MAX_RECORDS) {
+            journal->record[journal->records++] = offset;
+        }
+        journal->ticks = 0;
+        journal->fastBootApp = 0;
+        offset += recordSize;
     }
+}
 
-    HAL_FLASH_Lock(); // Lock flash control
+uint32_t getBootloaderRecordSize(uint8_t page, uint32_t offset){ // Get the size in flash of the bootloader data record at offset in a bootloader data page (0 if there is no record)
+    BootloaderRecordHeader_T *header = (BootloaderRecordHeader_T *)(BL_DATA_PAGE_ADDRESS(page) + offset);
+    if (header->tag != BL_RECORD_TAG || header->length >= (uint32_t) &__FLASH_BL_DATA_LEN) {return 0;}
+    return BL_RECORD_SIZE_OF(sizeof(BootloaderRecordHeader_T) + header->length); // Any length, records written by later layouts are skipped correctly
+}
 
-    // Data verification procedure
-    uint32_t wdata;
-    uint32_t rdata;
-    for (uint32_t wd = 0; wd < sizeof(BootloaderData_T); wd += 4) { // Iterate through bootloader data in words
-        wdata = *((uint32_t*)((uint32_t)&data + wd)); // Get bootloader data word
-        rdata = *((uint32_t*)(bootloaderDataAddress + wd)); // Get word from flash
-        if (sizeof(BootloaderData_T) - wd < 4) { // Mask unused data bytes
-            wdata |= ((uint32_t)0xFFFFFFFF >> (sizeof(BootloaderData_T) - wd)*8);
-            rdata |= ((uint32_t)0xFFFFFFFF >> (sizeof(BootloaderData_T) - wd)*8);
+const BootloaderData_T *getBootloaderRecordData(uint8_t page, uint32_t offset, uint32_t *length, uint32_t *layout){ // Get a pointer to the bootloader data of the record at offset in a bootloader data page, with its length and layout version
+    BootloaderRecordHeader_T *header = (BootloaderRecordHeader_T *)(BL_DATA_PAGE_ADDRESS(page) + offset);
+    *length = header->length;
+    *layout = header->layout;
+    return (const BootloaderData_T *)(BL_DATA_PAGE_ADDRESS(page) + offset + sizeof(BootloaderRecordHeader_T));
+}
+
+uint8_t isBootloaderRecordCommitted(uint8_t page, uint32_t offset){ // Check that the bootloader data record at offset in a bootloader data page was completely written (checksum double-word programmed)
+    uint32_t *checksum = (uint32_t *)(BL_DATA_PAGE_ADDRESS(page) + offset + getBootloaderRecordSize(page, offset) - 8); // Checksum and inverted checksum (last double-word, programmed last)
+    return checksum[0] == ~checksum[1];
+}
+
+uint8_t isBootloaderRecordValid(uint8_t page, uint32_t offset){ // Check the checksum of the bootloader data record at offset in a bootloader data page
+    if (!isBootloaderRecordCommitted(page, offset)) {return 0;} // Record not completely written
+    uint32_t recordAddress = BL_DATA_PAGE_ADDRESS(page) + offset;
+    uint32_t length, layout;
+    uint32_t dataAddress = (uint32_t) getBootloaderRecordData(page, offset, &length, &layout);
+    return calculateChecksum((void *) recordAddress, dataAddress - recordAddress + length) == *((uint32_t *)(recordAddress + getBootloaderRecordSize(page, offset) - 8)); // Header and data
+}
+
+uint8_t isBootloaderDataErased(uint8_t page, uint32_t offset, uint32_t length){ // Check that length bytes at offset in a bootloader data page are erased (and lie within the page)
+    if (offset + length > (uint32_t) &__FLASH_BL_DATA_LEN) {return 0;}
+    for (uint32_t dw = offset; dw < offset + length; dw += 8) {
+        if (*((uint64_t *)(BL_DATA_PAGE_ADDRESS(page) + dw)) != BL_JOURNAL_ERASED) {return 0;}
+    }
+    return 1;
+}
+
+int32_t findBootloaderRecord(BootloaderJournal_T *journal, uint8_t validate){ // Find the newest valid (or, without validate, completely written) bootloader data record in either page, journal is set to the scan of its page (-1 if none, journal is set to the scan of page A)
+    BootloaderJournal_T scan[BL_DATA_PAGES];
+    int32_t next[BL_DATA_PAGES]; // Next record to check in each page (newest first)
+    for (uint8_t page = 0; page < BL_DATA_PAGES; page++) {
+        scanBootloaderJournal(page, &scan[page]);
+        next[page] = scan[page].records - 1;
+    }
+    *journal = scan[0];
+
+    while (1) { // Check records in order of decreasing sequence number until a valid record is found
+        int32_t page = -1;
+        uint32_t sequence = 0;
+        for (uint8_t p = 0; p < BL_DATA_PAGES; p++) {
+            if (next[p] < 0) {continue;}
+            uint32_t recordSequence = ((BootloaderRecordHeader_T *)(BL_DATA_PAGE_ADDRESS(p) + scan[p].record[next[p]]))->sequence;
+            if (page < 0 || (int32_t)(recordSequence - sequence) > 0) { // Sequence numbers compared with wrap-around
+                page = p;
+                sequence = recordSequence;
+            }
+        }
+        if (page < 0) {return -1;} // No (valid) records
+
+        if (validate ? isBootloaderRecordValid(page, scan[page].record[next[page]]) : isBootloaderRecordCommitted(page, scan[page].record[next[page]])) {
+            *journal = scan[page];
+            return scan[page].record[next[page]];
+        }
+        next[page]--;
+    }
+}
+
+const BootloaderData_T *readBootloaderData(){ // Get a pointer to the current bootloader data in flash (newest valid record in the journal, valid until bootloader data is next written)
+    if (currentBootloaderData != NULL) {return currentBootloaderData;} // Found and checked since bootloader data was last written
+
+    BootloaderJournal_T journal;
+    int32_t record = findBootloaderRecord(&journal, 1);
+    uint32_t length = sizeof(BootloaderData_T);
+    uint32_t layout = 0;
+    if (record >= 0) { // Newest valid record (a record written in an older, shorter layout is migrated by the next boot, fields it lacks are not valid in place until then)
+        currentBootloaderData = getBootloaderRecordData(journal.page, record, &length, &layout);
+    } else if (journal.records == 0) { // No journal, bootloader data is erased or was written without a journal (previous bootloader versions)
+        currentBootloaderData = (const BootloaderData_T *) &__FLASH_BL_DATA_START;
+        length = BL_DATA_LEGACY_LENGTH;
+    } else { // No valid records, treat bootloader data as erased
+        currentBootloaderData = (const BootloaderData_T *) erasedBootloaderData;
+    }
+    currentBootloaderDataLength = (length < sizeof(BootloaderData_T)) ? length : sizeof(BootloaderData_T);
+    currentBootloaderDataLayout = layout;
+    return currentBootloaderData;
+}
+
+BootloaderData_T getBootloaderData(){ // Get a copy of the current bootloader data (to change and write back), fields an older layout lacks read as erased
+    const BootloaderData_T *current = readBootloaderData();
+    if (currentBootloaderDataLength == sizeof(BootloaderData_T)) {return *current;} // Copy bootloader data to RAM (word copies, the layout is aligned)
+    BootloaderData_T data;
+    fillBytes(&data, 0xFF, sizeof(BootloaderData_T));
+    copyBytes(&data, current, currentBootloaderDataLength);
+    return data;
+}
+
+uint32_t getBootloaderDataLayout(){ // Get the layout version the current bootloader data was written in (0 if there is none)
+    readBootloaderData();
+    return currentBootloaderDataLayout;
+}
+
+BootloaderStatus_T appendBootloaderData(BootloaderData_T *data){ // Append a bootloader data record to the journal (flash unlocked)
+    currentBootloaderData = NULL; // Found again once written (the journal page may be erased for compaction)
+    BootloaderJournal_T journal;
+    int32_t newest = findBootloaderRecord(&journal, 1);
+
+    BootloaderRecord_T record;
+    record.header.tag = BL_RECORD_TAG;
+    record.header.sequence = (newest >= 0) ? ((BootloaderRecordHeader_T *)(BL_DATA_PAGE_ADDRESS(journal.page) + newest))->sequence + 1 : 0;
+    record.header.layout = BL_DATA_LAYOUT;
+    record.header.length = sizeof(BootloaderData_T);
+    record.data = *data;
+
+    uint8_t page = journal.page;
+    uint32_t offset = journal.end;
+    uint8_t compacted = 0;
+    ResetCounts_T resetCounts;
+    uint8_t carryResets = 0; // Reset counts to write again after the compacted record (read before the erase, they may only be in the page erased)
+    TrialInfo_T trial;
+    uint8_t carryTrial = 0; // Trial boot state likewise
+    if (!isBootloaderDataErased(page, offset, BL_RECORD_SIZE)) { // Page full (or its free space was not completely erased), compact into the other page (the current record stays valid until the new record is committed)
+        page = (page + 1) % BL_DATA_PAGES;
+        carryResets = resetCause_readCounts(&resetCounts);
+        carryTrial = trialBoot_read(&trial);
+        uint32_t pageError; // Page error code (for HAL)
+        // Flash erase parameters
+        FLASH_EraseInitTypeDef flashErase = {0};
+        flashErase.TypeErase = FLASH_TYPEERASE_PAGES;
+        flashErase.Page = (BL_DATA_PAGE_ADDRESS(page) - FLASH_BASE)/FLASH_PAGE_SIZE; // Calculate the flash page number
+        flashErase.NbPages = 1;
+        if (flashRam_erase(&flashErase, &pageError) != HAL_OK) { // Erase flash page
+            return BL_ERROR_HAL; // Return error if erase fails
         }
-        if (rdata != wdata) {
-            return BL_ERROR_WRITE_VERIFICATION;
+        offset = 0;
+        compacted = 1;
+    }
+
+    // Flash write procedure (header and data, then checksum to commit the record)
+    BootloaderStatus_T status;
+    uint64_t datachunk; // Data double-word to write to flash
+    for (uint32_t dw = 0; dw < sizeof(BootloaderRecord_T); dw += 8) { // Iterate through record in double-words
+        if (sizeof(BootloaderRecord_T) - dw >= 8){
+            datachunk = *((uint64_t*)((uint32_t)&record + dw)); // Get data double word
+        } else {
+            datachunk = *((uint64_t*)((uint32_t)&record + dw)) | ((uint64_t)0xFFFFFFFFFFFFFFFF << (sizeof(BootloaderRecord_T) - dw)*8); // Get data double word and mask unused bytes
         }
+        status = programBootloaderData(page, offset + dw, datachunk);
+        if (status != BL_OK) {return status;}
     }
+    uint32_t checksum = calculateChecksum(&record, sizeof(BootloaderRecord_T));
+    status = programBootloaderData(page, offset + BL_RECORD_SIZE - 8, ((uint64_t) ~checksum << 32) | checksum);
+    if (status != BL_OK) {return status;}
 
+    if (!isBootloaderRecordValid(page, offset)) { // Verify written record
+        return BL_ERROR_WRITE_VERIFICATION;
+    }
+    offset += BL_RECORD_SIZE;
+    if (compacted && bootStats_isValid()) { // Persist the boot statistics again in the compacted page (the copy in the other page is erased by the next compaction)
+        bootStats_write(page, offset); // Best effort, the record is committed
+        offset += BL_ENTRY_SIZE(sizeof(BootStats_T));
+    }
+    if (carryResets) { // Reset counts and fault policy likewise
+        writeBootloaderEntry(page, offset, BL_RESETS_TAG, &resetCounts, sizeof(ResetCounts_T));
+        offset += BL_ENTRY_SIZE(sizeof(ResetCounts_T));
+    }
+    if (carryTrial) { // Trial boot state likewise
+        writeBootloaderEntry(page, offset, BL_TRIAL_TAG, &trial, sizeof(TrialInfo_T));
+    }
+    return BL_OK;
+}
+
+BootloaderStatus_T compactBootloaderJournal(){ // Compact the bootloader data journal into the other page with bootloader data unchanged, carrying the boot tick marks over so the re-verification interval is kept (flash unlocked)
+    BootloaderJournal_T journal;
+    findBootloaderRecord(&journal, 0);
+    uint32_t ticks = journal.ticks % VERIFICATION_RECHECK_INTERVAL;
+
+    BootloaderData_T bootloaderData = getBootloaderData();
+    BootloaderStatus_T status = appendBootloaderData(&bootloaderData);
+    if (status != BL_OK) {return status;}
+
+    findBootloaderRecord(&journal, 0); // Tick marks follow the compacted record and the entries carried with it
+    for (; ticks > 0 && journal.end + 8 <= (uint32_t) &__FLASH_BL_DATA_LEN; ticks--) {
+        status = programBootloaderData(journal.page, journal.end, BL_JOURNAL_TICK);
+        if (status != BL_OK) {return status;}
+        journal.end += 8;
+    }
+    return BL_OK;
+}
+
+BootloaderStatus_T writeBootloaderData(BootloaderData_T data){ // Write bootloader data to flash
+    HAL_FLASH_Unlock(); // Unlock flash control
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS); // Clear flash flags
+
+    BootloaderStatus_T status = appendBootloaderData(&data);
+
+    HAL_FLASH_Lock(); // Lock flash control
+    return status;
+}
+
+BootloaderStatus_T programBootloaderData(uint8_t page, uint32_t offset, uint64_t value){ // Program a double-word in a bootloader data page without erasing it (flash unlocked, target erased or value zero)
+    if (offset % 8) {return BL_ERROR_DATA_ALIGNMENT;} // Check for correct data alignment (double-word aligned)
+    if (page >= BL_DATA_PAGES || offset + 8 > (uint32_t) &__FLASH_BL_DATA_LEN) {return BL_ERROR_OUT_OF_RANGE;} // Check that write lies within bootloader data
+
+    uint32_t address = BL_DATA_PAGE_ADDRESS(page) + offset;
+    if (flashRam_program(FLASH_TYPEPROGRAM_DOUBLEWORD, address, value) != HAL_OK) { // Write double word to flash
+        return BL_ERROR_HAL;
+    }
+    if (*((uint64_t*) address) != value) { // Verify written data
+        return BL_ERROR_WRITE_VERIFICATION;
+    }
     return BL_OK;
 }
 
 
+int32_t findBootloaderEntry(uint32_t tag, uint8_t *page){ // Find the newest completely written tagged entry (BL_STATS_TAG, BL_RESETS_TAG or BL_TRIAL_TAG) in the journal (offset in page, -1 if none)
+    BootloaderJournal_T journal;
+    findBootloaderRecord(&journal, 0); // Page of the newest record (entries are written again after the record when the journal is compacted)
+    for (uint8_t i = 0; i < BL_DATA_PAGES; i++) {
+        int32_t offset = (tag == BL_STATS_TAG) ? journal.stats : (tag == BL_RESETS_TAG) ? journal.resets : journal.trial;
+        if (offset >= 0) {
+            *page = journal.page;
+            return offset;
+        }
+        scanBootloaderJournal((journal.page + 1) % BL_DATA_PAGES, &journal); // None yet in that page, the other page may hold one written before it was compacted into
+    }
+    return -1;
+}
+
+BootloaderStatus_T writeBootloaderEntry(uint8_t page, uint32_t offset, uint32_t tag, const void *payload, uint32_t length){ // Write a tagged entry at offset in a bootloader data page (flash unlocked, target erased)
+    BootloaderEntryHeader_T header = {tag, length};
+
+    // Flash write procedure (header, then payload, then checksum to commit the entry)
+    BootloaderStatus_T status = programBootloaderData(page, offset, *((uint64_t *) &header));
+    if (status != BL_OK) {return status;}
+    uint64_t datachunk; // Data double-word to write to flash
+    for (uint32_t dw = 0; dw < length; dw += 8) { // Iterate through payload in double-words
+        datachunk = 0xFFFFFFFFFFFFFFFF; // Bytes past the end of the payload are left erased
+        copyBytes(&datachunk, (const uint8_t *) payload + dw, (length - dw < 8) ? length - dw : 8);
+        status = programBootloaderData(page, offset + 8 + dw, datachunk);
+        if (status != BL_OK) {return status;}
+    }
+    uint32_t checksum = accumulateChecksum(calculateChecksum(&header, sizeof(header)), (void *) payload, length);
+    return programBootloaderData(page, offset + BL_ENTRY_SIZE(length) - 8, ((uint64_t) ~checksum << 32) | checksum);
+}
+
+BootloaderStatus_T appendBootloaderEntry(uint32_t tag, const void *payload, uint32_t length){ // Append a tagged entry to the bootloader data journal, compacting it if the page is full (flash unlocked)
+    BootloaderJournal_T journal;
+    findBootloaderRecord(&journal, 0); // Appended after the newest record and the entries that follow it
+    if (!isBootloaderDataErased(journal.page, journal.end, BL_ENTRY_SIZE(length))) { // Page full, compact the journal (then append after the compacted record and the entries carried with it)
+        BootloaderStatus_T status = compactBootloaderJournal();
+        if (status != BL_OK) {return status;}
+        findBootloaderRecord(&journal, 0);
+        if (!isBootloaderDataErased(journal.page, journal.end, BL_ENTRY_SIZE(length))) {return BL_ERROR;}
+    }
+    return writeBootloaderEntry(journal.page, journal.end, tag, payload, length);
+}
+
+
+uint8_t isVerificationCached(uint32_t generation, VerificationRecord_T record, uint32_t appChecksum){ // Check whether a verification record is valid for an application generation and checksum
+    if ((record.generation == VERIFICATION_RECORD_ERASED) || (record.generation == 0 && record.appChecksum == 0)) {return 0;} // Not verified or invalidated
+    return (record.generation == generation) && (record.appChecksum == appChecksum);
+}
+
+BootloaderStatus_T setVerification(uint8_t app, VerificationRecord_T record){ // Set the verification record of an application (flash unlocked)
+    BootloaderData_T bootloaderData = getBootloaderData();
+    bootloaderData.verified[app - 1] = record;
+    return appendBootloaderData(&bootloaderData);
+}
+
+BootloaderStatus_T invalidateVerification(uint8_t app){ // Invalidate the verification record of an application (flash unlocked)
+    verificationEpoch[app - 1]++; // A background verification pass that spans this is not recorded (even if the record is already invalidated, the application is changing)
+    if (metadataTransaction.open) { // Written to flash straight away, so the application space is never trusted with a stale record, and kept by the transaction so its commit does not restore it
+        metadataTransaction.data.verified[app - 1].generation = 0;
+        metadataTransaction.data.verified[app - 1].appChecksum = 0;
+    }
+    const VerificationRecord_T *current = &readBootloaderData()->verified[app - 1];
+    if (current->generation == 0 && current->appChecksum == 0) {return BL_OK;} // Already invalidated
+
+    BootloaderData_T bootloaderData = getBootloaderData();
+    bootloaderData.verified[app - 1].generation = 0;
+    bootloaderData.verified[app - 1].appChecksum = 0;
+    return appendBootloaderData(&bootloaderData);
+}
+
+BootloaderStatus_T recordVerification(uint8_t app, VerificationRecord_T record, uint8_t valid){ // Record the result of checking an entire application against its info (flash unlocked, nothing is written if the record already says so)
+    if (!valid) {return invalidateVerification(app);}
+    const VerificationRecord_T *current = &readBootloaderData()->verified[app - 1];
+    if (current->generation == record.generation && current->appChecksum == record.appChecksum) {return BL_OK;} // Already recorded
+    return setVerification(app, record);
+}
+
+uint32_t getVerificationTicks(){ // Get the number of verifying boots since bootloader data was last written
+    BootloaderJournal_T journal;
+    findBootloaderRecord(&journal, 0); // Tick marks follow the newest record (its checksum is not needed to count them)
+    return journal.ticks;
+}
+
+BootloaderStatus_T addVerificationTick(){ // Record a verifying boot (flash unlocked)
+    BootloaderJournal_T journal;
+    findBootloaderRecord(&journal, 0); // Tick marks follow the newest record (its checksum is not needed to place them)
+    if (journal.end + 8 > (uint32_t) &__FLASH_BL_DATA_LEN) { // Page full, compact the journal first (the tick marks are carried over)
+        BootloaderStatus_T status = compactBootloaderJournal();
+        if (status != BL_OK) {return status;}
+        findBootloaderRecord(&journal, 0);
+    }
+    return programBootloaderData(journal.page, journal.end, BL_JOURNAL_TICK);
+}
+
+
+uint8_t getFastBootMarkApp(uint64_t entry){ // Get the application space of a fast boot mark journal entry (0 if the entry is not a fast boot mark)
+    uint8_t app = (uint8_t) entry;
+    return (IS_APP_SLOT(app) && entry == BL_JOURNAL_FASTBOOT(app)) ? app : 0;
+}
+
+BootloaderStatus_T setFastBootMark(uint8_t app){ // Record that the fast boot path may start an application, until anything else is appended to the journal (flash unlocked)
+    BootloaderJournal_T journal;
+    findBootloaderRecord(&journal, 0);
+    if (journal.fastBootApp == app) {return BL_OK;} // Already marked
+    if (journal.end + 8 > (uint32_t) &__FLASH_BL_DATA_LEN) { // Page full, compact the journal first
+        BootloaderStatus_T status = compactBootloaderJournal();
+        if (status != BL_OK) {return status;}
+        findBootloaderRecord(&journal, 0);
+    }
+    return programBootloaderData(journal.page, journal.end, BL_JOURNAL_FASTBOOT(app));
+}
+
+BootloaderStatus_T cancelFastBootMark(){ // Stop the fast boot path starting an application until the next full boot (flash unlocked) (the mark is zeroed, so it reads as a boot tick mark)
+    BootloaderJournal_T journal;
+    findBootloaderRecord(&journal, 0);
+    if (!journal.fastBootApp) {return BL_OK;}
+    return programBootloaderData(journal.page, journal.end - 8, BL_JOURNAL_TICK);
+}
+
+
+#ifndef HOST_SIM // The host simulator provides its own startApplication
 __attribute__((naked)) void startApplication(uint32_t stackPointer, uint32_t startupAddress){ // Starts an application (sets the main stack pointer to stackPointer and jumps to startupAddress)
     __ASM("msr msp, r0"); // Set stack pointer to application stack pointer
     __ASM("bx r1"); // Branch to application startup code
 }
+#endif
 
 
 BootloaderStatus_T configureWatchdog(WatchdogMode_T mode){ // Configure the watchdog
@@ -144,51 +582,57 @@ BootloaderStatus_T resetWatchdog(){ // Reset the watchdog
 
 
 uint32_t getBootloaderVersion(){ // Get the bootloader version number
-    BootloaderData_T bootloaderData = getBootloaderData();
-    return bootloaderData.blVersion;
+    return transaction_readData()->blVersion;
 }
 
 BootPriority_T getBootPriority(){ // Get the current boot priority
-    BootloaderData_T bootloaderData = getBootloaderData();
-    return bootloaderData.bootPriority;
+    return transaction_readData()->bootPriority;
 }
 
 BootloaderStatus_T setBootPriority(BootPriority_T priority){ // Set the boot priority
-    BootloaderData_T bootloaderData = getBootloaderData();
+    BootloaderData_T bootloaderData = transaction_getData();
     bootloaderData.bootPriority = priority;
-    return writeBootloaderData(bootloaderData);
+    return transaction_writeData(bootloaderData);
 }
 
 VerificationMode_T getVerificationMode(){ // Get the current application verification mode
-    BootloaderData_T bootloaderData = getBootloaderData();
-    return bootloaderData.verificationMode;
+    return transaction_readData()->verificationMode;
 }
 
 BootloaderStatus_T setVerificationMode(VerificationMode_T mode){ // Set the application verification mode
-    BootloaderData_T bootloaderData = getBootloaderData();
+    BootloaderData_T bootloaderData = transaction_getData();
     bootloaderData.verificationMode = mode;
-    return writeBootloaderData(bootloaderData);
+    return transaction_writeData(bootloaderData);
 }
 
 WatchdogMode_T getWatchdogMode(){ // Get the current watchdog mode
-    BootloaderData_T bootloaderData = getBootloaderData();
-    return bootloaderData.watchdogMode;
+    return transaction_readData()->watchdogMode;
 }
 
 BootloaderStatus_T setWatchdogMode(WatchdogMode_T mode){ // Set the watchdog mode
-    BootloaderData_T bootloaderData = getBootloaderData();
+    BootloaderData_T bootloaderData = transaction_getData();
     bootloaderData.watchdogMode = mode;
     BootloaderStatus_T status;
-    status = writeBootloaderData(bootloaderData);
-    if (status != BL_OK) {return status;}
+    status = transaction_writeData(bootloaderData);
+    if (status != BL_OK || metadataTransaction.open) {return status;} // Configured when the transaction is committed
     return configureWatchdog(mode);
 }
 
+FastBootMode_T getFastBootMode(){ // Get the current fast boot mode
+    return (transaction_readData()->fastBootMode == FASTBOOT_ON) ? FASTBOOT_ON : FASTBOOT_OFF; // Anything else (such as the erased padding of previous bootloader versions) is off
+}
+
+BootloaderStatus_T setFastBootMode(FastBootMode_T mode){ // Set the fast boot mode
+    if (mode != FASTBOOT_OFF && mode != FASTBOOT_ON) {return BL_ERROR_OUT_OF_RANGE;}
+    BootloaderData_T bootloaderData = transaction_getData();
+    bootloaderData.fastBootMode = mode;
+    return transaction_writeData(bootloaderData);
+}
+
 
 
 BootloaderStatus_T enableProgrammingMode(){ // Enable programming mode (to write new application)
-    BootloaderData_T bootloaderData = getBootloaderData(); // Get bootloader data
-    if (bootloaderData.watchdogMode != WATCHDOG_OFF) { // If watchdog is enabled, set long interval and reset before programming
+    if (readBootloaderData()->watchdogMode != WATCHDOG_OFF) { // If watchdog is enabled, set long interval and reset before programming
         configureWatchdog(WATCHDOG_LONG);
         resetWatchdog();
     }
@@ -196,272 +640,418 @@ BootloaderStatus_T enableProgrammingMode(){ // Enable programming mode (to write
     HAL_FLASH_Unlock(); // Unlock flash for programming
     __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS); // Clear flash errors
 
-    return BL_OK;
+    return cancelFastBootMark(); // Application spaces may change without bootloader data being written, so the next boot must be a full boot
 }
 
 BootloaderStatus_T disableProgrammingMode(){ // Disable programming mode (after writing application)
     HAL_FLASH_Lock(); // Lock flash
-    BootloaderData_T bootloaderData = getBootloaderData();
-    configureWatchdog(bootloaderData.watchdogMode); // Reconfigure watchdog
+    configureWatchdog(readBootloaderData()->watchdogMode); // Reconfigure watchdog
 
     return BL_OK;
 }
 
 
 
-uint8_t app1_getFaultCount(){ // Get the fault count of application 1
-    BootloaderData_T bootloaderData = getBootloaderData();
-    return bootloaderData.app1_faultCount;
+uint8_t app_getFaultCount(uint8_t app){ // Get the fault count of an application
+    if (!IS_APP_SLOT(app)) {return 0;}
+    return transaction_readData()->app[app - 1].faultCount;
 }
 
-BootloaderStatus_T app1_resetFaultCount(){ // Reset the fault count of application 1
-    BootloaderData_T bootloaderData = getBootloaderData();
-    if (bootloaderData.app1_faultCount != 0) {
-        bootloaderData.app1_faultCount = 0;
-        return writeBootloaderData(bootloaderData);
+BootloaderStatus_T app_resetFaultCount(uint8_t app){ // Reset the fault count of an application
+    if (!IS_APP_SLOT(app)) {return BL_ERROR_OUT_OF_RANGE;}
+    if (transaction_readData()->app[app - 1].faultCount != 0) {
+        BootloaderData_T bootloaderData = transaction_getData();
+        bootloaderData.app[app - 1].faultCount = 0;
+        return transaction_writeData(bootloaderData);
     }
     return BL_OK;
 }
 
-AppInfo_T app1_getInfo(){ // Get the app info of application 1
-    BootloaderData_T bootloaderData = getBootloaderData();
-    return bootloaderData.app1_info;
+AppInfo_T app_getInfo(uint8_t app){ // Get the app info of an application (erased, all 0xFF, if there is no such application space)
+    if (!IS_APP_SLOT(app)) {
+        AppInfo_T info;
+        fillBytes(&info, 0xFF, sizeof(info));
+        return info;
+    }
+    return transaction_readData()->app[app - 1].info;
+}
+
+BootloaderStatus_T getBootloaderView(BootloaderView_T *view){ // Point a read-only view at the current bootloader data in flash (valid until bootloader data is next written)
+    if (view == NULL) {return BL_ERROR;}
+    const BootloaderData_T *bootloaderData = transaction_readData();
+    view->version = &bootloaderData->blVersion;
+    view->bootPriority = &bootloaderData->bootPriority;
+    view->verificationMode = &bootloaderData->verificationMode;
+    view->watchdogMode = &bootloaderData->watchdogMode;
+    view->fastBootMode = &bootloaderData->fastBootMode;
+    for (uint8_t app = 1; app <= BL_APP_SLOTS; app++) {
+        view->appInfo[app - 1] = &bootloaderData->app[app - 1].info;
+        view->faultCount[app - 1] = &bootloaderData->app[app - 1].faultCount;
+    }
+    return BL_OK;
 }
 
-BootloaderStatus_T app1_erase(){ // Erase application space 1
-    uint32_t pageError; // Page error code (for HAL)
-    // Flash erase parameters
-    FLASH_EraseInitTypeDef flashErase = {0};
-    flashErase.TypeErase = FLASH_TYPEERASE_PAGES;
-    flashErase.Page = ((uint32_t) &__FLASH_APP1_START - FLASH_BASE)/FLASH_PAGE_SIZE;
-    flashErase.NbPages = ((uint32_t) &__FLASH_APP1_LEN)/FLASH_PAGE_SIZE;
-    if (HAL_FLASHEx_Erase(&flashErase, &pageError) != HAL_OK) { // Erase flash pages
-        return BL_ERROR_HAL; // Return HAL error if erase fails
+BootloaderStatus_T app_erase(uint8_t app){ // Erase an application space
+    if (!IS_APP_SLOT(app)) {return BL_ERROR_OUT_OF_RANGE;}
+    return app_eraseRange(app, 0, APP_SLOT_LENGTH(app));
+}
+
+BootloaderStatus_T app_eraseRange(uint8_t app, uint32_t address, uint32_t length){ // Erase the pages of an application space that hold length bytes from address (erase 0 to the size of a new application to install it)
+    if (!IS_APP_SLOT(app)) {return BL_ERROR_OUT_OF_RANGE;}
+    if (address > APP_SLOT_LENGTH(app) || length > APP_SLOT_LENGTH(app) - address) {return BL_ERROR_OUT_OF_RANGE;} // Check that range lies within application space
+    erasedPageCount = 0;
+    if (length == 0) {return BL_OK;}
+
+    BootloaderStatus_T status = invalidateVerification(app); // Application is no longer verified
+    if (status != BL_OK) {return status;}
+
+    uint32_t firstPage = address/FLASH_PAGE_SIZE; // Pages of the application space holding the range
+    uint32_t endPage = (address + length + FLASH_PAGE_SIZE - 1)/FLASH_PAGE_SIZE;
+    status = eraseAppPages(app, firstPage, endPage - firstPage);
+    if (status != BL_OK) {return status;}
+
+    if (firstPage == 0) {
+        resetWriteChecksum(app); // Start the running checksum of the data written
+    } else if (firstPage*FLASH_PAGE_SIZE < writeChecksum[app - 1].length) {
+        writeChecksum[app - 1].tracking = 0; // Data in the running checksum erased
     }
     return BL_OK;
 }
 
-BootloaderStatus_T app1_write(uint32_t address, uint64_t *data, uint32_t length){ // Write data to application space 1 (in 64-bit/double-word pages)
+BootloaderStatus_T eraseAppPages(uint8_t app, uint32_t page, uint32_t pages){ // Erase the pages of an application space (numbered from the start of the application space) that are not already blank (flash unlocked)
+    uint8_t timed = bootStats_startTimer(); // Time the erase (if TIM2 is free)
+    uint32_t firstPage = (APP_SLOT_START(app) - FLASH_BASE)/FLASH_PAGE_SIZE + page;
+    uint32_t end = firstPage + pages;
+    uint32_t erased = 0; // Pages erased by this call
+    BootloaderStatus_T status = BL_OK;
+    for (uint32_t i = firstPage; i < end;) {
+        if (isFlashPageBlank(i)) { // Skip pages that are already erased
+            i++;
+            continue;
+        }
+        uint32_t run = 1; // Erase consecutive pages that are not blank together
+        while (i + run < end && !isFlashPageBlank(i + run)) {run++;}
+
+        uint32_t pageError; // Page error code (for HAL)
+        // Flash erase parameters
+        FLASH_EraseInitTypeDef flashErase = {0};
+        flashErase.TypeErase = FLASH_TYPEERASE_PAGES;
+        flashErase.Page = i;
+        flashErase.NbPages = run;
+        if (flashRam_erase(&flashErase, &pageError) != HAL_OK) { // Erase flash pages
+            status = BL_ERROR_HAL; // Return HAL error if erase fails
+            break;
+        }
+        erased += run;
+        i += run;
+    }
+    erasedPageCount += erased;
+    bootStats_countErase(erased, bootStats_stopTimer(timed), status);
+    return status;
+}
+
+uint8_t isFlashPageBlank(uint32_t page){ // Check that a flash page is erased (all 0xFF)
+    uint32_t *data = (uint32_t *)(FLASH_BASE + page*FLASH_PAGE_SIZE);
+    for (uint32_t i = 0; i < FLASH_PAGE_SIZE/4; i++) {
+        if (data[i] != 0xFFFFFFFF) {return 0;}
+    }
+    return 1;
+}
+
+uint32_t getErasedPageCount(){ // Get the number of pages erased by the last application erase or lazily erasing streaming writer (pages that were already blank are not erased)
+    return erasedPageCount;
+}
+
+BootloaderStatus_T app_write(uint8_t app, uint32_t address, uint64_t *data, uint32_t length){ // Write data to an application space (in 64-bit/double-word pages)
+    if (!IS_APP_SLOT(app)) {return BL_ERROR_OUT_OF_RANGE;}
     if (address % 8) {return BL_ERROR_DATA_ALIGNMENT;} // Check for correct data alignment (double-word aligned)
-    if ((address + 8*length) > (uint32_t) &__FLASH_APP1_LEN) {return BL_ERROR_OUT_OF_RANGE;} // Check that write lies within application space
+    if ((address + 8*length) > APP_SLOT_LENGTH(app)) {return BL_ERROR_OUT_OF_RANGE;} // Check that write lies within application space
+
+    BootloaderStatus_T status = invalidateVerification(app); // Application is no longer verified
+    if (status != BL_OK) {return status;}
 
-    for (uint32_t i = 0; i < length; i++) { // Iterate through data
+    uint8_t timed = bootStats_startTimer(); // Time the write (if TIM2 is free)
+    uint32_t start = APP_SLOT_START(app) + address;
+    uint32_t i;
+    for (i = 0; i < length; i++) { // Iterate through data
         uint64_t ddw = data[i];
-        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, ((uint32_t) &__FLASH_APP1_START + address + 8*i), ddw) != HAL_OK) { // Write data double-word to flash
-            return BL_ERROR_HAL; // Return HAL error if write fails
+        if (flashRam_program(FLASH_TYPEPROGRAM_DOUBLEWORD, (start + 8*i), ddw) != HAL_OK) { // Write data double-word to flash
+            status = BL_ERROR_HAL; // Return HAL error if write fails
+            break;
         }
     }
 
     // Verify written data
     uint64_t flashData;
     uint64_t correctData;
-    for (uint32_t i = 0; i < length; i++) {
-        flashData = *((uint64_t*)((uint32_t) &__FLASH_APP1_START + address + 8*i));
-        correctData = data[i];
+    for (uint32_t j = 0; j < length && status == BL_OK; j++) {
+        flashData = *((uint64_t*)(start + 8*j));
+        correctData = data[j];
         if (flashData != correctData){
-            return BL_ERROR_WRITE_VERIFICATION;
+            status = BL_ERROR_WRITE_VERIFICATION;
         }
     }
+    bootStats_countProgram(8*i, bootStats_stopTimer(timed), status);
+    if (status != BL_OK) {return status;}
+    updateWriteChecksum(app, address, 8*length); // Add written data to the running checksum
     return BL_OK;
 }
 
-BootloaderStatus_T app1_writeInfo(AppInfo_T info){ // Write app 1 info to bootloader data
+BootloaderStatus_T app_writeInfo(uint8_t app, AppInfo_T info){ // Write the app info of an application to bootloader data
+    if (!IS_APP_SLOT(app)) {return BL_ERROR_OUT_OF_RANGE;}
+    uint32_t appInfoChecksum = calculateChecksum(&info, sizeof(info)); // Standard CRC32 (as verified at boot)
+
+    BootloaderData_T bootloaderData = transaction_getData(); // Fetch existing bootloader data (with the changes of an open transaction)
+    AppData_T *appData = &bootloaderData.app[app - 1];
+    VerificationRecord_T *verified = &bootloaderData.verified[app - 1];
+    appData->info = info; // Replace application info with new info
+    appData->faultCount = 0; // Reset application fault count
+    appData->infoChecksum = appInfoChecksum; // Set application info checksum
+    bootloaderData.generation[app - 1]++; // New application generation
+    verified->generation = VERIFICATION_RECORD_ERASED;
+    verified->appChecksum = VERIFICATION_RECORD_ERASED;
+
+    uint32_t writtenChecksum;
+    if (getWriteChecksumTo(app, info.size, &writtenChecksum) == BL_OK) { // Application written in this session (info.size within the last double-word written), checksum computed as it was programmed
+        if (writtenChecksum != info.appChecksum) {return BL_ERROR_CHECKSUM;} // Reject info that does not match the application written (corrupt transfer)
+        verified->generation = bootloaderData.generation[app - 1]; // Application verified as it was written
+        verified->appChecksum = writtenChecksum;
+    }
+
+    if (metadataTransaction.open) { // Written when the transaction is committed
+        transaction_stageInstall(&bootloaderData, app);
+        return BL_OK;
+    }
+    BootloaderStatus_T status = appendBootloaderData(&bootloaderData); // Append to bootloader data journal (flash unlocked in programming mode)
+    if (status != BL_OK) {return status;}
+    return trialBoot_begin(app, bootloaderData.bootPriority); // Give the update its trial boots (if trial boots are on), the current boot priority is restored if it is rolled back
+}
+
 
-    __HAL_RCC_CRC_CLK_ENABLE(); // Enable CRC module clock
-    // Configure CRC handle
-    CRC_HandleTypeDef crcHandle;
-    crcHandle.Instance = CRC;
-    crcHandle.Init.DefaultPolynomialUse = DEFAULT_POLYNOMIAL_ENABLE;
-    crcHandle.Init.DefaultInitValueUse = DEFAULT_INIT_VALUE_ENABLE;
-    crcHandle.Init.InputDataInversionMode = CRC_INPUTDATA_INVERSION_BYTE;
-    crcHandle.Init.OutputDataInversionMode = CRC_OUTPUTDATA_INVERSION_ENABLE;
-    crcHandle.InputDataFormat = CRC_INPUTDATA_FORMAT_BYTES;
-    HAL_CRC_Init(&crcHandle); // Initialise CRC module
 
-    uint32_t appInfoChecksum = HAL_CRC_Calculate(&crcHandle, (uint32_t *) &info, sizeof(info));
+uint8_t app1_getFaultCount(){return app_getFaultCount(1);} // Get the fault count of application 1
+BootloaderStatus_T app1_resetFaultCount(){return app_resetFaultCount(1);} // Reset the fault count of application 1
+AppInfo_T app1_getInfo(){return app_getInfo(1);} // Get the app info of application 1
+BootloaderStatus_T app1_erase(){return app_erase(1);} // Erase application space 1
+BootloaderStatus_T app1_write(uint32_t address, uint64_t *data, uint32_t length){return app_write(1, address, data, length);} // Write data to application space 1 (in 64-bit/double-word pages)
+BootloaderStatus_T app1_writeInfo(AppInfo_T info){return app_writeInfo(1, info);} // Write app 1 info to bootloader data
 
-    HAL_CRC_DeInit(&crcHandle); // De-initialise CRC module
-    __HAL_RCC_CRC_CLK_DISABLE(); // Disable CRC module clock
+uint8_t app2_getFaultCount(){return app_getFaultCount(2);} // Get the fault count of application 2
+BootloaderStatus_T app2_resetFaultCount(){return app_resetFaultCount(2);} // Reset the fault count of application 2
+AppInfo_T app2_getInfo(){return app_getInfo(2);} // Get the app info of application 2
+BootloaderStatus_T app2_erase(){return app_erase(2);} // Erase application space 2
+BootloaderStatus_T app2_write(uint32_t address, uint64_t *data, uint32_t length){return app_write(2, address, data, length);} // Write data to application space 2 (in 64-bit/double-word pages)
+BootloaderStatus_T app2_writeInfo(AppInfo_T info){return app_writeInfo(2, info);} // Write app 2 info to bootloader data
 
 
-    BootloaderData_T bootloaderData = getBootloaderData(); // Fetch existing bootloader data
-    bootloaderData.app1_info = info; // Replace application 1 info with new info
-    bootloaderData.app1_faultCount = 0; // Reset application 1 fault count
-    bootloaderData.app1_infoChecksum = appInfoChecksum; // Set application 1 info checksum
 
-    uint32_t bootloaderDataAddress = (uint32_t) &__FLASH_BL_DATA_START; // Get base address of bootloader data
+BootloaderStatus_T appWriter_open(AppWriter_T *writer, uint8_t app, uint32_t address){ // Open a streaming writer to an application space at address (flash unlocked, application space erased)
+    BootloaderStatus_T status = appWriter_init(writer, app, address);
+    if (status != BL_OK) {return status;}
+    writer->erasedAddress = writer->length; // Application space erased beforehand
+    writer->open = 1;
+    return BL_OK;
+}
 
-    // Flash erase procedure
-    uint32_t flashPage = (bootloaderDataAddress - FLASH_BASE)/FLASH_PAGE_SIZE; // Calculate the flash page number
-    uint32_t pageError; // Page error code (for HAL)
-    // Flash erase parameters
-    FLASH_EraseInitTypeDef flashErase = {0};
-    flashErase.TypeErase = FLASH_TYPEERASE_PAGES;
-    flashErase.Page = flashPage;
-    flashErase.NbPages = 1;
-    if (HAL_FLASHEx_Erase(&flashErase, &pageError) != HAL_OK) { // Erase flash page
-        HAL_FLASH_Lock();
-        return BL_ERROR_HAL; // Return error if erase fails
+BootloaderStatus_T appWriter_openErase(AppWriter_T *writer, uint8_t app, uint32_t address){ // Open a streaming writer to an application space at address that erases each page just before its first write (flash unlocked, from address onwards the application space need not be erased)
+    BootloaderStatus_T status = appWriter_init(writer, app, address);
+    if (status != BL_OK) {return status;}
+    writer->erasedAddress = (address + FLASH_PAGE_SIZE - 1) & ~(FLASH_PAGE_SIZE - 1); // Page holding address (if not its start) is already being written
+    erasedPageCount = 0;
+    if (address == 0) {
+        resetWriteChecksum(app); // Application space written from its start, pages erased as it is written
+    } else if (writer->erasedAddress < writeChecksum[app - 1].length) {
+        writeChecksum[app - 1].tracking = 0; // Data in the running checksum will be erased
     }
+    writer->open = 1;
+    return BL_OK;
+}
 
-    // Flash write procedure
-    uint64_t datachunk; // Data double-word to write to flash
-    for (uint32_t dw = 0; dw < sizeof(BootloaderData_T); dw += 8) { // Iterate through bootloader data in double-words
-        if (sizeof(BootloaderData_T) - dw >= 8){
-            datachunk = *((uint64_t*)((uint32_t)&bootloaderData + dw)); // Get data double word
-        } else {
-            datachunk = *((uint64_t*)((uint32_t)&bootloaderData + dw)) | ((uint64_t)0xFFFFFFFFFFFFFFFF >> (sizeof(BootloaderData_T) - dw)*8); // Get data double word and mask unused bytes
-        }
+BootloaderStatus_T appWriter_init(AppWriter_T *writer, uint8_t app, uint32_t address){ // Check the application space and address of a streaming writer and set it up (left closed)
+    writer->open = 0;
+    if (!IS_APP_SLOT(app)) {return BL_ERROR_OUT_OF_RANGE;} // Check application space
+    if (address % 8) {return BL_ERROR_DATA_ALIGNMENT;} // Check for correct address alignment (double-word aligned)
+    writer->base = APP_SLOT_START(app);
+    writer->length = APP_SLOT_LENGTH(app);
+    if (address > writer->length) {return BL_ERROR_OUT_OF_RANGE;} // Check that write starts within application space
 
-        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, bootloaderDataAddress + dw, datachunk) != HAL_OK) { // Write double word to flash
-            HAL_FLASH_Lock();
-            return BL_ERROR_HAL; // Return error if write fails
-        }
+    BootloaderStatus_T status = invalidateVerification(app); // Application is no longer verified
+    if (status != BL_OK) {return status;}
+
+    for (uint32_t i = 0; i < BL_WRITER_ROW_SIZE/8; i++) { // Clear row buffer (erased)
+        writer->row[i] = 0xFFFFFFFFFFFFFFFF;
     }
+    writer->app = app;
+    writer->address = address;
+    writer->stagedAddress = address;
+    return BL_OK;
+}
 
-    // Data verification procedure
-    uint32_t wdata;
-    uint32_t rdata;
-    for (uint32_t wd = 0; wd < sizeof(BootloaderData_T); wd += 4) { // Iterate through bootloader data in words
-        wdata = *((uint32_t*)((uint32_t)&bootloaderData + wd)); // Get bootloader data word
-        rdata = *((uint32_t*)(bootloaderDataAddress + wd)); // Get word from flash
-        if (sizeof(BootloaderData_T) - wd < 4) { // Mask unused data bytes
-            wdata |= ((uint32_t)0xFFFFFFFF >> (sizeof(BootloaderData_T) - wd)*8);
-            rdata |= ((uint32_t)0xFFFFFFFF >> (sizeof(BootloaderData_T) - wd)*8);
+BootloaderStatus_T appWriter_push(AppWriter_T *writer, const void *data, uint32_t length){ // Write data of any length and alignment through a streaming writer (programmed a row at a time)
+    if (!writer->open) {return BL_ERROR;}
+    if (length > writer->length - writer->address) {return BL_ERROR_OUT_OF_RANGE;} // Check that write lies within application space
+
+    const uint8_t *bytes = (const uint8_t *) data;
+    while (length) {
+        // Stage as much data as fits in the current row
+        uint32_t offset = writer->address % BL_WRITER_ROW_SIZE;
+        uint32_t chunk = (length < BL_WRITER_ROW_SIZE - offset) ? length : BL_WRITER_ROW_SIZE - offset;
+        for (uint32_t i = 0; i < chunk; i++) {
+            ((uint8_t *) writer->row)[offset + i] = bytes[i];
         }
-        if (rdata != wdata) {
-            return BL_ERROR_WRITE_VERIFICATION;
+        writer->address += chunk;
+        bytes += chunk;
+        length -= chunk;
+
+        if (writer->address % BL_WRITER_ROW_SIZE == 0) { // Row complete
+            BootloaderStatus_T status = appWriter_flush(writer);
+            if (status != BL_OK) {return status;}
         }
     }
-
     return BL_OK;
 }
 
+BootloaderStatus_T appWriter_close(AppWriter_T *writer){ // Write any remaining data and close a streaming writer
+    if (!writer->open) {return BL_ERROR;}
+    BootloaderStatus_T status = appWriter_flush(writer);
+    writer->open = 0;
+    return status;
+}
 
-
-uint8_t app2_getFaultCount(){ // Get the fault count of application 2
-    BootloaderData_T bootloaderData = getBootloaderData();
-    return bootloaderData.app2_faultCount;
+RAMFUNC_FASTROW void fastRowSequence(uint32_t address, const uint32_t *row){ // Write a row to flash and wait for it to be programmed (fast programming set up, interrupts masked, runs from a copy in SRAM)
+    for (uint32_t i = 0; i < BL_WRITER_ROW_SIZE/4; i++) { // Row must be written without gaps or flash reads
+        FLASH_WRITE_WORD(address + 4*i, row[i]);
+    }
+    while (FLASH->SR & FLASH_SR_BSY1) {} // Flash is busy until the row is programmed
 }
 
-BootloaderStatus_T app2_resetFaultCount(){ // Reset the fault count of application 2
-    BootloaderData_T bootloaderData = getBootloaderData();
-    if (bootloaderData.app2_faultCount != 0) {
-        bootloaderData.app2_faultCount = 0;
-        return writeBootloaderData(bootloaderData);
+BootloaderStatus_T programFastRow(uint32_t address, uint64_t *row){ // Program an erased flash row in one fast programming operation (flash unlocked, row in SRAM)
+#ifdef HOST_SIM
+    if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_FAST, address, (uint32_t) row) != HAL_OK) {return BL_ERROR_HAL;}
+    return BL_OK;
+#else
+    // Fast programming fails if flash is read (code fetch or interrupt vector) while the row is written, so the
+    // sequence is copied out of flash onto the stack and run there with interrupts masked (HAL_FLASH_Program would
+    // run FLASH_Program_Fast from the .RamFunc section, which the bootloader does not place in SRAM)
+    uint32_t code[FASTROW_CODE_SIZE/4]; // Copy of the fast row programming sequence (word aligned)
+    uint32_t *source = (uint32_t *) &__BL_FASTROW_START;
+    uint32_t codeWords = ((uint32_t) &__BL_FASTROW_END - (uint32_t) &__BL_FASTROW_START)/4;
+    if (codeWords > FASTROW_CODE_SIZE/4) {return BL_ERROR;}
+    for (uint32_t i = 0; i < codeWords; i++) {
+        code[i] = source[i];
     }
+    void (*sequence)(uint32_t, const uint32_t *) = (void (*)(uint32_t, const uint32_t *)) ((uint32_t) code | 1); // Thumb code
+    __DSB();
+    __ISB();
+
+    if (FLASH_WaitForLastOperation(FLASH_TIMEOUT_VALUE) != HAL_OK) {return BL_ERROR_HAL;}
+    SET_BIT(FLASH->CR, FLASH_CR_FSTPG);
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    sequence(address, (const uint32_t *) row);
+    __set_PRIMASK(primask);
+    HAL_StatusTypeDef status = FLASH_WaitForLastOperation(FLASH_TIMEOUT_VALUE); // Check error flags
+    CLEAR_BIT(FLASH->CR, FLASH_CR_FSTPG);
+    if (status != HAL_OK) {return BL_ERROR_HAL;}
     return BL_OK;
+#endif
 }
 
-AppInfo_T app2_getInfo(){ // Get the app info of application 2
-    BootloaderData_T bootloaderData = getBootloaderData();
-    return bootloaderData.app2_info;
+uint8_t appWriter_read(AppWriter_T *writer, uint32_t offset){ // Read back a byte written through a streaming writer (offset in the application space, staged or in flash)
+    if (offset >= writer->stagedAddress) {
+        return ((uint8_t *) writer->row)[offset % BL_WRITER_ROW_SIZE]; // Staged, not yet programmed
+    }
+    return *((uint8_t *)(writer->base + offset));
 }
 
-BootloaderStatus_T app2_erase(){ // Erase application space 2
-    uint32_t pageError; // Page error code (for HAL)
-    // Flash erase parameters
-    FLASH_EraseInitTypeDef flashErase = {0};
-    flashErase.TypeErase = FLASH_TYPEERASE_PAGES;
-    flashErase.Page = ((uint32_t) &__FLASH_APP2_START - FLASH_BASE)/FLASH_PAGE_SIZE;
-    flashErase.NbPages = ((uint32_t) &__FLASH_APP2_LEN)/FLASH_PAGE_SIZE;
-    if (HAL_FLASHEx_Erase(&flashErase, &pageError) != HAL_OK) { // Erase flash pages
-        return BL_ERROR_HAL; // Return HAL error if erase fails
+BootloaderStatus_T appWriter_flush(AppWriter_T *writer){ // Program and verify the staged row of a streaming writer (fast programming if the row is erased)
+    if (writer->stagedAddress == writer->address) {return BL_OK;} // Nothing staged
+    uint32_t rowOffset = writer->stagedAddress - (writer->stagedAddress % BL_WRITER_ROW_SIZE);
+    uint32_t rowAddress = writer->base + rowOffset;
+    uint64_t *flashRow = (uint64_t *) rowAddress;
+
+    if (rowOffset >= writer->erasedAddress) { // Lazy erase, first write to this page
+        BootloaderStatus_T status = eraseAppPages(writer->app, rowOffset/FLASH_PAGE_SIZE, 1);
+        if (status != BL_OK) {return status;}
+        writer->erasedAddress = rowOffset - (rowOffset % FLASH_PAGE_SIZE) + FLASH_PAGE_SIZE;
     }
-    return BL_OK;
-}
 
-BootloaderStatus_T app2_write(uint32_t address, uint64_t *data, uint32_t length){ // Write data to application space 2 (in 64-bit/double-word pages)
-    if (address % 8) {return BL_ERROR_DATA_ALIGNMENT;} // Check for correct data alignment (double-word aligned)
-    if ((address + 8*length) > (uint32_t) &__FLASH_APP2_LEN) {return BL_ERROR_OUT_OF_RANGE;} // Check that write lies within application space
+    verificationEpoch[writer->app - 1]++; // Application space changed (invalidated once when the writer was set up)
+    uint8_t timed = bootStats_startTimer(); // Time the write (if TIM2 is free, erase timed separately)
+    BootloaderStatus_T status = BL_OK;
+    uint8_t erased = 1; // Fast programming writes the whole row, which must be erased
+    for (uint32_t i = 0; i < BL_WRITER_ROW_SIZE/8; i++) {
+        if (flashRow[i] != 0xFFFFFFFFFFFFFFFF) {
+            erased = 0;
+            break;
+        }
+    }
 
-    for (uint32_t i = 0; i < length; i++) { // Iterate through data
-        uint64_t ddw = data[i];
-        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, ((uint32_t) &__FLASH_APP2_START + address + 8*i), ddw) != HAL_OK) { // Write data double-word to flash
-            return BL_ERROR_HAL; // Return HAL error if write fails
+    if (erased) { // Program the row in one fast programming operation
+        if (flashRam_program(FLASH_TYPEPROGRAM_FAST, rowAddress, (uint32_t) writer->row) != HAL_OK) {
+            status = BL_ERROR_HAL;
+        }
+    } else { // Row partly written already (writer opened mid-row), program staged double-words individually
+        for (uint32_t i = 0; i < BL_WRITER_ROW_SIZE/8 && status == BL_OK; i++) {
+            if (writer->row[i] == 0xFFFFFFFFFFFFFFFF) {continue;} // Nothing to write
+            if (flashRam_program(FLASH_TYPEPROGRAM_DOUBLEWORD, rowAddress + 8*i, writer->row[i]) != HAL_OK) {
+                status = BL_ERROR_HAL;
+            }
         }
     }
 
-    // Verify written data
-    uint64_t flashData;
-    uint64_t correctData;
-    for (uint32_t i = 0; i < length; i++) {
-        flashData = *((uint64_t*)((uint32_t) &__FLASH_APP2_START + address + 8*i));
-        correctData = data[i];
-        if (flashData != correctData){
-            return BL_ERROR_WRITE_VERIFICATION;
+    // Verify written row and clear the row buffer
+    for (uint32_t i = 0; i < BL_WRITER_ROW_SIZE/8 && status == BL_OK; i++) {
+        if (writer->row[i] != 0xFFFFFFFFFFFFFFFF && flashRow[i] != writer->row[i]) {
+            status = BL_ERROR_WRITE_VERIFICATION;
+            break;
         }
+        writer->row[i] = 0xFFFFFFFFFFFFFFFF;
     }
+    bootStats_countProgram((status == BL_OK) ? writer->address - writer->stagedAddress : 0, bootStats_stopTimer(timed), status);
+    if (status != BL_OK) {return status;}
+    updateWriteChecksum(writer->app, writer->stagedAddress, writer->address - writer->stagedAddress); // Add written data to the running checksum
+    writer->stagedAddress = writer->address;
     return BL_OK;
 }
 
-BootloaderStatus_T app2_writeInfo(AppInfo_T info){ // Write app 2 info to bootloader data
-
-    __HAL_RCC_CRC_CLK_ENABLE(); // Enable CRC module clock
-    // Configure CRC handle
-    CRC_HandleTypeDef crcHandle;
-    crcHandle.Instance = CRC;
-    crcHandle.Init.DefaultPolynomialUse = DEFAULT_POLYNOMIAL_ENABLE;
-    crcHandle.Init.DefaultInitValueUse = DEFAULT_INIT_VALUE_ENABLE;
-    crcHandle.Init.InputDataInversionMode = CRC_INPUTDATA_INVERSION_BYTE;
-    crcHandle.Init.OutputDataInversionMode = CRC_OUTPUTDATA_INVERSION_ENABLE;
-    crcHandle.InputDataFormat = CRC_INPUTDATA_FORMAT_BYTES;
-    HAL_CRC_Init(&crcHandle); // Initialise CRC module
-
-    uint32_t appInfoChecksum = HAL_CRC_Calculate(&crcHandle, (uint32_t *) &info, sizeof(info));
 
-    HAL_CRC_DeInit(&crcHandle); // De-initialise CRC module
-    __HAL_RCC_CRC_CLK_DISABLE(); // Disable CRC module clock
 
-    BootloaderData_T bootloaderData = getBootloaderData(); // Fetch existing bootloader data
-    bootloaderData.app2_info = info; // Replace application 1 info with new info
-    bootloaderData.app2_faultCount = 0; // Reset application 1 fault count
-    bootloaderData.app2_infoChecksum = appInfoChecksum; // Set application info checksum
-
-    uint32_t bootloaderDataAddress = (uint32_t) &__FLASH_BL_DATA_START; // Get base address of bootloader data
+void resetWriteChecksum(uint8_t app){ // Start the running checksum of an application space (erased)
+    writeChecksum[app - 1].tracking = 1;
+    writeChecksum[app - 1].length = 0;
+    writeChecksum[app - 1].checksum = 0;
+}
 
-    // Flash erase procedure
-    uint32_t flashPage = (bootloaderDataAddress - FLASH_BASE)/FLASH_PAGE_SIZE; // Calculate the flash page number
-    uint32_t pageError; // Page error code (for HAL)
-    // Flash erase parameters
-    FLASH_EraseInitTypeDef flashErase = {0};
-    flashErase.TypeErase = FLASH_TYPEERASE_PAGES;
-    flashErase.Page = flashPage;
-    flashErase.NbPages = 1;
-    if (HAL_FLASHEx_Erase(&flashErase, &pageError) != HAL_OK) { // Erase flash page
-        HAL_FLASH_Lock();
-        return BL_ERROR_HAL; // Return error if erase fails
+void updateWriteChecksum(uint8_t app, uint32_t address, uint32_t length){ // Add data programmed (and verified) at address in an application space to its running checksum
+    WriteChecksum_T *written = &writeChecksum[app - 1];
+    if (!written->tracking) {return;}
+    if (address != written->length) { // Written out of sequence, the checksum of the application can no longer be followed
+        written->tracking = 0;
+        return;
     }
-
-    // Flash write procedure
-    uint64_t datachunk; // Data double-word to write to flash
-    for (uint32_t dw = 0; dw < sizeof(BootloaderData_T); dw += 8) { // Iterate through bootloader data in double-words
-        if (sizeof(BootloaderData_T) - dw >= 8){
-            datachunk = *((uint64_t*)((uint32_t)&bootloaderData + dw)); // Get data double word
-        } else {
-            datachunk = *((uint64_t*)((uint32_t)&bootloaderData + dw)) | ((uint64_t)0xFFFFFFFFFFFFFFFF >> (sizeof(BootloaderData_T) - dw)*8); // Get data double word and mask unused bytes
-        }
-
-        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, bootloaderDataAddress + dw, datachunk) != HAL_OK) { // Write double word to flash
-            HAL_FLASH_Lock();
-            return BL_ERROR_HAL; // Return error if write fails
-        }
+    uint32_t checked = WRITE_CHECKSUM_LENGTH(written->length);
+    written->length += length;
+    if (WRITE_CHECKSUM_LENGTH(written->length) > checked) { // Checksum of the data in flash (as it will be verified at boot), up to the last double-word written
+        written->checksum = accumulateChecksum(written->checksum, (void *)(APP_SLOT_START(app) + checked), WRITE_CHECKSUM_LENGTH(written->length) - checked);
     }
+}
 
-    // Data verification procedure
-    uint32_t wdata;
-    uint32_t rdata;
-    for (uint32_t wd = 0; wd < sizeof(BootloaderData_T); wd += 4) { // Iterate through bootloader data in words
-        wdata = *((uint32_t*)((uint32_t)&bootloaderData + wd)); // Get bootloader data word
-        rdata = *((uint32_t*)(bootloaderDataAddress + wd)); // Get word from flash
-        if (sizeof(BootloaderData_T) - wd < 4) { // Mask unused data bytes
-            wdata |= ((uint32_t)0xFFFFFFFF >> (sizeof(BootloaderData_T) - wd)*8);
-            rdata |= ((uint32_t)0xFFFFFFFF >> (sizeof(BootloaderData_T) - wd)*8);
-        }
-        if (rdata != wdata) {
-            return BL_ERROR_WRITE_VERIFICATION;
-        }
-    }
+BootloaderStatus_T getWriteChecksum(uint8_t app, uint32_t *length, uint32_t *checksum){ // Get the length and CRC32 of the data written to an application space since it was erased (BL_ERROR unless written in sequence from its start)
+    if (!IS_APP_SLOT(app)) {return BL_ERROR_OUT_OF_RANGE;}
+    if (!writeChecksum[app - 1].tracking) {return BL_ERROR;}
+    *length = writeChecksum[app - 1].length;
+    return getWriteChecksumTo(app, writeChecksum[app - 1].length, checksum);
+}
 
+BootloaderStatus_T getWriteChecksumTo(uint8_t app, uint32_t length, uint32_t *checksum){ // Get the CRC32 of the first length bytes written to an application space since it was erased (BL_ERROR unless written in sequence from its start and length ends in the last double-word written)
+    if (!IS_APP_SLOT(app)) {return BL_ERROR_OUT_OF_RANGE;}
+    WriteChecksum_T *written = &writeChecksum[app - 1];
+    uint32_t checked = WRITE_CHECKSUM_LENGTH(written->length);
+    if (!written->tracking || length < checked || length > written->length) {return BL_ERROR;}
+    *checksum = written->checksum;
+    if (length > checked) { // Complete the checksum from the last double-word in flash
+        *checksum = accumulateChecksum(*checksum, (void *)(APP_SLOT_START(app) + checked), length - checked);
+    }
     return BL_OK;
 }
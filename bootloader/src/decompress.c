@@ -0,0 +1,141 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Compressed updates (implementation)
+Streaming decompressor for compressed update images (images made by make_compressed_update.py)
+*/
+
+/* DEPENDENCIES */
+#include "decompress.h"
+
+/* CONSTANT DEFINITIONS AND MACROS */
+
+
+/* GLOBAL VARIABLES */
+
+
+/* FUNCTIONS */
+
+BootloaderStatus_T compressedImage_open(CompressedImage_T *image, uint8_t app){ // Start writing a compressed update image to an application space (flash unlocked, pages erased as they are written)
+    image->state = COMPRESSED_STATE_ERROR;
+    BootloaderStatus_T status = appWriter_openErase(&image->writer, app, 0); // Application written from the start of the application space
+    if (status != BL_OK) {return status;}
+
+    image->received = 0;
+    image->state = COMPRESSED_STATE_HEADER;
+    return BL_OK;
+}
+
+BootloaderStatus_T compressedImage_push(CompressedImage_T *image, const void *data, uint32_t length){ // Decompress and write the next part of a compressed update image (any length)
+    if (image->state == COMPRESSED_STATE_ERROR) {return BL_ERROR;}
+
+    const uint8_t *bytes = (const uint8_t *) data;
+    BootloaderStatus_T status = BL_OK;
+    while (length && status == BL_OK) {
+        if (image->state == COMPRESSED_STATE_LITERALS) { // Write literals straight from the image data
+            uint32_t chunk = (length < image->length) ? length : image->length;
+            status = appWriter_push(&image->writer, bytes, chunk);
+            bytes += chunk;
+            length -= chunk;
+            image->length -= chunk;
+            if (image->length == 0) { // Last sequence has no match
+                image->state = (image->writer.address == image->header.size) ? COMPRESSED_STATE_END : COMPRESSED_STATE_OFFSET_LOW;
+            }
+            continue;
+        }
+
+        uint8_t byte = *bytes++;
+        length--;
+        if (image->state == COMPRESSED_STATE_HEADER) { // Collect the header
+            ((uint8_t *) &image->header)[image->received++] = byte;
+            if (image->received == sizeof(CompressedImageHeader_T)) {
+                if (image->header.magic != COMPRESSED_IMAGE_MAGIC) {
+                    status = BL_ERROR;
+                } else if (image->header.size > image->writer.length) { // Check that the application fits the application space
+                    status = BL_ERROR_OUT_OF_RANGE;
+                }
+                image->state = COMPRESSED_STATE_TOKEN;
+            }
+        } else if (image->state == COMPRESSED_STATE_TOKEN) { // Start a sequence
+            image->token = byte;
+            image->length = byte >> 4;
+            if (image->length == 15) {
+                image->state = COMPRESSED_STATE_LITERAL_LENGTH;
+            } else {
+                status = compressedImage_literals(image);
+            }
+        } else if (image->state == COMPRESSED_STATE_LITERAL_LENGTH) { // Literal length extension (bytes of 255 continue it)
+            image->length += byte;
+            if (byte != 255) {status = compressedImage_literals(image);}
+        } else if (image->state == COMPRESSED_STATE_OFFSET_LOW) {
+            image->offset = byte;
+            image->state = COMPRESSED_STATE_OFFSET_HIGH;
+        } else if (image->state == COMPRESSED_STATE_OFFSET_HIGH) {
+            image->offset |= (uint32_t) byte << 8;
+            image->length = image->token & 0x0F;
+            if (image->length == 15) {
+                image->state = COMPRESSED_STATE_MATCH_LENGTH;
+            } else {
+                status = compressedImage_match(image);
+            }
+        } else if (image->state == COMPRESSED_STATE_MATCH_LENGTH) { // Match length extension (bytes of 255 continue it)
+            image->length += byte;
+            if (byte != 255) {status = compressedImage_match(image);}
+        } else { // Data after the end of the application
+            status = BL_ERROR;
+        }
+    }
+
+    if (status != BL_OK) {image->state = COMPRESSED_STATE_ERROR;}
+    return status;
+}
+
+BootloaderStatus_T compressedImage_close(CompressedImage_T *image){ // Finish a compressed update image and check the application against the image header
+    if (image->state != COMPRESSED_STATE_END) { // Image incomplete
+        image->state = COMPRESSED_STATE_ERROR;
+        return BL_ERROR;
+    }
+    image->state = COMPRESSED_STATE_ERROR; // No further data accepted
+
+    BootloaderStatus_T status = appWriter_close(&image->writer);
+    if (status != BL_OK) {return status;}
+
+    uint32_t writtenLength, writtenChecksum;
+    if (getWriteChecksum(image->writer.app, &writtenLength, &writtenChecksum) != BL_OK || writtenChecksum != image->header.appChecksum) {
+        return BL_ERROR_CHECKSUM; // Application does not match the image header (corrupt image)
+    }
+    return BL_OK;
+}
+
+BootloaderStatus_T compressedImage_literals(CompressedImage_T *image){ // Start the literal run of the current sequence (length known)
+    if (image->length > image->header.size - image->writer.address) {return BL_ERROR_OUT_OF_RANGE;} // Check that literals lie within the application
+    if (image->length) {
+        image->state = COMPRESSED_STATE_LITERALS;
+    } else {
+        image->state = (image->writer.address == image->header.size) ? COMPRESSED_STATE_END : COMPRESSED_STATE_OFFSET_LOW;
+    }
+    return BL_OK;
+}
+
+BootloaderStatus_T compressedImage_match(CompressedImage_T *image){ // Copy the match of the current sequence from the application written so far (length and offset known)
+    uint32_t length = image->length + COMPRESSED_MIN_MATCH;
+    uint32_t offset = image->offset;
+    if (offset == 0 || offset > image->writer.address) {return BL_ERROR_OUT_OF_RANGE;} // Check that match lies within the application written so far
+    if (length > image->header.size - image->writer.address) {return BL_ERROR_OUT_OF_RANGE;}
+
+    uint8_t buffer[COMPRESSED_COPY_BUFFER];
+    while (length) {
+        uint32_t chunk = (length < COMPRESSED_COPY_BUFFER) ? length : COMPRESSED_COPY_BUFFER;
+        uint32_t source = image->writer.address - offset;
+        for (uint32_t i = 0; i < chunk; i++) { // Matches may overlap the bytes they produce
+            buffer[i] = (i >= offset) ? buffer[i - offset] : appWriter_read(&image->writer, source + i);
+        }
+        BootloaderStatus_T status = appWriter_push(&image->writer, buffer, chunk);
+        if (status != BL_OK) {return status;}
+        length -= chunk;
+    }
+
+    image->state = (image->writer.address == image->header.size) ? COMPRESSED_STATE_END : COMPRESSED_STATE_TOKEN;
+    return BL_OK;
+}
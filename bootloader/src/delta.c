@@ -0,0 +1,134 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Delta updates (implementation)
+Delta update patch applier (patches made by make_delta_update.py)
+*/
+
+/* DEPENDENCIES */
+#include "delta.h"
+
+/* CONSTANT DEFINITIONS AND MACROS */
+
+
+/* GLOBAL VARIABLES */
+
+
+/* FUNCTIONS */
+
+BootloaderStatus_T deltaPatch_open(DeltaPatch_T *patch, uint8_t oldApp, uint8_t app){ // Start applying a delta update patch to the application in oldApp, writing the patched application to application space app (flash unlocked, pages erased as they are written)
+    patch->state = DELTA_STATE_ERROR;
+    if (!IS_APP_SLOT(oldApp) || !IS_APP_SLOT(app) || oldApp == app) {return BL_ERROR_OUT_OF_RANGE;} // The old application is read while the patched one is written
+
+    BootloaderStatus_T status = appWriter_openErase(&patch->writer, app, 0); // Patched application written from the start of the application space
+    if (status != BL_OK) {return status;}
+
+    patch->oldApp = oldApp;
+    patch->oldBase = APP_SLOT_START(oldApp);
+    patch->oldAddress = 0;
+    patch->received = 0;
+    patch->state = DELTA_STATE_HEADER;
+    return BL_OK;
+}
+
+BootloaderStatus_T deltaPatch_push(DeltaPatch_T *patch, const void *data, uint32_t length){ // Apply the next part of a delta update patch (any length)
+    if (patch->state == DELTA_STATE_ERROR) {return BL_ERROR;}
+
+    const uint8_t *bytes = (const uint8_t *) data;
+    BootloaderStatus_T status = BL_OK;
+    while (length && status == BL_OK) {
+        if (patch->state == DELTA_STATE_HEADER) { // Collect the header
+            ((uint8_t *) &patch->header)[patch->received++] = *bytes++;
+            length--;
+            if (patch->received == sizeof(DeltaPatchHeader_T)) {
+                status = deltaPatch_header(patch);
+                patch->state = DELTA_STATE_OPCODE;
+            }
+        } else if (patch->state == DELTA_STATE_OPCODE) { // Start an operation
+            patch->opcode = *bytes++;
+            length--;
+            patch->field = 0;
+            patch->shift = 0;
+            if (patch->opcode == DELTA_OP_END) {
+                patch->state = DELTA_STATE_END;
+            } else if (patch->opcode == DELTA_OP_COPY || patch->opcode == DELTA_OP_INSERT) {
+                patch->state = DELTA_STATE_LENGTH;
+            } else {
+                status = BL_ERROR; // Unknown operation
+            }
+        } else if (patch->state == DELTA_STATE_LENGTH) { // Operation length
+            length--;
+            if (!deltaPatch_field(patch, *bytes++)) {continue;}
+            patch->length = patch->field;
+            if (patch->length > patch->header.newSize - patch->writer.address) { // Check that the operation lies within the patched application
+                status = BL_ERROR_OUT_OF_RANGE;
+            } else if (patch->opcode == DELTA_OP_COPY) {
+                patch->field = 0;
+                patch->shift = 0;
+                patch->state = DELTA_STATE_OFFSET;
+            } else {
+                patch->state = patch->length ? DELTA_STATE_INSERT : DELTA_STATE_OPCODE;
+            }
+        } else if (patch->state == DELTA_STATE_OFFSET) { // Copy offset, then copy
+            length--;
+            if (!deltaPatch_field(patch, *bytes++)) {continue;}
+            status = deltaPatch_copy(patch, patch->field);
+            patch->state = DELTA_STATE_OPCODE;
+        } else if (patch->state == DELTA_STATE_INSERT) { // Write inserted bytes straight from the patch data
+            uint32_t chunk = (length < patch->length) ? length : patch->length;
+            status = appWriter_push(&patch->writer, bytes, chunk);
+            bytes += chunk;
+            length -= chunk;
+            patch->length -= chunk;
+            if (patch->length == 0) {patch->state = DELTA_STATE_OPCODE;}
+        } else { // Data after the end of the patch
+            status = BL_ERROR;
+        }
+    }
+
+    if (status != BL_OK) {patch->state = DELTA_STATE_ERROR;}
+    return status;
+}
+
+BootloaderStatus_T deltaPatch_close(DeltaPatch_T *patch){ // Finish a delta update patch and check the patched application against the patch header
+    if (patch->state != DELTA_STATE_END || patch->writer.address != patch->header.newSize) { // Patch incomplete
+        patch->state = DELTA_STATE_ERROR;
+        return BL_ERROR;
+    }
+    patch->state = DELTA_STATE_ERROR; // No further data accepted
+
+    BootloaderStatus_T status = appWriter_close(&patch->writer);
+    if (status != BL_OK) {return status;}
+
+    uint32_t writtenLength, writtenChecksum;
+    if (getWriteChecksum(patch->writer.app, &writtenLength, &writtenChecksum) != BL_OK || writtenChecksum != patch->header.newChecksum) {
+        return BL_ERROR_CHECKSUM; // Patched application does not match the application the patch was made for
+    }
+    return BL_OK;
+}
+
+BootloaderStatus_T deltaPatch_header(DeltaPatch_T *patch){ // Check a received patch header against the old application and the application space being written
+    if (patch->header.magic != DELTA_PATCH_MAGIC) {return BL_ERROR;}
+    AppInfo_T oldInfo = app_getInfo(patch->oldApp);
+    if (patch->header.oldSize != oldInfo.size || patch->header.oldChecksum != oldInfo.appChecksum) {return BL_ERROR_CHECKSUM;} // Patch made for a different application
+    if (patch->header.oldSize > APP_SLOT_LENGTH(patch->oldApp) || patch->header.newSize > patch->writer.length) {return BL_ERROR_OUT_OF_RANGE;}
+    return BL_OK;
+}
+
+BootloaderStatus_T deltaPatch_copy(DeltaPatch_T *patch, uint32_t offset){ // Copy the current operation length of bytes from the old application (offset from the end of the previous copy, zigzag encoded)
+    uint32_t start = patch->oldAddress + ((offset >> 1) ^ -(offset & 1)); // Decode signed offset
+    if (start > patch->header.oldSize || patch->length > patch->header.oldSize - start) {return BL_ERROR_OUT_OF_RANGE;} // Check that copy lies within the old application
+    patch->oldAddress = start + patch->length;
+    return appWriter_push(&patch->writer, (const void *)(patch->oldBase + start), patch->length);
+}
+
+uint8_t deltaPatch_field(DeltaPatch_T *patch, uint8_t byte){ // Add a byte to the variable-length field being decoded (1 when the field is complete)
+    if (patch->shift < 32) {
+        patch->field |= (uint32_t)(byte & 0x7F) << patch->shift;
+        patch->shift += 7;
+    } else {
+        patch->field = 0xFFFFFFFF; // Too long, out of range
+    }
+    return !(byte & 0x80);
+}
@@ -0,0 +1,165 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+RAM flash routines (implementation)
+Flash erase and program routines run from a copy in application RAM, so interrupts with RAM-resident handlers are taken while the single flash bank is busy
+*/
+
+/* DEPENDENCIES */
+#include <stddef.h>                 // NULL
+#include "flash_ram.h"
+#include "boot_stats.h"             // TIM2 measurements
+
+/* CONSTANT DEFINITIONS AND MACROS */
+
+
+/* GLOBAL VARIABLES */
+FlashRam_T *activeFlashRam; // RAM flash routines blocking flash operations run from (NULL to run them from flash with the HAL) (.bss, cleared at boot)
+
+/* FUNCTIONS */
+
+BootloaderStatus_T setFlashRam(FlashRam_T *ram, uint32_t irqMask, uint8_t fastRows){ // Run blocking flash erases and writes from RAM routines copied into ram, with only the irqMask interrupts enabled (vector table in RAM, NULL to run them from flash again)
+    if (ram == NULL) {
+        activeFlashRam = NULL;
+        return BL_OK;
+    }
+    uint32_t sramStart = (uint32_t) &__SRAM_START;
+    uint32_t sramEnd = sramStart + (uint32_t) &__SRAM_LEN;
+    if ((uint32_t) ram % 4) {return BL_ERROR_DATA_ALIGNMENT;} // Routines are copied a word at a time
+    if ((uint32_t) ram < sramStart || (uint32_t) ram + sizeof(FlashRam_T) > sramEnd) {return BL_ERROR_OUT_OF_RANGE;} // Routines run from application SRAM
+    if (SCB->VTOR < sramStart || SCB->VTOR >= sramEnd) {return BL_ERROR;} // Interrupts taken while flash is busy must not fetch their vectors from flash
+
+#ifndef HOST_SIM
+    uint32_t codeSize = (uint32_t) &__BL_RAMFUNC_END - (uint32_t) &__BL_RAMFUNC_START;
+    if (codeSize > sizeof(ram->code)) {return BL_ERROR_OUT_OF_RANGE;} // Routines of this build do not fit BL_FLASH_RAM_CODE_SIZE
+    const uint32_t *source = (const uint32_t *) &__BL_RAMFUNC_START;
+    for (uint32_t i = 0; i < codeSize/4; i++) { // Copied a word at a time (the section is word aligned), as the startup code copies .data (no library calls before flash operations can run)
+        ram->code[i] = source[i];
+    }
+    __DSB(); // Copy complete before it is executed
+    __ISB();
+#endif
+
+    ram->irqMask = irqMask;
+    ram->operations = 0;
+    ram->lastCycles = 0;
+    ram->lastMaskedCycles = 0;
+    ram->worstCycles = 0;
+    ram->worstMaskedCycles = 0;
+    ram->fastRows = fastRows;
+    activeFlashRam = ram;
+    return BL_OK;
+}
+
+HAL_StatusTypeDef flashRam_erase(FLASH_EraseInitTypeDef *erase, uint32_t *pageError){ // Erase flash pages as HAL_FLASHEx_Erase does (from RAM a page at a time if setFlashRam enabled it)
+    FlashRam_T *ram = activeFlashRam;
+    if (ram == NULL) {return HAL_FLASHEx_Erase(erase, pageError);}
+
+    *pageError = 0xFFFFFFFF;
+    for (uint32_t page = erase->Page; page < erase->Page + erase->NbPages; page++) { // Interrupts left in flash are taken between pages
+        if (flashRam_operation(ram, FLASH_CR_PER | ((page << FLASH_CR_PNB_Pos) & FLASH_CR_PNB), 0, NULL) != HAL_OK) {
+            *pageError = page;
+            return HAL_ERROR;
+        }
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef flashRam_program(uint32_t typeProgram, uint32_t address, uint64_t data){ // Program a double-word or a fast programming row as HAL_FLASH_Program does (from RAM if setFlashRam enabled it)
+    FlashRam_T *ram = activeFlashRam;
+    if (ram == NULL && typeProgram == FLASH_TYPEPROGRAM_FAST) { // HAL_FLASH_Program would run its fast programming routine from flash
+        return (programFastRow(address, (uint64_t *) (uintptr_t) (uint32_t) data) == BL_OK) ? HAL_OK : HAL_ERROR;
+    } else if (ram == NULL) {
+        return HAL_FLASH_Program(typeProgram, address, data);
+    }
+
+    if (typeProgram == FLASH_TYPEPROGRAM_DOUBLEWORD) {
+        return flashRam_operation(ram, FLASH_CR_PG, address, (const uint32_t *) &data);
+    }
+    const uint64_t *row = (const uint64_t *) (uintptr_t) (uint32_t) data; // Data holds the address of the row
+    if (ram->fastRows) {
+        return flashRam_operation(ram, FLASH_CR_FSTPG, address, (const uint32_t *) row);
+    }
+    for (uint32_t i = 0; i < BL_WRITER_ROW_SIZE/8; i++) { // Row programmed a double-word at a time, so interrupts are never masked for long
+        if (row[i] == 0xFFFFFFFFFFFFFFFF) {continue;} // Left erased
+        if (flashRam_operation(ram, FLASH_CR_PG, address + 8*i, (const uint32_t *) &row[i]) != HAL_OK) {return HAL_ERROR;}
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef flashRam_operation(FlashRam_T *ram, uint32_t control, uint32_t address, const uint32_t *data){ // Run a flash operation from the RAM routines with only the registered interrupts enabled, recording its timing
+#ifndef HOST_SIM
+    FlashRamRoutine_T run = (FlashRamRoutine_T) ((uint32_t) ram->code + ((uint32_t) flashRam_run - (uint32_t) &__BL_RAMFUNC_START)); // Same offset in the copy (Thumb bit kept)
+#else
+    FlashRamRoutine_T run = flashRam_run;
+#endif
+
+    uint32_t disabled = 0; // Interrupts disabled for the operation (a handler in flash would stall the core until it ends, holding off the RAM-resident ones)
+    for (uint32_t irq = 0; irq < FLASHRAM_IRQS; irq++) {
+        if (!(ram->irqMask & (1UL << irq)) && NVIC_GetEnableIRQ((IRQn_Type) irq)) {
+            NVIC_DisableIRQ((IRQn_Type) irq);
+            disabled |= 1UL << irq;
+        }
+    }
+    uint8_t started = bootStats_startTimer(); // Time the operation (if TIM2 is free, or already counting for an outer measurement)
+    uint8_t timed = started || bootStats_isTimerRunning();
+
+    uint32_t timing[2];
+    uint32_t errors = run(control, address, data, timing);
+
+    bootStats_stopTimer(started);
+    for (uint32_t irq = 0; irq < FLASHRAM_IRQS; irq++) { // Interrupts that became pending meanwhile are taken now
+        if (disabled & (1UL << irq)) {NVIC_EnableIRQ((IRQn_Type) irq);}
+    }
+
+    ram->operations++;
+    ram->lastCycles = timed ? timing[0] : 0;
+    ram->lastMaskedCycles = timed ? timing[1] : 0;
+    if (ram->lastCycles > ram->worstCycles) {ram->worstCycles = ram->lastCycles;}
+    if (ram->lastMaskedCycles > ram->worstMaskedCycles) {ram->worstMaskedCycles = ram->lastMaskedCycles;}
+    return errors ? HAL_ERROR : HAL_OK;
+}
+
+RAMFUNC uint32_t flashRam_run(uint32_t control, uint32_t address, const uint32_t *data, uint32_t *timing){ // Run a flash operation and wait for it to end, returning its error flags (runs from RAM, timing gets its duration and the time interrupts were masked in TIM2 counts)
+    // control: FLASH_CR_PER with the page number, FLASH_CR_PG (data holds a double-word) or FLASH_CR_FSTPG (data holds a row)
+    while (FLASH->SR & (FLASH_SR_BSY1 | FLASH_SR_CFGBSY)) {} // Previous operation (an asynchronous writer may have left one running)
+    uint32_t errors = FLASH->SR & FLASH_FLAG_ALL_ERRORS;
+    if (errors) { // Errors left by a previous operation fail this one, as the HAL reports them
+        __HAL_FLASH_CLEAR_FLAG(errors);
+        timing[0] = 0;
+        timing[1] = 0;
+        return errors;
+    }
+
+    uint32_t start = TIM2->CNT;
+    uint32_t maskStart = 0;
+    uint32_t maskEnd = 0;
+    uint32_t primask = 0;
+    FLASH->CR = (FLASH->CR & ~FLASH_CR_PNB) | control;
+    if (control & FLASH_CR_PER) {
+        FLASH->CR |= FLASH_CR_STRT;
+    } else if (control & FLASH_CR_PG) {
+        FLASH_WRITE_WORD(address, data[0]);
+        __ISB(); // Words reach the controller in order
+        FLASH_WRITE_WORD(address + 4, data[1]);
+    } else { // Fast programming: double-words must follow each other within the programming time, so the row is written and waited for with interrupts masked (as the HAL does)
+        primask = __get_PRIMASK();
+        __disable_irq();
+        maskStart = TIM2->CNT;
+        fastRowSequence(address, data); // The sequence programFastRow runs (copied with these routines)
+    }
+    while (FLASH->SR & FLASH_SR_BSY1) {} // RAM-resident interrupts are taken meanwhile (unless masked)
+    uint32_t end = TIM2->CNT;
+    if (control & FLASH_CR_FSTPG) {
+        maskEnd = end;
+        __set_PRIMASK(primask);
+    }
+
+    errors = FLASH->SR & FLASH_FLAG_ALL_ERRORS;
+    __HAL_FLASH_CLEAR_FLAG(errors | FLASH_FLAG_EOP);
+    FLASH->CR &= ~(control | FLASH_CR_PNB);
+    timing[0] = end - start;
+    timing[1] = maskEnd - maskStart;
+    return errors;
+}
@@ -13,180 +13,261 @@ Bootloader logic code
 
 
 /* GLOBAL VARIABLES */
-uint8_t appSelection __attribute__((section(".sram_bl_static"))); // App selection in special section
+
 
 /* FUNCTIONS */
 
+uint8_t isApplicationExcluded(uint8_t app, BootloaderData_T *bootloaderData) { // Check for application exclusion factors (not installed or fault threshold exceeded)
+    AppInfo_T *info = &bootloaderData->app[app - 1].info;
+    uint8_t faultCount = bootloaderData->app[app - 1].faultCount;
+
+    if (info->ID == 0 || info->ID == 0xFFFFFFFF || info->size == 0 || info->size == 0xFFFFFFFF) { // Check for app not installed
+        return 1;
+    }
+    if (faultCount >= FAULT_THRESHOLD) { // Check for fault threshold exceeded
+        return 1;
+    }
+    return 0;
+}
+
+uint8_t isApplicationPreferred(uint8_t app, uint8_t other, BootloaderData_T *bootloaderData) { // Check whether an application should be tried before another (boot priority, or same ID as application 1 and a higher version)
+    if (bootloaderData->bootPriority != BOOTPRIO_AUTOMATIC) { // Priority application first, the rest in order (application 1 first if the priority is invalid)
+        return app == bootloaderData->bootPriority - BOOTPRIO_APP1 + 1;
+    }
+    // If IDs are the same as application 1, prefer the app with the highest version number (the rest in order)
+    AppInfo_T *info = &bootloaderData->app[app - 1].info;
+    AppInfo_T *otherInfo = &bootloaderData->app[other - 1].info;
+    uint32_t ID = bootloaderData->app[0].info.ID;
+    if (info->ID != ID) {return 0;}
+    return (otherInfo->ID != ID) || (info->version > otherInfo->version);
+}
+
+uint8_t isVectorTableValid(uint8_t app) { // Check that the initial stack pointer of an application lies in SRAM and its reset handler is a thumb address in its application space
+    uint32_t appAddr = APP_SLOT_START(app);
+    uint32_t stackPointer = ((uint32_t *) appAddr)[0];
+    uint32_t startup = ((uint32_t *) appAddr)[1];
+    uint32_t sramStart = (uint32_t) &__SRAM_START;
+#ifdef HOST_SIM
+    simFlashRead(2); // The host reads the vector table for free, the simulated core does not
+#endif
+    if (stackPointer <= sramStart || stackPointer > sramStart + (uint32_t) &__SRAM_LEN || (stackPointer % 4)) {return 0;}
+    return (startup & 1) && startup > appAddr + VECTOR_TABLE_SIZE*4 && startup < appAddr + APP_SLOT_LENGTH(app);
+}
+
+void fastBoot(uint8_t timed, ResetCause_T cause) { // Start the application recorded by a fast boot mark if the reset allows it (returns if a full boot is needed), timed if the boot timer was started
+    if (cause != RESET_CAUSE_POWER && cause != RESET_CAUSE_PIN) {return;} // Power-on and pin resets only (other resets are counted against the application, software resets usually follow an update)
+
+    // The journal must end with a fast boot mark (written by a full boot with nothing appended since), the record it follows was validated by that boot
+    BootloaderJournal_T journal;
+    int32_t record = findBootloaderRecord(&journal, 0);
+    if (record < 0 || !IS_APP_SLOT(journal.fastBootApp) || !isVectorTableValid(journal.fastBootApp)) {return;}
+    uint32_t length, layout;
+    const BootloaderData_T *bootloaderData = getBootloaderRecordData(journal.page, record, &length, &layout); // Read in place (no copy)
+    if (layout != BL_DATA_LAYOUT || length != sizeof(BootloaderData_T) || bootloaderData->fastBootMode != FASTBOOT_ON) {return;} // Records in other layouts are migrated by a full boot
+
+    bootStats_beginBoot(); // Statistics counted in SRAM (restored from the journal after power-on)
+    appSelection = journal.fastBootApp; // Later resets are still counted against the application
+    configureWatchdog(bootloaderData->watchdogMode);
+    bootStats_countBoot(bootStats_stopTimer(timed));
+    uint32_t appAddr = APP_SLOT_START(appSelection);
+    SCB->VTOR = appAddr; // Set VTOR
+    startApplication(((uint32_t *) appAddr)[0], ((uint32_t *) appAddr)[1]); // Start application
+}
+
+uint8_t verifyApplication(uint8_t app, BootloaderData_T *bootloaderData, uint8_t recheck) { // Verify an application according to the verification mode
+    AppInfo_T *info = &bootloaderData->app[app - 1].info;
+    uint32_t infoChecksum = bootloaderData->app[app - 1].infoChecksum;
+    uint32_t generation = bootloaderData->generation[app - 1];
+    VerificationRecord_T *verified = &bootloaderData->verified[app - 1];
+    uint32_t appAddr = APP_SLOT_START(app);
+    VerificationMode_T mode = bootloaderData->verificationMode;
+
+    if (mode == VERIFICATION_APP_INFO || mode == VERIFICATION_FULL) {
+        // Verify app info
+        if (calculateChecksum(info, sizeof(AppInfo_T)) != infoChecksum) {
+            return 0;
+        }
+    }
+
+    if (mode == VERIFICATION_VECTOR_TABLE) {
+        // Verify app vector table
+        if (calculateChecksum((void *) appAddr, VECTOR_TABLE_SIZE*4) != info->vectblChecksum) {
+            return 0;
+        }
+    }
+
+    if (mode == VERIFICATION_APPLICATION || mode == VERIFICATION_FULL) {
+        // Verify application (skipped if the application has not changed since it was last verified, unless a re-check is due)
+        if (!recheck && isVerificationCached(generation, *verified, info->appChecksum)) {
+            return 1;
+        }
+
+        uint8_t valid = (calculateChecksum((void *) appAddr, info->size) == info->appChecksum);
+        VerificationRecord_T record = {generation, info->appChecksum};
+
+        // Update verification record
+        HAL_FLASH_Unlock(); // Unlock flash control
+        __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS); // Clear flash flags
+        if (recordVerification(app, record, valid) == BL_OK) {
+            verified->generation = valid ? record.generation : 0;
+            verified->appChecksum = valid ? record.appChecksum : 0;
+        }
+        HAL_FLASH_Lock(); // Lock flash control
+
+        return valid;
+    }
+
+    return 1;
+}
+
 void main() { // Main function (bootloader logic)
+    uint8_t timed = bootStats_startTimer(); // Time the boot (TIM2 is free after reset)
+    ResetInfo_T reset = resetCause_decode(); // Cause of this reset and the application it interrupted (reset flags cleared)
+    fastBoot(timed, reset.cause); // Start the last application straight away if nothing has changed (returns otherwise)
+
     __HAL_RCC_SYSCFG_CLK_ENABLE(); // Enable sysconfig module clock
     __HAL_RCC_PWR_CLK_ENABLE(); // Enable PWR module clock
 
     BootloaderData_T bootloaderData = getBootloaderData(); // Get bootloader data from flash
-    
+    uint32_t layout = getBootloaderDataLayout(); // Layout it was written in
+
     if ((bootloaderData.blVersion == 0x00000000) || (bootloaderData.blVersion == 0xFFFFFFFF)) { // Check for bootloader data initialisation
         // Initialise default values
         bootloaderData.blVersion = BOOTLOADER_VERSION;
         bootloaderData.bootPriority = BOOTPRIO_AUTOMATIC;
         bootloaderData.verificationMode = VERIFICATION_OFF;
         bootloaderData.watchdogMode = WATCHDOG_OFF;
-        bootloaderData.app1_infoChecksum = 0xFFFFFFFF;
-        bootloaderData.app1_faultCount = 0;
-        bootloaderData.app1_info.ID = 1;
-        bootloaderData.app1_info.version = 1;
-        bootloaderData.app1_info.size = 1;
-        bootloaderData.app1_info.vectblChecksum = 0xFFFFFFFF;
-        bootloaderData.app1_info.appChecksum = 0xFFFFFFFF;
-        bootloaderData.app2_infoChecksum = 0xFFFFFFFF;
-        bootloaderData.app2_faultCount = 0;
-        bootloaderData.app2_info.ID = 1;
-        bootloaderData.app2_info.version = 1;
-        bootloaderData.app2_info.size = 1;
-        bootloaderData.app2_info.vectblChecksum = 0xFFFFFFFF;
-        bootloaderData.app2_info.appChecksum = 0xFFFFFFFF;
+        bootloaderData.fastBootMode = FASTBOOT_OFF;
+        for (uint8_t i = 0; i < BL_APP_SLOTS; i++) {
+            bootloaderData.app[i].infoChecksum = 0xFFFFFFFF;
+            bootloaderData.app[i].faultCount = 0;
+            bootloaderData.app[i].info.ID = 1;
+            bootloaderData.app[i].info.version = 1;
+            bootloaderData.app[i].info.size = 1;
+            bootloaderData.app[i].info.vectblChecksum = 0xFFFFFFFF;
+            bootloaderData.app[i].info.appChecksum = 0xFFFFFFFF;
+            bootloaderData.generation[i] = 0;
+            bootloaderData.verified[i].generation = VERIFICATION_RECORD_ERASED;
+            bootloaderData.verified[i].appChecksum = VERIFICATION_RECORD_ERASED;
+        }
         writeBootloaderData(bootloaderData);
-    }
-
-    if (bootloaderData.blVersion != BOOTLOADER_VERSION) { // Check if stored version number matches current version number
+    } else if (layout != BL_DATA_LAYOUT || bootloaderData.blVersion != BOOTLOADER_VERSION) { // Written by a previous bootloader version, migrate
+        if (layout == 0) { // Unjournaled data, its fields are at the same offsets and the fields added since read as erased
+            bootloaderData.fastBootMode = FASTBOOT_OFF; // Was padding
+            for (uint8_t i = 0; i < BL_APP_SLOTS; i++) {
+                bootloaderData.generation[i] = 0;
+                bootloaderData.verified[i].generation = VERIFICATION_RECORD_ERASED;
+                bootloaderData.verified[i].appChecksum = VERIFICATION_RECORD_ERASED;
+            }
+        }
         bootloaderData.blVersion = BOOTLOADER_VERSION; // Update version number
-        writeBootloaderData(bootloaderData); // Write back to flash
+        writeBootloaderData(bootloaderData); // Write back to flash as a record in the current layout
     }
 
-    // Check for watchdog reset
-    if (__HAL_RCC_GET_FLAG(RCC_FLAG_IWDGRST)) {
-        __HAL_RCC_CLEAR_RESET_FLAGS(); // Clear flags
+    // Count the reset against the application it interrupted, and as a fault if the fault policy includes its cause
+    if (IS_APP_SLOT(reset.app) && resetCause_isCounted(reset.cause)) {
+        HAL_FLASH_Unlock(); // Unlock flash control
+        __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS); // Clear flash flags
+        uint8_t fault = resetCause_count(reset.app, reset.cause); // Append the reset counts to the bootloader data journal
+        HAL_FLASH_Lock(); // Lock flash control
 
         // Update appropriate app fault count
-        if (appSelection == 1) {
-            bootloaderData.app1_faultCount++;
-            writeBootloaderData(bootloaderData);
-        } else if (appSelection == 2) {
-            bootloaderData.app2_faultCount++;
+        if (fault && bootloaderData.app[reset.app - 1].faultCount < 0xFF) {
+            bootloaderData.app[reset.app - 1].faultCount++;
             writeBootloaderData(bootloaderData);
         }
     }
 
-    appSelection = 0; // Reset app selection
+    // Roll back an update that used all its trial boots without confirming itself (before candidates are chosen, so it is excluded)
+    TrialInfo_T trial;
+    trialBoot_read(&trial);
+    if (trialBoot_isExpired(&trial)) {
+        HAL_FLASH_Unlock(); // Unlock flash control
+        __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS); // Clear flash flags
+        trialBoot_rollBack(&trial, &bootloaderData); // Append the restored boot priority and fault count, then end the trial
+        HAL_FLASH_Lock(); // Lock flash control
+    }
 
-    // Check for application exclusion factors
-    uint8_t app1Exclusion = 0;
-    uint8_t app2Exclusion = 0;
+    appSelection = 0; // Reset app selection
+    bootStats_beginBoot(); // Restore the boot statistics after power-on and clear the last boot's figures
 
-    // Check for app not installed
-    if (bootloaderData.app1_info.ID == 0 || bootloaderData.app1_info.ID == 0xFFFFFFFF || bootloaderData.app1_info.size == 0 || bootloaderData.app1_info.size == 0xFFFFFFFF) {
-        app1Exclusion = 1;
-    }
-    if (bootloaderData.app2_info.ID == 0 || bootloaderData.app2_info.ID == 0xFFFFFFFF || bootloaderData.app2_info.size == 0 || bootloaderData.app2_info.size == 0xFFFFFFFF) {
-        app2Exclusion = 1;
+    // Build prioritised list of application candidates
+    uint8_t candidates[BL_APP_SLOTS]; // Application spaces in the order they should be tried
+    for (uint8_t app = 1; app <= BL_APP_SLOTS; app++) { // Insert each application space after the candidates it is not preferred to (in order otherwise)
+        uint8_t i = app - 1;
+        while (i > 0 && isApplicationPreferred(app, candidates[i - 1], &bootloaderData)) {
+            candidates[i] = candidates[i - 1];
+            i--;
+        }
+        candidates[i] = app;
     }
 
-    // Check for fault threshold exceeded
-    if (bootloaderData.app1_faultCount >= FAULT_THRESHOLD) {
-        app1Exclusion = 1;
+    // Prepare for verification if appropriate
+    uint8_t recheck = 1; // Fully verify applications even if they have cached verification results
+    if (bootloaderData.verificationMode == VERIFICATION_APPLICATION || bootloaderData.verificationMode == VERIFICATION_FULL) {
+        // Unchanged applications verified at their current generation are only re-verified on the last boot of every VERIFICATION_RECHECK_INTERVAL boots (not straight after bootloader data is written, which would undo verification during the write)
+        recheck = (VERIFICATION_RECHECK_INTERVAL <= 1) || ((getVerificationTicks() + 1) % VERIFICATION_RECHECK_INTERVAL == 0);
     }
-    if (bootloaderData.app2_faultCount >= FAULT_THRESHOLD) {
-        app2Exclusion = 1;
-    }
-
-    // Verify application if appropriate
-    if (bootloaderData.verificationMode != VERIFICATION_OFF) {
-        __HAL_RCC_CRC_CLK_ENABLE(); // Enable CRC module clock
-        // Configure CRC handle
-        CRC_HandleTypeDef crcHandle;
-        crcHandle.Instance = CRC;
-        crcHandle.Init.DefaultPolynomialUse = DEFAULT_POLYNOMIAL_ENABLE;
-        crcHandle.Init.DefaultInitValueUse = DEFAULT_INIT_VALUE_ENABLE;
-        crcHandle.Init.InputDataInversionMode = CRC_INPUTDATA_INVERSION_BYTE;
-        crcHandle.Init.OutputDataInversionMode = CRC_OUTPUTDATA_INVERSION_ENABLE;
-        crcHandle.InputDataFormat = CRC_INPUTDATA_FORMAT_BYTES;
-        HAL_CRC_Init(&crcHandle); // Initialise CRC module
 
-        if (bootloaderData.verificationMode == VERIFICATION_APP_INFO || bootloaderData.verificationMode == VERIFICATION_FULL) {
-            // Verify app info
-            if (~HAL_CRC_Calculate(&crcHandle, (uint32_t *) &bootloaderData.app1_info, sizeof(bootloaderData.app1_info)) != bootloaderData.app1_infoChecksum) {
-                app1Exclusion = 1;
-            }
-            if (~HAL_CRC_Calculate(&crcHandle, (uint32_t *) &bootloaderData.app2_info, sizeof(bootloaderData.app2_info)) != bootloaderData.app2_infoChecksum) {
-                app2Exclusion = 1;
-            }
+    // Select application (the first candidate that is not excluded, verifying only candidates that are tried)
+    for (uint8_t i = 0; i < BL_APP_SLOTS; i++) {
+        if (isApplicationExcluded(candidates[i], &bootloaderData)) {continue;}
+        if (bootloaderData.verificationMode != VERIFICATION_OFF) {
+            uint32_t verifyStart = bootStats_readTimer();
+            uint8_t valid = verifyApplication(candidates[i], &bootloaderData, recheck);
+            bootStats_countVerify(candidates[i], bootStats_readTimer() - verifyStart, valid);
+            if (!valid) {continue;}
         }
+        appSelection = candidates[i];
+        break;
+    }
 
-        if (bootloaderData.verificationMode == VERIFICATION_VECTOR_TABLE) {
-            // Verify app vector table
-            if (~HAL_CRC_Calculate(&crcHandle, (uint32_t *)&__FLASH_APP1_START, VECTOR_TABLE_SIZE*4) != bootloaderData.app1_info.vectblChecksum) {
-                app1Exclusion = 1;
-            }
-            if (~HAL_CRC_Calculate(&crcHandle, (uint32_t *)&__FLASH_APP2_START, VECTOR_TABLE_SIZE*4) != bootloaderData.app2_info.vectblChecksum) {
-                app2Exclusion = 1;
-            }
-        }
+    if (bootloaderData.verificationMode == VERIFICATION_APPLICATION || bootloaderData.verificationMode == VERIFICATION_FULL) {
+        // Count the boot
+        HAL_FLASH_Unlock(); // Unlock flash control
+        __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS); // Clear flash flags
+        addVerificationTick(); // Append a boot tick mark to the bootloader data journal
+        HAL_FLASH_Lock(); // Lock flash control
+    }
 
-        if (bootloaderData.verificationMode == VERIFICATION_APPLICATION || bootloaderData.verificationMode == VERIFICATION_FULL) {
-            // Verify application
-            if (~HAL_CRC_Calculate(&crcHandle, (uint32_t *)&__FLASH_APP1_START, bootloaderData.app1_info.size) != bootloaderData.app1_info.appChecksum) {
-                app1Exclusion = 1;
-            }
-            if (~HAL_CRC_Calculate(&crcHandle, (uint32_t *)&__FLASH_APP2_START, bootloaderData.app2_info.size) != bootloaderData.app2_info.appChecksum) {
-                app2Exclusion = 1;
-            }
-        }
+    // Use one of the trial boots if the selected application has not confirmed itself since it was installed
+    if (trialBoot_isOnTrial(&trial, appSelection)) {
+        HAL_FLASH_Unlock(); // Unlock flash control
+        __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS); // Clear flash flags
+        trialBoot_countBoot(&trial); // Append the trial boot state to the bootloader data journal
+        HAL_FLASH_Lock(); // Lock flash control
+    }
 
-        HAL_CRC_DeInit(&crcHandle); // De-initialise CRC module
-        __HAL_RCC_CRC_CLK_DISABLE(); // Disable CRC module clock
-    }
-
-    // Select application
-
-    if (app1Exclusion && app2Exclusion) {
-        appSelection = 0; // If both applications are excluded then no application is selected
-    } else if (app1Exclusion) {
-        appSelection = 2; // If app 1 is excluded choose app 2
-    } else if (app2Exclusion) {
-        appSelection = 1; // If app 2 is excluded choose app 1
-    } else { // If neither app is excluded, choose based on priority
-        if (bootloaderData.bootPriority == BOOTPRIO_APP1) {
-            appSelection = 1; // Choose app 1
-        } else if (bootloaderData.bootPriority == BOOTPRIO_APP2) {
-            appSelection = 2; // Choose app 2
-        } else if (bootloaderData.bootPriority == BOOTPRIO_AUTOMATIC) {
-            // Select based on ID and version
-            if (bootloaderData.app1_info.ID == bootloaderData.app2_info.ID) {
-                // If IDs are the same, select the app with the highest version number
-                if (bootloaderData.app1_info.version >= bootloaderData.app2_info.version) {
-                    appSelection = 1;
-                } else {
-                    appSelection = 2;
-                }
-            } else {
-                // If IDs are different default to app 1
-                appSelection = 1;
-            }
-        } else {
-            // If bootloader boot priority is invalid then no application is selected
-            appSelection = 0;
-        }
+    // Persist the boot statistics once a batch of boots has been counted (after the tick mark, before the fast boot mark that must end the journal)
+    if (bootStats_isPersistDue()) {
+        HAL_FLASH_Unlock(); // Unlock flash control
+        __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS); // Clear flash flags
+        bootStats_persist(); // Append a boot statistics entry to the bootloader data journal
+        HAL_FLASH_Lock(); // Lock flash control
+    }
+
+    // Let the fast boot path start the selected application until anything changes (if it has no faults and is not on trial, and it was verified if verification is on)
+    if (bootloaderData.fastBootMode == FASTBOOT_ON && IS_APP_SLOT(appSelection) && bootloaderData.app[appSelection - 1].faultCount == 0 && !trialBoot_isOnTrial(&trial, appSelection)) {
+        HAL_FLASH_Unlock(); // Unlock flash control
+        __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS); // Clear flash flags
+        setFastBootMark(appSelection); // Append a fast boot mark to the bootloader data journal (unless it already ends with one)
+        HAL_FLASH_Lock(); // Lock flash control
     }
 
     // Enable watchdog if appropriate
     configureWatchdog(bootloaderData.watchdogMode);
+    bootStats_countBoot(bootStats_stopTimer(timed)); // Boot time up to the application jump (or recovery mode)
 
     // Load selected application
-    uint32_t appAddr;
-    if (appSelection == 1) {
-        appAddr = (uint32_t) &__FLASH_APP1_START;
-        uint32_t *appSpace = (uint32_t *) appAddr;
-        uint32_t appStackPointer = appSpace[0]; // Get application stack pointer
-        uint32_t appStartup = appSpace[1]; // Get application startup code pointer
-        SCB->VTOR = appAddr; // Set VTOR
-        startApplication(appStackPointer, appStartup); // Start application
-    } else if (appSelection == 2) {
-        appAddr = (uint32_t) &__FLASH_APP2_START;
+    if (IS_APP_SLOT(appSelection)) {
+        uint32_t appAddr = APP_SLOT_START(appSelection);
         uint32_t *appSpace = (uint32_t *) appAddr;
         uint32_t appStackPointer = appSpace[0]; // Get application stack pointer
         uint32_t appStartup = appSpace[1]; // Get application startup code pointer
         SCB->VTOR = appAddr; // Set VTOR
         startApplication(appStackPointer, appStartup); // Start application
     } else {
-        while (1) {}; // Stall if no app is selected
+        recoveryMode(); // Wait for an application over the recovery transport if no app is selected (resets once one is installed)
     }
 
     while (1) {}; // Loop forever (not reached)
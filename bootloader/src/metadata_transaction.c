@@ -0,0 +1,81 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Metadata transaction (implementation)
+Batches bootloader data changes in a RAM shadow, written to the bootloader data journal as one record
+*/
+
+/* DEPENDENCIES */
+#include "metadata_transaction.h"
+#include "trial_boot.h"             // Trial boots
+
+/* CONSTANT DEFINITIONS AND MACROS */
+
+
+/* GLOBAL VARIABLES */
+MetadataTransaction_T metadataTransaction; // Metadata transaction (.bss, cleared at boot)
+
+/* FUNCTIONS */
+
+const BootloaderData_T *transaction_readData(){ // Get a pointer to the bootloader data as the application sees it (the transaction's changes while one is open, otherwise the current bootloader data in flash)
+    if (metadataTransaction.open) {return &metadataTransaction.data;}
+    return readBootloaderData();
+}
+
+BootloaderData_T transaction_getData(){ // Get a copy of the bootloader data as the application sees it (to change and write back with transaction_writeData)
+    return *transaction_readData();
+}
+
+BootloaderStatus_T transaction_writeData(BootloaderData_T data){ // Write bootloader data to flash, or keep it in the transaction while one is open
+    if (metadataTransaction.open) {
+        metadataTransaction.data = data;
+        return BL_OK;
+    }
+    return writeBootloaderData(data);
+}
+
+void transaction_stageInstall(const BootloaderData_T *data, uint8_t app){ // Keep bootloader data with newly installed application info in the open transaction (the application is put on trial when it is committed)
+    metadataTransaction.data = *data;
+    metadataTransaction.trialApp = app; // A later install replaces it, as it would replace the trial
+    metadataTransaction.trialFallbackPriority = data->bootPriority;
+}
+
+BootloaderStatus_T beginMetadataTransaction(){ // Begin a metadata transaction (setters change a RAM shadow of bootloader data until it is committed)
+    if (metadataTransaction.open) {return BL_ERROR;} // Transactions do not nest
+    metadataTransaction.data = getBootloaderData();
+    metadataTransaction.trialApp = 0;
+    metadataTransaction.open = 1;
+    return BL_OK;
+}
+
+BootloaderStatus_T commitMetadataTransaction(){ // Write the changes made in the metadata transaction as one bootloader data record and end it
+    if (!metadataTransaction.open) {return BL_ERROR;}
+    const BootloaderData_T *current = readBootloaderData();
+    WatchdogMode_T watchdogMode = current->watchdogMode;
+
+    HAL_FLASH_Unlock(); // Unlock flash control
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS); // Clear flash flags
+    BootloaderStatus_T status = BL_OK;
+    if (!isEqualBytes(current, &metadataTransaction.data, sizeof(BootloaderData_T))) { // Nothing is written if nothing changed
+        status = appendBootloaderData(&metadataTransaction.data);
+    }
+    if (status == BL_OK && IS_APP_SLOT(metadataTransaction.trialApp)) {
+        status = trialBoot_begin(metadataTransaction.trialApp, metadataTransaction.trialFallbackPriority); // Give the update its trial boots (if trial boots are on)
+    }
+    HAL_FLASH_Lock(); // Lock flash control
+    if (status != BL_OK) {return status;} // Left open, so the commit can be retried
+
+    metadataTransaction.open = 0;
+    if (metadataTransaction.data.watchdogMode != watchdogMode) {
+        return configureWatchdog(metadataTransaction.data.watchdogMode); // Watchdog mode changes take effect once committed
+    }
+    return BL_OK;
+}
+
+BootloaderStatus_T abortMetadataTransaction(){ // Discard the changes made in the metadata transaction and end it (nothing is written)
+    if (!metadataTransaction.open) {return BL_ERROR;}
+    metadataTransaction.open = 0;
+    metadataTransaction.trialApp = 0; // An application installed in the transaction is not put on trial (its info was not written)
+    return BL_OK;
+}
@@ -0,0 +1,189 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Recovery transport (implementation)
+Bootloader-resident application upload over USART2 (DMA circular double-buffered receive), used when no application can be started
+*/
+
+/* DEPENDENCIES */
+#include <stddef.h>
+#include "recovery.h"
+
+/* CONSTANT DEFINITIONS AND MACROS */
+
+
+/* GLOBAL VARIABLES */
+
+
+/* FUNCTIONS */
+
+void recoveryMode(){ // Receive applications over the recovery transport until one is installed, then reset (does not return)
+    uint8_t buffer[RECOVERY_BUFFER_SIZE] __attribute__((aligned(8))); // DMA circular receive buffer (two blocks, on the stack as no application is running)
+    RecoveryTransfer_T transfer;
+    recovery_init(buffer);
+
+    while (1) {
+        // Wait for an upload and write each block as it arrives, while DMA receives the next block into the other half of the buffer
+        recovery_start(buffer);
+        recovery_transmit(RECOVERY_READY);
+        transfer.received = 0;
+        uint32_t tail = 0; // Offset in the buffer of the next byte to process
+        uint32_t idle = 0; // Milliseconds without data
+        BootloaderStatus_T status = BL_OK;
+        while (status == BL_OK && !recovery_isComplete(&transfer)) {
+            resetWatchdog();
+            uint32_t head = recovery_head();
+            if (head == tail) { // Nothing received (upload abandoned if it stops part way)
+                if (recovery_tick() && transfer.received && ++idle >= RECOVERY_TIMEOUT_MS) {status = BL_ERROR;}
+                continue;
+            }
+            idle = 0;
+
+            // Process received bytes up to the end of the current block
+            uint32_t end = tail - (tail % RECOVERY_BLOCK_SIZE) + RECOVERY_BLOCK_SIZE;
+            if (head > tail && head < end) {end = head;}
+            status = recovery_receive(&transfer, buffer + tail, end - tail);
+            tail = end % RECOVERY_BUFFER_SIZE;
+            if (status == BL_OK && end % RECOVERY_BLOCK_SIZE == 0) { // Block written, its half of the buffer can be received into again
+                recovery_transmit(RECOVERY_ACK);
+            }
+        }
+
+        if (status == BL_OK) {status = recovery_finish(&transfer);}
+        disableProgrammingMode();
+        recovery_transmit(RECOVERY_RESULT);
+        recovery_transmit((uint8_t) status);
+        while (!(USART2->ISR & USART_ISR_TC)) {} // Let the result reach the host
+
+        if (status == BL_OK) {
+            NVIC_SystemReset(); // Boot the installed application
+        }
+        recovery_drain(); // Let the host stop sending before waiting for the next upload
+    }
+}
+
+void recovery_init(uint8_t *buffer){ // Configure USART2 with DMA circular reception into buffer (RECOVERY_BUFFER_SIZE bytes) and the SysTick millisecond timer
+    RCC->IOPENR |= RCC_IOPENR_GPIOAEN; // Enable GPIOA, DMA1 and USART2 clocks
+    RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+    RCC->APBENR1 |= RCC_APBENR1_USART2EN;
+
+    // PA2 (USART2 TX) and PA3 (USART2 RX, pulled up so an unconnected line is idle) in alternate function 1
+    GPIOA->AFR[0] = (GPIOA->AFR[0] & ~(GPIO_AFRL_AFSEL2 | GPIO_AFRL_AFSEL3)) | (1 << GPIO_AFRL_AFSEL2_Pos) | (1 << GPIO_AFRL_AFSEL3_Pos);
+    GPIOA->PUPDR = (GPIOA->PUPDR & ~GPIO_PUPDR_PUPD3) | GPIO_PUPDR_PUPD3_0;
+    GPIOA->MODER = (GPIOA->MODER & ~(GPIO_MODER_MODE2 | GPIO_MODER_MODE3)) | GPIO_MODER_MODE2_1 | GPIO_MODER_MODE3_1;
+
+    // USART2 receive requests to DMA1 channel 1
+    DMAMUX1_Channel0->CCR = RECOVERY_DMA_REQUEST;
+    DMA1_Channel1->CPAR = (uint32_t) &USART2->RDR;
+    recovery_start(buffer);
+
+    // USART2 8N1, received bytes moved to the buffer by DMA (overrun detection disabled so a late byte never stops reception)
+    USART2->BRR = (RECOVERY_CLOCK_HZ + RECOVERY_BAUD_RATE/2)/RECOVERY_BAUD_RATE;
+    USART2->CR3 = USART_CR3_DMAR | USART_CR3_OVRDIS;
+    USART2->CR1 = USART_CR1_TE | USART_CR1_RE | USART_CR1_UE;
+
+    // SysTick millisecond timer (polled, no interrupt)
+    SysTick->LOAD = RECOVERY_CLOCK_HZ/1000 - 1;
+    SysTick->VAL = 0;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+}
+
+void recovery_start(uint8_t *buffer){ // Restart DMA reception at the start of buffer
+    DMA1_Channel1->CCR = 0; // Disable the channel to reload it
+    DMA1_Channel1->CMAR = (uint32_t) buffer;
+    DMA1_Channel1->CNDTR = RECOVERY_BUFFER_SIZE;
+    DMA1_Channel1->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_EN; // Peripheral to memory, bytes, wrapping to the start of the buffer at the end
+}
+
+uint32_t recovery_head(){ // Offset in the receive buffer of the next byte DMA will write
+    return (RECOVERY_BUFFER_SIZE - DMA1_Channel1->CNDTR) % RECOVERY_BUFFER_SIZE;
+}
+
+uint8_t recovery_tick(){ // Check whether a millisecond has passed since the last check (at least one SysTick period)
+    return (SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0; // Flag cleared by reading
+}
+
+void recovery_drain(){ // Discard received data until the line has been idle for RECOVERY_TIMEOUT_MS
+    uint32_t head = recovery_head();
+    uint32_t idle = 0;
+    while (idle < RECOVERY_TIMEOUT_MS) {
+        resetWatchdog();
+        uint32_t current = recovery_head();
+        if (current != head) {
+            head = current;
+            idle = 0;
+        } else if (recovery_tick()) {
+            idle++;
+        }
+    }
+}
+
+void recovery_transmit(uint8_t byte){ // Send a byte to the host
+    while (!(USART2->ISR & USART_ISR_TXE_TXFNF)) {}
+    USART2->TDR = byte;
+}
+
+BootloaderStatus_T recovery_receive(RecoveryTransfer_T *transfer, const uint8_t *data, uint32_t length){ // Process received upload data (header, then application data written as it arrives)
+    BootloaderStatus_T status = BL_OK;
+    while (length && status == BL_OK && !recovery_isComplete(transfer)) {
+        if (transfer->received < sizeof(RecoveryHeader_T)) { // Collect the header
+            ((uint8_t *) &transfer->header)[transfer->received++] = *data++;
+            length--;
+            if (transfer->received == sizeof(RecoveryHeader_T)) {status = recovery_open(transfer);}
+            continue;
+        }
+
+        uint32_t remaining = sizeof(RecoveryHeader_T) + transfer->header.length - transfer->received;
+        uint32_t chunk = (length < remaining) ? length : remaining;
+        if (transfer->header.format == RECOVERY_FORMAT_COMPRESSED) {
+            status = compressedImage_push(&transfer->image, data, chunk);
+        } else {
+            status = appWriter_push(&transfer->writer, data, chunk);
+        }
+        data += chunk;
+        length -= chunk;
+        transfer->received += chunk;
+    }
+    return status;
+}
+
+BootloaderStatus_T recovery_open(RecoveryTransfer_T *transfer){ // Check a received upload header and start writing its application space (flash unlocked)
+    RecoveryHeader_T *header = &transfer->header;
+    if (header->magic != RECOVERY_MAGIC) {return BL_ERROR;}
+    if (calculateChecksum(header, offsetof(RecoveryHeader_T, headerChecksum)) != header->headerChecksum) {return BL_ERROR_CHECKSUM;} // Corrupt header
+    if (!IS_APP_SLOT(header->app) || header->info.size > APP_SLOT_LENGTH(header->app)) {return BL_ERROR_OUT_OF_RANGE;}
+    if (header->format == RECOVERY_FORMAT_BINARY && header->length != header->info.size) {return BL_ERROR;}
+    if (header->format != RECOVERY_FORMAT_BINARY && header->format != RECOVERY_FORMAT_COMPRESSED) {return BL_ERROR;}
+
+    enableProgrammingMode();
+    if (header->format == RECOVERY_FORMAT_COMPRESSED) {
+        return compressedImage_open(&transfer->image, header->app);
+    }
+    return appWriter_openErase(&transfer->writer, header->app, 0); // Pages erased as they are written (blank pages skipped)
+}
+
+BootloaderStatus_T recovery_finish(RecoveryTransfer_T *transfer){ // Finish an upload, check the application written against its info and write the info (flash unlocked)
+    RecoveryHeader_T *header = &transfer->header;
+    BootloaderStatus_T status;
+    if (header->format == RECOVERY_FORMAT_COMPRESSED) {
+        status = compressedImage_close(&transfer->image);
+    } else {
+        status = appWriter_close(&transfer->writer);
+    }
+    if (status != BL_OK) {return status;}
+
+    // Check the application and vector table as written against the info (the checksums boot verification uses)
+    uint32_t writtenLength, writtenChecksum;
+    if (getWriteChecksum(header->app, &writtenLength, &writtenChecksum) != BL_OK || writtenLength != header->info.size || writtenChecksum != header->info.appChecksum) {
+        return BL_ERROR_CHECKSUM;
+    }
+    if (calculateChecksum((void *) APP_SLOT_START(header->app), VECTOR_TABLE_SIZE*4) != header->info.vectblChecksum) {
+        return BL_ERROR_CHECKSUM;
+    }
+    return app_writeInfo(header->app, header->info);
+}
+
+uint8_t recovery_isComplete(RecoveryTransfer_T *transfer){ // Check whether all data of an upload has been received
+    return transfer->received >= sizeof(RecoveryHeader_T) && transfer->received == sizeof(RecoveryHeader_T) + transfer->header.length;
+}
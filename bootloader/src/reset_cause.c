@@ -0,0 +1,143 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Reset cause (implementation)
+Reset cause decoder, hard fault breadcrumb, per-application reset counts and the fault policy
+*/
+
+/* DEPENDENCIES */
+#include <stddef.h>                 // NULL
+#include "reset_cause.h"
+
+/* CONSTANT DEFINITIONS AND MACROS */
+
+
+/* GLOBAL VARIABLES */
+uint8_t appSelection __attribute__((section(".sram_bl_static"))); // App selection in special section
+ResetRecord_T resetRecord __attribute__((section(".sram_bl_static"))); // Reset record (bootloader static SRAM, not cleared at boot)
+
+/* FUNCTIONS */
+
+ResetInfo_T resetCause_decode(){ // Decode the cause of the last reset from the RCC reset flags and the hard fault breadcrumb, record it for getResetInfo and clear the flags
+    // Flags are cleared at every boot, so only the flag of the last reset is set (with PINRSTF, internal resets also drive NRST)
+    uint32_t flags = RCC->CSR;
+    ResetCause_T cause;
+    if (flags & RCC_CSR_PWRRSTF) { // SRAM lost, checked first
+        cause = RESET_CAUSE_POWER;
+    } else if (flags & RCC_CSR_LPWRRSTF) {
+        cause = RESET_CAUSE_LOWPOWER;
+    } else if (flags & RCC_CSR_WWDGRSTF) {
+        cause = RESET_CAUSE_WWDG;
+    } else if (flags & RCC_CSR_IWDGRSTF) {
+        cause = RESET_CAUSE_IWDG;
+    } else if (flags & RCC_CSR_SFTRSTF) { // Software reset by the hard fault handler if it left a breadcrumb
+        cause = (resetRecord.magic == RESETCAUSE_FAULT_MAGIC) ? RESET_CAUSE_HARDFAULT : RESET_CAUSE_SOFTWARE;
+    } else if (flags & RCC_CSR_OBLRSTF) {
+        cause = RESET_CAUSE_OPTION_BYTES;
+    } else if (flags & RCC_CSR_PINRSTF) {
+        cause = RESET_CAUSE_PIN;
+    } else {
+        cause = RESET_CAUSE_UNKNOWN;
+    }
+    __HAL_RCC_CLEAR_RESET_FLAGS(); // Clear flags
+
+    // Record the reset for the application (replaces any breadcrumb)
+    resetRecord.magic = RESETCAUSE_INFO_MAGIC;
+    resetRecord.cause = cause;
+    resetRecord.app = (cause != RESET_CAUSE_POWER && IS_APP_SLOT(appSelection)) ? appSelection : 0;
+    if (cause != RESET_CAUSE_HARDFAULT) {resetRecord.faultAddress = 0;}
+
+    ResetInfo_T info = {resetRecord.cause, resetRecord.app, resetRecord.faultAddress};
+    return info;
+}
+
+uint8_t resetCause_isCounted(ResetCause_T cause){ // Check whether resets of a cause are counted against the application that was running (FAULT_POLICY_COUNTED)
+    return cause < RESET_CAUSES && (FAULT_POLICY(cause) & FAULT_POLICY_COUNTED);
+}
+
+uint8_t resetCause_readCounts(ResetCounts_T *counts){ // Read the reset counts and fault policy from the bootloader data journal (1 if found, 0 and the defaults if none were written)
+    fillBytes(counts, 0, sizeof(ResetCounts_T));
+    counts->faultPolicy = FAULT_POLICY_DEFAULT;
+    uint8_t page;
+    int32_t offset = findBootloaderEntry(BL_RESETS_TAG, &page);
+    if (offset < 0) {return 0;}
+    BootloaderEntryHeader_T *header = (BootloaderEntryHeader_T *)(BL_DATA_PAGE_ADDRESS(page) + offset);
+    copyBytes(counts, (uint8_t *) header + sizeof(BootloaderEntryHeader_T), (header->length < sizeof(ResetCounts_T)) ? header->length : sizeof(ResetCounts_T)); // Counts of causes added since it was written stay zero
+    return 1;
+}
+
+uint8_t resetCause_count(uint8_t app, ResetCause_T cause){ // Count a reset against an application (flash unlocked), 1 if the fault policy counts it as an application fault
+    if (!IS_APP_SLOT(app) || !resetCause_isCounted(cause)) {return 0;}
+    ResetCounts_T counts;
+    resetCause_readCounts(&counts);
+    if (counts.count[app - 1][cause] < 0xFF) {
+        counts.count[app - 1][cause]++;
+        appendBootloaderEntry(BL_RESETS_TAG, &counts, sizeof(ResetCounts_T)); // Best effort, the fault is still counted
+    }
+    return (counts.faultPolicy & FAULT_POLICY(cause)) != 0;
+}
+
+void resetCause_recordHardFault(uint32_t faultAddress){ // Leave a hard fault breadcrumb for the next boot and reset (does not return)
+    resetRecord.magic = RESETCAUSE_FAULT_MAGIC;
+    resetRecord.cause = RESET_CAUSE_HARDFAULT;
+    resetRecord.app = appSelection;
+    resetRecord.faultAddress = faultAddress;
+    NVIC_SystemReset(); // The boot decodes the software reset as a hard fault
+}
+
+#ifndef HOST_SIM // The host simulator provides its own hardFaultHandler
+__attribute__((naked)) void hardFaultHandler(){ // Hard fault handler (finds the stacked PC, moves the stack to the top of SRAM and records the hard fault)
+    __ASM("movs r1, #4"); // EXC_RETURN bit 2 set if the exception frame is on the process stack
+    __ASM("mov r2, lr");
+    __ASM("tst r1, r2");
+    __ASM("beq 1f");
+    __ASM("mrs r0, psp");
+    __ASM("b 2f");
+    __ASM("1: mrs r0, msp");
+    __ASM("2: ldr r0, [r0, #24]"); // Stacked PC (first argument)
+    __ASM("ldr r1, =__SRAM_START"); // Stack moved to the top of SRAM (the fault may be a stack overflow, the application is reset anyway)
+    __ASM("ldr r2, =__SRAM_LEN");
+    __ASM("adds r1, r1, r2");
+    __ASM("msr msp, r1");
+    __ASM("ldr r2, =resetCause_recordHardFault");
+    __ASM("bx r2");
+    __ASM(".ltorg");
+}
+#endif
+
+BootloaderStatus_T getResetInfo(ResetInfo_T *info){ // Get the cause of the last reset
+    if (info == NULL) {return BL_ERROR;}
+    if (resetRecord.magic != RESETCAUSE_INFO_MAGIC) {return BL_ERROR;} // Not decoded (a hard fault breadcrumb is waiting for the next boot)
+    info->cause = resetRecord.cause;
+    info->app = resetRecord.app;
+    info->faultAddress = resetRecord.faultAddress;
+    return BL_OK;
+}
+
+uint8_t app_getResetCount(uint8_t app, ResetCause_T cause){ // Get the number of resets of a cause while an application was running
+    if (!IS_APP_SLOT(app) || cause >= RESET_CAUSES) {return 0;}
+    ResetCounts_T counts;
+    resetCause_readCounts(&counts);
+    return counts.count[app - 1][cause];
+}
+
+uint16_t getFaultPolicy(){ // Get the reset causes counted as application faults
+    ResetCounts_T counts;
+    resetCause_readCounts(&counts);
+    return counts.faultPolicy;
+}
+
+BootloaderStatus_T setFaultPolicy(uint16_t policy){ // Set the reset causes counted as application faults
+    if (policy & ~FAULT_POLICY_COUNTED) {return BL_ERROR_OUT_OF_RANGE;} // Power-on and pin resets are never counted
+    ResetCounts_T counts;
+    resetCause_readCounts(&counts);
+    if (counts.faultPolicy == policy) {return BL_OK;}
+    counts.faultPolicy = policy;
+
+    HAL_FLASH_Unlock(); // Unlock flash control
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS); // Clear flash flags
+    BootloaderStatus_T status = appendBootloaderEntry(BL_RESETS_TAG, &counts, sizeof(ResetCounts_T));
+    HAL_FLASH_Lock(); // Lock flash control
+    return status;
+}
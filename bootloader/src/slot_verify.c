@@ -0,0 +1,90 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Slot verification (implementation)
+Background verification of an application space from the running application, a bounded number of bytes per step, with the result recorded for the next boot
+*/
+
+/* DEPENDENCIES */
+#include <stddef.h>                 // NULL
+#include "slot_verify.h"
+#include "async_writer.h"           // Asynchronous writer (uses the CRC unit from the flash interrupt)
+#include "metadata_transaction.h"   // Metadata transactions
+
+/* CONSTANT DEFINITIONS AND MACROS */
+
+
+/* GLOBAL VARIABLES */
+
+
+/* FUNCTIONS */
+
+BootloaderStatus_T slotVerify_begin(SlotVerifier_T *verifier, uint8_t app, const BootloaderData_T *bootloaderData){ // Start a verification pass over an application space (BL_ERROR if it holds no application or its info is corrupt)
+    const AppData_T *appData = &bootloaderData->app[app - 1];
+    verifier->state = SLOT_VERIFY_IDLE;
+    verifier->app = app;
+    if (calculateChecksum((void *) &appData->info, sizeof(AppInfo_T)) != appData->infoChecksum) {return BL_ERROR;} // No application installed, or its info is corrupt (nothing to check against)
+    if (appData->info.size == 0 || appData->info.size > APP_SLOT_LENGTH(app)) {return BL_ERROR;}
+
+    verifier->address = 0;
+    verifier->size = appData->info.size;
+    verifier->appChecksum = appData->info.appChecksum;
+    verifier->generation = bootloaderData->generation[app - 1];
+    verifier->epoch = verificationEpoch[app - 1];
+    verifier->checksum = 0;
+    verifier->valid = 0;
+    verifier->state = SLOT_VERIFY_CHECKING;
+    return BL_OK;
+}
+
+uint8_t slotVerify_isCurrent(SlotVerifier_T *verifier, const BootloaderData_T *bootloaderData){ // Check that the application space and its info have not changed since the pass started
+    uint8_t app = verifier->app;
+    if (verificationEpoch[app - 1] != verifier->epoch) {return 0;} // Erased or written since
+    return bootloaderData->generation[app - 1] == verifier->generation && bootloaderData->app[app - 1].info.appChecksum == verifier->appChecksum; // Same application info
+}
+
+BootloaderStatus_T slotVerify_record(SlotVerifier_T *verifier){ // Record the result of a finished pass in bootloader data (BL_BUSY while a metadata transaction is open, or if the application changed during the pass, which then starts again)
+    if (metadataTransaction.open) {return BL_BUSY;} // The commit would write the transaction's copy of the record over it
+    if (!slotVerify_isCurrent(verifier, readBootloaderData())) { // The result is for an application that is no longer there, and must not overwrite its invalidation
+        verifier->state = SLOT_VERIFY_IDLE;
+        return BL_BUSY;
+    }
+    VerificationRecord_T record = {verifier->generation, verifier->appChecksum};
+
+    HAL_FLASH_Unlock(); // Unlock flash control
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS); // Clear flash flags
+    BootloaderStatus_T status = recordVerification(verifier->app, record, verifier->valid);
+    HAL_FLASH_Lock(); // Lock flash control
+    return status;
+}
+
+BootloaderStatus_T verifySlotStep(SlotVerifier_T *verifier, uint8_t app, uint32_t budget){ // Checksum up to budget bytes of an application (BL_BUSY until the pass ends, then BL_OK or BL_ERROR_CHECKSUM, recorded for the next boot)
+    if (verifier == NULL) {return BL_ERROR;}
+    if (!IS_APP_SLOT(app) || budget == 0) {return BL_ERROR_OUT_OF_RANGE;}
+    if (activeAsyncWriter != NULL) {return BL_BUSY;} // The flash interrupt uses the CRC unit until the writer finishes
+
+    const BootloaderData_T *bootloaderData = readBootloaderData(); // As written to flash (not an open transaction's changes)
+    if (verifier->app != app || verifier->state == SLOT_VERIFY_IDLE || verifier->state > SLOT_VERIFY_RECORDING || !slotVerify_isCurrent(verifier, bootloaderData)) { // New pass (another application space, the last pass ended, or the application was changed during this one)
+        BootloaderStatus_T status = slotVerify_begin(verifier, app, bootloaderData);
+        if (status != BL_OK) {return status;}
+    }
+
+    if (verifier->state == SLOT_VERIFY_CHECKING) {
+        if (budget >= 4) {budget &= ~3U;} // Whole words, so every step after the first starts word aligned
+        uint32_t length = verifier->size - verifier->address;
+        if (length > budget) {length = budget;}
+        verifier->checksum = accumulateChecksum(verifier->checksum, (void *)(APP_SLOT_START(app) + verifier->address), length);
+        verifier->address += length;
+        if (verifier->address < verifier->size) {return BL_BUSY;}
+
+        verifier->valid = (verifier->checksum == verifier->appChecksum);
+        verifier->state = SLOT_VERIFY_RECORDING;
+        return BL_BUSY; // Recorded by the next step, so no step both checksums and writes flash
+    }
+
+    BootloaderStatus_T status = slotVerify_record(verifier);
+    if (status != BL_OK) {return status;} // Still recording (or starting again), the next step tries again
+    verifier->state = SLOT_VERIFY_IDLE; // The next step starts a new pass
+    return verifier->valid ? BL_OK : BL_ERROR_CHECKSUM;
+}
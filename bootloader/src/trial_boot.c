@@ -0,0 +1,105 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Trial boot (implementation)
+Trial boots of updated applications, rolled back unless the application confirms itself
+*/
+
+/* DEPENDENCIES */
+#include <stddef.h>                 // NULL
+#include "trial_boot.h"
+#include "reset_cause.h"            // Application selection
+
+/* CONSTANT DEFINITIONS AND MACROS */
+
+
+/* GLOBAL VARIABLES */
+
+
+/* FUNCTIONS */
+
+uint8_t trialBoot_read(TrialInfo_T *trial){ // Read the trial boot state from the bootloader data journal (1 if found, 0 and trial boots off if none was written)
+    trial->trialBoots = 0;
+    trial->app = 0;
+    trial->attempts = 0;
+    trial->fallbackPriority = BOOTPRIO_AUTOMATIC;
+    uint8_t page;
+    int32_t offset = findBootloaderEntry(BL_TRIAL_TAG, &page);
+    if (offset < 0) {return 0;}
+    BootloaderEntryHeader_T *header = (BootloaderEntryHeader_T *)(BL_DATA_PAGE_ADDRESS(page) + offset);
+    copyBytes(trial, (uint8_t *) header + sizeof(BootloaderEntryHeader_T), (header->length < sizeof(TrialInfo_T)) ? header->length : sizeof(TrialInfo_T));
+    return 1;
+}
+
+uint8_t trialBoot_isOnTrial(const TrialInfo_T *trial, uint8_t app){ // Check whether an application is on trial (installed since trial boots were turned on and not yet confirmed)
+    return trial->trialBoots != 0 && IS_APP_SLOT(app) && trial->app == app;
+}
+
+uint8_t trialBoot_isExpired(const TrialInfo_T *trial){ // Check whether the application on trial has used all its trial boots without being confirmed
+    return trialBoot_isOnTrial(trial, trial->app) && trial->attempts >= trial->trialBoots;
+}
+
+BootloaderStatus_T trialBoot_begin(uint8_t app, BootPriority_T fallbackPriority){ // Put a newly installed application on trial if trial boots are on (flash unlocked)
+    TrialInfo_T trial;
+    trialBoot_read(&trial);
+    if (trial.trialBoots == 0) {return BL_OK;} // Trial boots off
+    trial.app = app; // Replaces any trial in progress
+    trial.attempts = 0;
+    trial.fallbackPriority = fallbackPriority;
+    return appendBootloaderEntry(BL_TRIAL_TAG, &trial, sizeof(TrialInfo_T));
+}
+
+BootloaderStatus_T trialBoot_countBoot(TrialInfo_T *trial){ // Use one of the trial boots of the application on trial (flash unlocked)
+    if (trial->attempts < 0xFF) {trial->attempts++;}
+    return appendBootloaderEntry(BL_TRIAL_TAG, trial, sizeof(TrialInfo_T)); // Written before the application starts, so a reset at any point uses the trial boot
+}
+
+BootloaderStatus_T trialBoot_rollBack(TrialInfo_T *trial, BootloaderData_T *bootloaderData){ // Restore the boot priority from before the update on trial and exclude it like a faulty application (flash unlocked)
+    AppData_T *appData = &bootloaderData->app[trial->app - 1];
+    bootloaderData->bootPriority = trial->fallbackPriority;
+    if (appData->faultCount < FAULT_THRESHOLD) {appData->faultCount = FAULT_THRESHOLD;} // Not started again until its fault count is reset or it is reinstalled
+    BootloaderStatus_T status = appendBootloaderData(bootloaderData); // Written before the trial ends, so a power cut in between rolls back again
+    if (status != BL_OK) {return status;}
+
+    trial->app = 0;
+    trial->attempts = 0;
+    return appendBootloaderEntry(BL_TRIAL_TAG, trial, sizeof(TrialInfo_T));
+}
+
+BootloaderStatus_T confirmImage(){ // Confirm the running application (ends its trial)
+    TrialInfo_T trial;
+    trialBoot_read(&trial);
+    if (!trialBoot_isOnTrial(&trial, appSelection)) {return BL_OK;} // Not on trial (already confirmed, or installed while trial boots were off)
+    trial.app = 0;
+    trial.attempts = 0;
+
+    HAL_FLASH_Unlock(); // Unlock flash control
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS); // Clear flash flags
+    BootloaderStatus_T status = appendBootloaderEntry(BL_TRIAL_TAG, &trial, sizeof(TrialInfo_T));
+    HAL_FLASH_Lock(); // Lock flash control
+    return status;
+}
+
+BootloaderStatus_T getTrialInfo(TrialInfo_T *info){ // Get the trial boot setting and the application on trial
+    if (info == NULL) {return BL_ERROR;}
+    trialBoot_read(info);
+    return BL_OK;
+}
+
+BootloaderStatus_T setTrialBoots(uint8_t boots){ // Set the trial boots given to each update (0 for off, which also ends any trial)
+    TrialInfo_T trial;
+    trialBoot_read(&trial);
+    if (trial.trialBoots == boots) {return BL_OK;}
+    trial.trialBoots = boots;
+    if (boots == 0) {
+        trial.app = 0;
+        trial.attempts = 0;
+    }
+
+    HAL_FLASH_Unlock(); // Unlock flash control
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS); // Clear flash flags
+    BootloaderStatus_T status = appendBootloaderEntry(BL_TRIAL_TAG, &trial, sizeof(TrialInfo_T));
+    HAL_FLASH_Lock(); // Lock flash control
+    return status;
+}
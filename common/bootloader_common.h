@@ -17,6 +17,24 @@ Bootloader content accessible to applications
 #include "memory_map.h"             // Device memory map
 
 /* CONSTANT DEFINITIONS AND MACROS */
+#define BOOTLOADER_INTERFACE_VERSION 0x00000002 // Bootloader version this header describes (2: SRAM_BL_STATIC at 0x20007F00, 54K application space 2, dispatch table entries after app2_writeInfo), check getBootloaderVersion() is at least this before using anything version 1 did not have
+#define BL_WRITER_ROW_SIZE 256 // Streaming writer row size (bytes) (STM32G0 fast programming row, 32 double-words)
+#define BL_CRC_DMA_CHANNEL 2 // DMA1 channel reserved for bootloader checksums when built with CRC_BACKEND=DMA (taken for the length of each call that checksums, verifySlotStep and the writers included, applications leave it disabled, a channel found enabled is left alone and the CPU feeds the CRC unit)
+#define BL_EXTENSIONS_VERSION 1 // Dispatch table extensions version this header describes (1: setFlashRam)
+#define BL_FLASH_RAM_CODE_SIZE 512 // Space for the RAM copy of the bootloader flash routines (bytes)
+#define DELTA_PATCH_MAGIC 0x50444C42 // Delta update patch header magic number ("BLDP")
+#define DELTA_OP_END 0x00 // Delta update patch operation: end of patch
+#define DELTA_OP_COPY 0x01 // Delta update patch operation: copy bytes from the old application (length, then offset from the end of the previous copy, variable-length)
+#define DELTA_OP_INSERT 0x02 // Delta update patch operation: insert bytes from the patch (length, variable-length, then the bytes)
+#define COMPRESSED_IMAGE_MAGIC 0x5A444C42 // Compressed update image header magic number ("BLDZ")
+#define COMPRESSED_MIN_MATCH 4 // Shortest match in a compressed update image (match length field 0)
+#define FAULT_POLICY(cause) (1U << (cause)) // Fault policy bit of a reset cause (resets of the causes in the policy are counted as application faults)
+#define FAULT_POLICY_COUNTED (FAULT_POLICY(RESET_CAUSE_SOFTWARE) | FAULT_POLICY(RESET_CAUSE_HARDFAULT) | FAULT_POLICY(RESET_CAUSE_IWDG) | FAULT_POLICY(RESET_CAUSE_WWDG) | FAULT_POLICY(RESET_CAUSE_LOWPOWER) | FAULT_POLICY(RESET_CAUSE_OPTION_BYTES) | FAULT_POLICY(RESET_CAUSE_UNKNOWN)) // Reset causes counted against the application that was running (power-on and pin resets are not caused by the application)
+#define FAULT_POLICY_DEFAULT (FAULT_POLICY(RESET_CAUSE_HARDFAULT) | FAULT_POLICY(RESET_CAUSE_IWDG) | FAULT_POLICY(RESET_CAUSE_WWDG)) // Fault policy until one is set (hard faults and watchdog resets)
+#define _BOOTLOADER_HARDFAULT_HANDLER_OFFSET 204 // Offset of hardFaultHandler in the dispatch table (entry 51, the application's naked HardFault_Handler finds it without C, see README)
+#define _BOOTLOADER_STRING(x) #x
+#define _BOOTLOADER_MACRO_STRING(x) _BOOTLOADER_STRING(x) // Value of a macro as a string literal (to use it as an assembler immediate)
+#define _BOOTLOADER_FUNCTION_ENTRIES 64 // Entries the dispatch table can hold (0x100 bytes at the end of the bootloader core, the table is full, later functions are added to struct BootloaderExtensions)
 #define _BOOTLOADER_FUNCTIONS (struct BootloaderFunctions *) ((uint32_t) &__FLASH_BL_CORE_START + (uint32_t) &__FLASH_BL_CORE_LEN - 0x100) // Paste "struct BootloaderFunctions *bootloader = _BOOTLOADER_FUNCTIONS;" into main() or wherever needed
 
 /* TYPE DEFINITIONS AND ENUMERATIONS */
@@ -28,13 +46,15 @@ typedef enum { // Bootloader function status return type
     BL_ERROR_HAL,                           // STM32 HAL returned an error
     BL_ERROR_WRITE_VERIFICATION,            // Data write verification failed
     BL_ERROR_DATA_ALIGNMENT,                // Data/address alignment is not correct
-    BL_ERROR_OUT_OF_RANGE                   // Value/address out of permitted range
+    BL_ERROR_OUT_OF_RANGE,                  // Value/address out of permitted range
+    BL_ERROR_CHECKSUM,                      // Checksum does not match the data written
+    BL_BUSY                                 // Operation still in progress, or no room for the data yet (try again later)
 } BootloaderStatus_T;
 
 typedef enum __attribute__((__packed__)) { // Boot priority enum type
     BOOTPRIO_AUTOMATIC,                     // Choose application automatically based on ID and version
     BOOTPRIO_APP1,                          // Priority application 1
-    BOOTPRIO_APP2                           // Priority application 2
+    BOOTPRIO_APP2                           // Priority application 2 (BOOTPRIO_APP1 + n - 1 for application n)
 } BootPriority_T;
 
 typedef enum __attribute__((__packed__)) { // Application verification mode enum type
@@ -52,6 +72,157 @@ typedef enum __attribute__((__packed__)) { // Watchdog mode enum type
     WATCHDOG_SHORT                          // Watchdog on with short timer
 } WatchdogMode_T;
 
+typedef enum __attribute__((__packed__)) { // Fast boot mode enum type
+    FASTBOOT_OFF,                           // Every boot selects and verifies an application
+    FASTBOOT_ON                             // Power-on and pin resets start the application the last boot selected (verified and without faults) after checking only its vector table SP/PC
+} FastBootMode_T;
+
+typedef enum __attribute__((__packed__)) { // Reset cause enum type (decoded by the bootloader from the RCC reset flags and the hard fault breadcrumb)
+    RESET_CAUSE_POWER,                      // Power-on or brown-out reset (SRAM lost, not attributed to an application)
+    RESET_CAUSE_PIN,                        // NRST pin reset
+    RESET_CAUSE_SOFTWARE,                   // Software reset (NVIC_SystemReset) without a hard fault breadcrumb
+    RESET_CAUSE_HARDFAULT,                  // Hard fault (software reset by the bootloader hard fault handler)
+    RESET_CAUSE_IWDG,                       // Independent watchdog reset
+    RESET_CAUSE_WWDG,                       // Window watchdog reset
+    RESET_CAUSE_LOWPOWER,                   // Illegal Stop, Standby or Shutdown mode entry
+    RESET_CAUSE_OPTION_BYTES,               // Option byte loading
+    RESET_CAUSE_UNKNOWN,                    // No reset flag set (debugger or lockup)
+    RESET_CAUSES                            // Number of reset causes
+} ResetCause_T;
+
+typedef struct { // Cause of the last reset (decoded at boot, the RCC reset flags are cleared by the bootloader)
+    ResetCause_T cause;                     // Reset cause
+    uint8_t app;                            // Application space that was running when the reset happened (0 if not known, or after a power-on reset)
+    uint32_t faultAddress;                  // Address of the instruction that hard faulted (stacked PC, 0 for other causes)
+} ResetInfo_T;
+
+typedef struct { // Trial boot state (an update gets trialBoots boots to call confirmImage, or the bootloader rolls it back)
+    uint8_t trialBoots;                     // Trial boots given to each update (0 if trial boots are off)
+    uint8_t app;                            // Application space on trial (0 if none, or confirmed)
+    uint8_t attempts;                       // Trial boots used without the application being confirmed
+    BootPriority_T fallbackPriority;        // Boot priority restored if the update is rolled back (the boot priority when it was installed)
+} TrialInfo_T;
+
+typedef struct { // Read-only view of bootloader data (pointers into the current bootloader data record in flash, valid until bootloader data is next written)
+    const uint32_t *version;                // Bootloader version number
+    const BootPriority_T *bootPriority;     // Boot priority
+    const VerificationMode_T *verificationMode; // Verification mode
+    const WatchdogMode_T *watchdogMode;     // Watchdog mode
+    const FastBootMode_T *fastBootMode;     // Fast boot mode (as stored, anything other than FASTBOOT_ON is off)
+    const AppInfo_T *appInfo[BL_APP_SLOTS]; // Application info (application space n at index n - 1)
+    const uint8_t *faultCount[BL_APP_SLOTS]; // Application fault counts (application space n at index n - 1)
+} BootloaderView_T;
+
+typedef struct { // Boot and update statistics (kept in bootloader static SRAM across warm resets, persisted to the bootloader data journal in batches) (cycles are TIM2 kernel clock cycles, SYSCLK while the bootloader runs, totals wrap around)
+    uint32_t boots;                         // Boots counted (full and fast boots)
+    uint32_t bootCycles;                    // Last boot, bootloader start to application jump (or recovery mode)
+    uint32_t verifyCycles[BL_APP_SLOTS];    // Last boot, time spent verifying each application (0 if not verified) (application space n at index n - 1)
+    uint32_t erasePages;                    // Application pages erased (pages already blank are skipped and not counted)
+    uint32_t eraseCycles;                   // Time spent erasing application pages (erases made while TIM2 is in use by the application are not timed)
+    uint32_t programBytes;                  // Application bytes programmed
+    uint32_t programCycles;                 // Time spent programming and verifying application data (not timed while TIM2 is in use by the application, or by the asynchronous writer)
+    uint16_t verifyFailures;                // Applications that failed verification at boot
+    uint16_t writeFailures;                 // Application erases and writes that failed (flash error or write verification)
+} BootStats_T;
+
+typedef struct { // Streaming application writer (allocated by the application, the bootloader has no RAM to spare for the row buffer)
+    uint64_t row[BL_WRITER_ROW_SIZE/8];     // Row staging buffer (bytes not written are left erased, 0xFF)
+    uint32_t base;                          // Application space start address
+    uint32_t length;                        // Application space length (bytes)
+    uint32_t stagedAddress;                 // Offset of the first staged byte in the application space (equal to address if nothing is staged)
+    uint32_t address;                       // Offset of the next byte to write in the application space
+    uint32_t erasedAddress;                 // Offset of the first page not yet erased by the writer (lazy erase, application space length otherwise)
+    uint8_t app;                            // Application space (numbered from 1)
+    uint8_t open;                           // Writer is open
+} AppWriter_T;
+
+typedef struct AsyncWriter { // Asynchronous application writer (allocated by the application with its ring buffer, programmed from the flash interrupt while the application carries on)
+    uint8_t *buffer;                        // Ring buffer of data waiting to be programmed (a multiple of 8 bytes)
+    uint32_t bufferSize;                    // Ring buffer size (bytes)
+    uint32_t base;                          // Application space start address
+    uint32_t length;                        // Application space length (bytes)
+    uint32_t origin;                        // Offset in the application space held at the start of the ring buffer (double-word aligned)
+    volatile uint32_t address;              // Offset after the last byte queued in the application space
+    volatile uint32_t programmedAddress;    // Offset after the last byte programmed and verified (ring buffer space before it is free)
+    volatile uint32_t operationAddress;     // Offset after the last byte of the program operation in progress
+    volatile uint32_t erasedAddress;        // Offset of the first page not yet erased by the writer (pages erased just before their first write)
+    uint64_t tail;                          // Double-word being programmed (the last one padded with erased bytes)
+    void (*callback)(struct AsyncWriter *writer); // Called from the flash interrupt when the writer finishes or fails (NULL for none)
+    volatile BootloaderStatus_T status;     // BL_BUSY while open, then BL_OK once closed and all data is programmed, or the error that stopped the writer
+    volatile uint8_t operation;             // Flash operation in progress (AsyncWriterOperation_T in async_writer.h)
+    volatile uint8_t complete;              // Flash operation in progress has ended (set by the end of operation callback)
+    volatile uint8_t closing;               // Close requested (remaining data is programmed, then the writer finishes)
+    uint8_t app;                            // Application space (numbered from 1)
+} AsyncWriter_T;
+
+typedef struct { // Delta update patch header (start of a patch made by make_delta_update.py, followed by the patch operations)
+    uint32_t magic;                         // Patch header magic number (DELTA_PATCH_MAGIC)
+    uint32_t oldSize;                       // Size of the application the patch applies to (bytes)
+    uint32_t oldChecksum;                   // CRC32 checksum of the application the patch applies to
+    uint32_t newSize;                       // Size of the patched application (bytes)
+    uint32_t newVectblChecksum;             // CRC32 checksum of the patched application vector table
+    uint32_t newChecksum;                   // CRC32 checksum of the patched application
+} DeltaPatchHeader_T;
+
+typedef struct { // Delta update patch applier (allocated by the application, holds the streaming writer to the application space being patched)
+    AppWriter_T writer;                     // Streaming writer to the application space being patched
+    DeltaPatchHeader_T header;              // Patch header (application info of the patched application)
+    uint32_t oldBase;                       // Start address of the application the patch applies to
+    uint32_t oldAddress;                    // Offset in the old application after the previous copy
+    uint32_t received;                      // Patch header bytes received
+    uint32_t length;                        // Length of the current operation (bytes left to insert)
+    uint32_t field;                         // Variable-length field being decoded
+    uint8_t shift;                          // Bits of the field decoded
+    uint8_t opcode;                         // Current operation
+    uint8_t oldApp;                         // Application space the patch applies to
+    uint8_t state;                          // Patch decoder state
+} DeltaPatch_T;
+
+typedef struct { // Compressed update image header (start of an image made by make_compressed_update.py, followed by LZ4-style sequences)
+    uint32_t magic;                         // Image header magic number (COMPRESSED_IMAGE_MAGIC)
+    uint32_t size;                          // Size of the application (bytes, decompressed)
+    uint32_t vectblChecksum;                // CRC32 checksum of the application vector table
+    uint32_t appChecksum;                   // CRC32 checksum of the application
+} CompressedImageHeader_T;
+
+typedef struct { // Compressed update image decompressor (allocated by the application, holds the streaming writer, earlier output is read back from the application space instead of a RAM window)
+    AppWriter_T writer;                     // Streaming writer to the application space being written
+    CompressedImageHeader_T header;         // Image header (application info of the application)
+    uint32_t received;                      // Image header bytes received
+    uint32_t length;                        // Length of the current literal run or match (bytes)
+    uint32_t offset;                        // Distance back to the current match (bytes)
+    uint8_t token;                          // Current sequence token (literal length, match length)
+    uint8_t state;                          // Decompressor state
+} CompressedImage_T;
+
+typedef struct { // Background application verifier (allocated by the application, zeroed before its first step, each verifySlotStep checksums the next part of an application space)
+    uint32_t address;                       // Offset of the next byte to checksum in the application space
+    uint32_t size;                          // Application size (bytes, from its info when the pass started)
+    uint32_t appChecksum;                   // Application CRC32 from its info when the pass started
+    uint32_t generation;                    // Application generation when the pass started (the pass starts again if it changes)
+    uint32_t epoch;                         // Changes to the application space since boot when the pass started (the pass starts again if it changes)
+    uint32_t checksum;                      // CRC32 of the bytes checked so far
+    uint8_t app;                            // Application space being verified (a step for another application space starts a new pass)
+    uint8_t state;                          // Verifier state (SlotVerifierState_T in slot_verify.h)
+    uint8_t valid;                          // Checksum matched (once the whole application has been checked)
+} SlotVerifier_T;
+
+typedef struct { // RAM flash routines (allocated by the application in SRAM, setFlashRam copies the bootloader flash routines into it and blocking erases and writes run from there)
+    uint32_t code[BL_FLASH_RAM_CODE_SIZE/4]; // Copy of the bootloader flash routines
+    uint32_t irqMask;                       // Interrupts left enabled during flash operations (bit n for IRQn n, their handlers and everything they use must be in RAM, the others are disabled and taken after each operation)
+    uint32_t operations;                    // Flash operations run from RAM (page erases, double-word and fast row programs)
+    uint32_t lastCycles;                    // Last operation, start to end (latency of interrupts handled from flash) (TIM2 kernel clock cycles, 0 if TIM2 was in use by the application)
+    uint32_t lastMaskedCycles;              // Last operation, time interrupts were masked (latency added to the RAM-resident interrupts, only fast row programs mask them)
+    uint32_t worstCycles;                   // Longest operation since setFlashRam
+    uint32_t worstMaskedCycles;             // Longest time interrupts were masked since setFlashRam (worst-case latency of the RAM-resident interrupts)
+    uint8_t fastRows;                       // Streaming writer rows are fast programmed (interrupts masked for the whole row), or programmed a double-word at a time with interrupts enabled
+} FlashRam_T;
+
+struct BootloaderExtensions { // Externally (application) accessible bootloader functions added once the dispatch table was full (entries are only ever appended)
+    uint32_t version;                                                                           // Extension table version (BL_EXTENSIONS_VERSION when built, an entry is there if the version that added it is at most this)
+    BootloaderStatus_T (*setFlashRam)(FlashRam_T *ram, uint32_t irqMask, uint8_t fastRows);    // Run blocking flash erases and writes from RAM routines copied into ram, with only the irqMask interrupts enabled (vector table in RAM, NULL to run them from flash again) (version 1)
+};
+
 struct BootloaderFunctions { // Externally (application) accessible bootloader functions
     uint32_t (*getVersion)(void);                                                               // Get the bootloader version number
     BootPriority_T (*getBootPriority)(void);                                                    // Get the current boot priority
@@ -75,6 +246,48 @@ struct BootloaderFunctions { // Externally (application) accessible bootloader f
     BootloaderStatus_T (*app2_erase)(void);                                                     // Erase application space 2
     BootloaderStatus_T (*app2_write)(uint32_t address, uint64_t *data, uint32_t length);        // Write data to application space 2
     BootloaderStatus_T (*app2_writeInfo)(AppInfo_T info);                                       // Write the app info for application 2
+    BootloaderStatus_T (*appWriter_open)(AppWriter_T *writer, uint8_t app, uint32_t address);   // Open a streaming writer to an application space at address (in programming mode, after erasing the application space)
+    BootloaderStatus_T (*appWriter_push)(AppWriter_T *writer, const void *data, uint32_t length); // Write data of any length and alignment through a streaming writer (programmed a row at a time)
+    BootloaderStatus_T (*appWriter_close)(AppWriter_T *writer);                                 // Write any remaining data and close a streaming writer
+    BootloaderStatus_T (*getWriteChecksum)(uint8_t app, uint32_t *length, uint32_t *checksum);  // Get the length and CRC32 of the data written to an application space since it was erased (BL_ERROR unless written in sequence from its start)
+    uint8_t (*app_getFaultCount)(uint8_t app);                                                  // Get the current fault count for an application
+    BootloaderStatus_T (*app_resetFaultCount)(uint8_t app);                                     // Reset the fault count for an application
+    AppInfo_T (*app_getInfo)(uint8_t app);                                                      // Get the app info for an application
+    BootloaderStatus_T (*app_erase)(uint8_t app);                                               // Erase an application space
+    BootloaderStatus_T (*app_write)(uint8_t app, uint32_t address, uint64_t *data, uint32_t length); // Write data to an application space
+    BootloaderStatus_T (*app_writeInfo)(uint8_t app, AppInfo_T info);                           // Write the app info for an application
+    BootloaderStatus_T (*app_eraseRange)(uint8_t app, uint32_t address, uint32_t length);       // Erase only the pages of an application space that hold length bytes from address (erase 0 to the size of a new application to install it)
+    BootloaderStatus_T (*appWriter_openErase)(AppWriter_T *writer, uint8_t app, uint32_t address); // Open a streaming writer that erases each page just before its first write (in programming mode, no need to erase the application space)
+    uint32_t (*getErasedPageCount)(void);                                                       // Get the number of pages erased by the last application erase or lazily erasing writer (pages already blank are skipped)
+    BootloaderStatus_T (*deltaPatch_open)(DeltaPatch_T *patch, uint8_t oldApp, uint8_t app);    // Start applying a delta update patch to the application in oldApp, writing the patched application to application space app (in programming mode)
+    BootloaderStatus_T (*deltaPatch_push)(DeltaPatch_T *patch, const void *data, uint32_t length); // Apply the next part of a delta update patch (any length)
+    BootloaderStatus_T (*deltaPatch_close)(DeltaPatch_T *patch);                                // Finish a delta update patch and check the patched application against the patch header (then write its info from patch->header)
+    BootloaderStatus_T (*compressedImage_open)(CompressedImage_T *image, uint8_t app);          // Start writing a compressed update image to an application space (in programming mode)
+    BootloaderStatus_T (*compressedImage_push)(CompressedImage_T *image, const void *data, uint32_t length); // Decompress and write the next part of a compressed update image (any length)
+    BootloaderStatus_T (*compressedImage_close)(CompressedImage_T *image);                      // Finish a compressed update image and check the application against the image header (then write its info from image->header)
+    BootloaderStatus_T (*asyncWriter_open)(AsyncWriter_T *writer, uint8_t app, uint32_t address, uint8_t *buffer, uint32_t size, void (*callback)(AsyncWriter_T *writer)); // Open an asynchronous writer to an application space at address with a ring buffer of size bytes (in programming mode, pages erased as they are written, the application's FLASH_IRQHandler must call asyncWriter_irqHandler)
+    BootloaderStatus_T (*asyncWriter_push)(AsyncWriter_T *writer, const void *data, uint32_t length); // Queue data of any length to be programmed in the background (BL_BUSY, and nothing queued, until the ring buffer has room for all of it)
+    uint32_t (*asyncWriter_getSpace)(AsyncWriter_T *writer);                                    // Get the number of bytes that can be queued now
+    BootloaderStatus_T (*asyncWriter_close)(AsyncWriter_T *writer);                             // Program any remaining data and finish (completes in the background, poll asyncWriter_getStatus or wait for the callback)
+    BootloaderStatus_T (*asyncWriter_getStatus)(AsyncWriter_T *writer);                         // Get the status of an asynchronous writer (BL_BUSY until it finishes or fails)
+    void (*asyncWriter_irqHandler)(void);                                                       // Flash interrupt handler for asynchronous writers (call from the application's FLASH_IRQHandler)
+    FastBootMode_T (*getFastBootMode)(void);                                                    // Get the current fast boot mode
+    BootloaderStatus_T (*setFastBootMode)(FastBootMode_T mode);                                 // Set the fast boot mode (takes effect from the boot after next, which records the application to fast boot)
+    BootloaderStatus_T (*getBootloaderView)(BootloaderView_T *view);                            // Point a read-only view at the current bootloader data in flash (no copies, get the view again after changing settings or installing an application)
+    BootloaderStatus_T (*getBootStats)(BootStats_T *stats);                                     // Get the boot and update statistics (counted since the device was first booted, including boots not yet persisted)
+    void (*hardFaultHandler)(void);                                                             // Hard fault handler (branch to it from the application's HardFault_Handler with the exception stack untouched, records a breadcrumb and resets)
+    BootloaderStatus_T (*getResetInfo)(ResetInfo_T *info);                                      // Get the cause of the last reset (the RCC reset flags are cleared by the bootloader)
+    uint8_t (*app_getResetCount)(uint8_t app, ResetCause_T cause);                              // Get the number of resets of a cause while an application was running (saturates at 255, power-on and pin resets are not counted)
+    uint16_t (*getFaultPolicy)(void);                                                           // Get the reset causes counted as application faults (FAULT_POLICY bits)
+    BootloaderStatus_T (*setFaultPolicy)(uint16_t policy);                                      // Set the reset causes counted as application faults (FAULT_POLICY bits of FAULT_POLICY_COUNTED causes)
+    BootloaderStatus_T (*confirmImage)(void);                                                   // Confirm the running application (ends its trial, call once it is known to work after an update)
+    BootloaderStatus_T (*getTrialInfo)(TrialInfo_T *info);                                      // Get the trial boot setting and the application on trial
+    BootloaderStatus_T (*setTrialBoots)(uint8_t boots);                                         // Set the trial boots given to each update (0 for off, which also ends any trial)
+    BootloaderStatus_T (*beginMetadataTransaction)(void);                                       // Begin a metadata transaction (setters and app_writeInfo change a RAM shadow of bootloader data, getters read it, until it is committed)
+    BootloaderStatus_T (*commitMetadataTransaction)(void);                                      // Write the changes made since beginMetadataTransaction as one bootloader data record (a reset before this discards them)
+    BootloaderStatus_T (*abortMetadataTransaction)(void);                                       // Discard the changes made since beginMetadataTransaction (nothing is written)
+    BootloaderStatus_T (*verifySlotStep)(SlotVerifier_T *verifier, uint8_t app, uint32_t budget); // Checksum up to budget bytes of an application (BL_BUSY until the pass ends, then BL_OK or BL_ERROR_CHECKSUM, recorded for the next boot)
+    const struct BootloaderExtensions *extensions;                                              // Functions added once this table was full (check extensions->version before using one)
 };
 
 /* GLOBAL VARIABLES */
@@ -15,7 +15,9 @@ C-accessible memory map from memory_map.ld symbols
 
 
 /* CONSTANT DEFINITIONS AND MACROS */
-
+#define BL_APP_SLOT_REGIONS(X) X(FLASH_APP1) X(FLASH_APP2) // Application space regions of memory_map.ld, in application space order (add a FLASH_APPn region and its symbols below to add an application space)
+#define _BL_APP_SLOT_COUNT(region) + 1
+#define BL_APP_SLOTS (0 BL_APP_SLOT_REGIONS(_BL_APP_SLOT_COUNT)) // Number of application spaces
 
 /* TYPE DEFINITIONS AND ENUMERATIONS */
 
@@ -29,6 +31,8 @@ extern int __FLASH_APP1_START;
 extern int __FLASH_APP1_LEN;
 extern int __FLASH_APP2_START;
 extern int __FLASH_APP2_LEN;
+extern int __FLASH_BL_DATA_B_START;
+extern int __FLASH_BL_DATA_B_LEN;
 extern int __SRAM_START;
 extern int __SRAM_LEN;
 extern int __SRAM_BL_STATIC_START;
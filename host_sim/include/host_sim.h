@@ -0,0 +1,215 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Host simulator (header)
+Simulated STM32G0 flash, CRC, IWDG and reset logic for running the bootloader on a host computer
+*/
+
+/* INCLUDE GUARD */
+#pragma once
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+/* DEPENDENCIES */
+#include <stdint.h>                 // Fixed width integer data types
+#include "stm32g0xx_hal.h"          // Simulated HAL
+#include "memory_map.h"             // Device memory map
+#include "bootloader_common.h"      // Bootloader content accessible to applications
+
+/* CONSTANT DEFINITIONS AND MACROS */
+// Cycle-cost model (bootloader runs from the 16MHz HSI, flash at 0 wait states)
+#define SIM_SYSCLK_HZ 16000000UL                // Simulated system clock frequency
+#define SIM_LSI_HZ 32000UL                      // Simulated LSI (IWDG) clock frequency
+#define SIM_CYCLES_FLASH_PROGRAM 1360UL         // Double-word program (85us typical)
+#define SIM_CYCLES_FLASH_FAST_ROW 27200UL       // Fast row program, 32 double-words (1.7ms typical)
+#define SIM_CYCLES_FLASH_ERASE 352000UL         // Page erase (22ms typical)
+#define SIM_CYCLES_FLASH_READ_WORD 4UL          // Flash word read and tested by the core (load, compare and branch at 0 wait states)
+#define SIM_CYCLES_CRC_BYTE 12UL                // CRC feed per byte, including the flash read (HAL byte loop)
+#define SIM_CYCLES_CRC_HALFWORD 12UL            // CRC feed per half-word, including the flash read
+#define SIM_CYCLES_CRC_WORD 12UL                // CRC feed per word, including the flash read
+#define SIM_CYCLES_CRC_INIT 40UL                // CRC peripheral initialisation
+#define SIM_CYCLES_CRC_DMA_WORD 4UL             // CRC feed per word by DMA (flash read and peripheral write on the bus, the CPU polls)
+#define SIM_CYCLES_CRC_SOFTWARE_WORD 28UL       // Slicing-by-4 software CRC per word (four table lookups from flash)
+#define SIM_CYCLES_CRC_SOFTWARE_BYTE 10UL       // Byte-at-a-time software CRC per byte
+#define SIM_CYCLES_IWDG_INIT 2500UL             // IWDG initialisation (waits on LSI-domain register updates)
+#define SIM_CYCLES_PERIPHERAL_ACCESS 8UL        // Polled USART, DMA or SysTick register access (including the polling loop)
+#define SIM_CYCLES_INTERRUPT 30UL               // Interrupt entry and return (exception stacking, unstacking and vector fetch)
+#define SIM_RECOVERY_HOST_LATENCY 16000UL       // Host turnaround for recovery transport replies (1ms, one USB frame of the ST-LINK virtual COM port)
+#define SIM_RECOVERY_WINDOW 2                   // Recovery upload blocks the host sends ahead of acknowledgements (the bootloader buffers two)
+#define SIM_OTA_RING_SIZE 2048                  // Asynchronous writer ring buffer of simulated over-the-air updates (bytes)
+
+#define SIM_CYCLES_TO_US(cycles) ((cycles)/(SIM_SYSCLK_HZ/1000000UL)) // Convert simulated cycles to microseconds
+
+#define SIM_STACK_SIZE (256*1024)               // Host stack used to run simulated code
+#define SIM_ARENA_SIZE (1024*1024)              // Low-memory arena for simulated application buffers
+
+#define SIM_BENCH_TOLERANCE 5                   // Benchmark regression tolerance (percent over baseline)
+
+/* TYPE DEFINITIONS AND ENUMERATIONS */
+
+typedef enum { // How a simulator run ended
+    SIM_EVENT_RETURNED,                         // Entry function returned
+    SIM_EVENT_APP_STARTED,                      // Bootloader jumped to an application
+    SIM_EVENT_STALLED,                          // Core stalled (waiting for an interrupt that will never come)
+    SIM_EVENT_WATCHDOG_RESET,                   // Independent watchdog expired
+    SIM_EVENT_POWER_LOST,                       // Power was cut during a flash operation (simFlashSetPowerCut)
+    SIM_EVENT_SOFTWARE_RESET                    // Software reset (NVIC_SystemReset, the device has been reset)
+} SimEvent_T;
+
+typedef enum { // Reset causes that can be applied to the simulated device
+    SIM_RESET_POWER,                            // Power-on/brown-out reset
+    SIM_RESET_PIN,                              // NRST pin reset
+    SIM_RESET_SOFTWARE,                         // NVIC_SystemReset
+    SIM_RESET_IWDG,                             // Independent watchdog reset
+    SIM_RESET_WWDG,                             // Window watchdog reset
+    SIM_RESET_LOWPOWER,                         // Illegal low-power mode entry
+    SIM_RESET_OPTION_BYTES                      // Option byte loading
+} SimResetCause_T;
+
+typedef struct { // Result of a simulator run
+    SimEvent_T event;                           // How the run ended
+    uint64_t cycles;                            // Simulated cycles spent in the run
+    uint32_t stackPointer;                      // Application stack pointer (SIM_EVENT_APP_STARTED)
+    uint32_t startupAddress;                    // Application startup address (SIM_EVENT_APP_STARTED)
+    uint32_t vectorTable;                       // VTOR at application start (SIM_EVENT_APP_STARTED)
+} SimResult_T;
+
+typedef struct { // Flash operation statistics
+    uint32_t pagesErased;                       // Pages erased
+    uint32_t doubleWordsProgrammed;             // Double-words programmed
+    uint32_t rowsFastProgrammed;                // Rows fast programmed
+    uint32_t errors;                            // Failed operations
+    uint32_t operations;                        // Program and erase operations started (a page erase, double-word or fast row each count as one)
+} SimFlashStats_T;
+
+typedef enum { // Steps of an application install
+    SIM_INSTALL_PROGRAMMING_MODE,               // Enable programming mode
+    SIM_INSTALL_ERASE,                          // Erase application space
+    SIM_INSTALL_WRITE,                          // Write application
+    SIM_INSTALL_WRITE_INFO,                     // Write application info
+    SIM_INSTALL_STEPS
+} SimInstallStep_T;
+
+typedef struct { // Result of an application install
+    SimEvent_T event;                           // How the install run ended
+    BootloaderStatus_T status;                  // Status of the last bootloader call
+    uint64_t cycles[SIM_INSTALL_STEPS];         // Simulated cycles spent in each step
+    uint64_t totalCycles;                       // Simulated cycles spent in the install
+    uint32_t erasedPages;                       // Application pages erased (getErasedPageCount, pages that were already blank are skipped)
+    FlashRam_T flashRam;                        // RAM flash routine timing (installs run with simAppSetFlashRam on, zero otherwise)
+} SimInstallResult_T;
+
+typedef struct { // Result of a recovery upload as seen by the host end of the recovery transport
+    uint8_t complete;                           // Upload status received
+    BootloaderStatus_T status;                  // Upload status sent by the bootloader
+    uint32_t sent;                              // Upload bytes received by the device
+    uint32_t acks;                              // Blocks acknowledged
+    uint64_t startCycles;                       // Cycle count at which the host saw the bootloader ready
+    uint64_t endCycles;                         // Cycle count at which the host received the status
+} SimRecoveryResult_T;
+
+typedef enum { // Bootloader settings that simulated applications can change
+    SIM_SETTING_PRIORITY,                       // Boot priority
+    SIM_SETTING_VERIFICATION,                   // Verification mode
+    SIM_SETTING_WATCHDOG,                       // Watchdog mode
+    SIM_SETTING_FASTBOOT,                       // Fast boot mode
+    SIM_SETTING_FAULT_POLICY,                   // Fault policy (FAULT_POLICY bits)
+    SIM_SETTING_TRIAL_BOOTS                     // Trial boots given to each update
+} SimSetting_T;
+
+typedef enum { // Metadata transaction actions of simulated applications
+    SIM_TRANSACTION_BEGIN,                      // beginMetadataTransaction
+    SIM_TRANSACTION_COMMIT,                     // commitMetadataTransaction
+    SIM_TRANSACTION_ABORT                       // abortMetadataTransaction
+} SimTransaction_T;
+
+typedef struct { // Bootloader settings and application info as seen by simulated applications
+    BootPriority_T priority;                    // Boot priority
+    VerificationMode_T verification;            // Verification mode
+    WatchdogMode_T watchdog;                    // Watchdog mode
+    FastBootMode_T fastBoot;                    // Fast boot mode
+    AppInfo_T appInfo[BL_APP_SLOTS];            // Application info (application space n at index n - 1)
+    uint8_t faultCount[BL_APP_SLOTS];           // Fault counts (application space n at index n - 1)
+} SimAppState_T;
+
+typedef struct { // Result of a background verification of an application space (verifySlotStep until the pass ends)
+    SimEvent_T event;                           // How the verification run ended
+    BootloaderStatus_T status;                  // Status of the last step
+    uint32_t steps;                             // Steps taken
+    uint64_t longestStep;                       // Simulated cycles of the longest step
+    uint64_t totalCycles;                       // Simulated cycles spent in all steps
+} SimVerifyResult_T;
+
+/* GLOBAL VARIABLES */
+extern struct BootloaderFunctions *simBootloader; // Bootloader dispatch table as seen by simulated applications
+extern uint32_t simFaultAddress; // Stacked PC the simulated hard fault handler finds (address of the faulting instruction)
+
+
+/* FUNCTIONS */
+
+// Simulator core (sim_core.c)
+int simInit(const char *flashFile); // Map the simulated flash (backed by flashFile) and SRAM at their device addresses
+void simReset(SimResetCause_T cause); // Reset the simulated device
+SimResult_T simRun(void (*entry)(void)); // Run entry on the simulated core until it returns, starts an application, stalls or is reset
+void simAdvanceCycles(uint64_t cycles); // Advance simulated time (takes the flash interrupt when it becomes due, checks for watchdog expiry)
+uint64_t simGetCycles(); // Get the simulated cycle count
+void *simAlloc(uint32_t size); // Allocate a buffer addressable by the simulated core (32-bit address)
+void simExit(SimEvent_T event); // End the current simulator run
+uint8_t simClockIsEnabled(SimClock_T clock); // Check whether a peripheral clock is enabled
+
+// Flash (sim_flash.c)
+int simFlashMap(const char *flashFile); // Map the flash backing file at the device flash address
+void simFlashReset(); // Reset the flash controller (locked, flags cleared, no operation in progress)
+void simFlashEraseAll(); // Erase the entire simulated flash (factory state)
+SimFlashStats_T simFlashGetStats(); // Get flash operation statistics
+void simFlashResetStats(); // Reset flash operation statistics
+void simFlashSetPowerCut(uint32_t operation); // Cut power during the operation'th flash operation from now (tearing it and ending the run), 0 to disarm
+uint32_t simFlashSize(); // Size of the simulated flash (bytes)
+void simFlashSave(uint8_t *buffer); // Copy the simulated flash contents to buffer (simFlashSize bytes)
+void simFlashLoad(const uint8_t *buffer); // Restore the simulated flash contents from buffer (simFlashSize bytes)
+void simFlashCorrupt(uint32_t address); // Flip the lowest bit of the flash byte at address (data corrupted in place, no flash operation)
+void simFlashSetIrqHandler(void (*handler)(void)); // Set the application FLASH_IRQHandler (NULL for none)
+uint8_t simFlashIrqDue(uint64_t cycles, uint64_t *due); // Check whether the flash interrupt will be taken by cycles (enabled, handler set, interrupt-driven operation ending), due is set to when
+void simFlashIrq(); // Take the flash interrupt (runs the application FLASH_IRQHandler)
+
+// CRC (sim_crc.c)
+void simCrcReset(); // Reset the CRC peripheral and DMA1 channel 2
+uint32_t simCrc32(const uint8_t *data, uint32_t length); // Standard CRC-32 (as binascii.crc32) of a host buffer
+
+// Boot and application flows (sim_app.c)
+SimResult_T simBoot(); // Run the bootloader until it starts an application (or stalls/is reset)
+uint8_t simBootSlot(SimResult_T result); // Application space started by a boot (0 if none)
+void simAppFillImage(uint8_t *image, uint8_t slot, uint32_t size, uint32_t seed); // Fill image with a test application for slot (valid SP/PC, pseudo-random body)
+AppInfo_T simAppGetInfo(const uint8_t *image, uint32_t size, uint32_t id, uint32_t version); // Application info for an image (as make_update_header.py generates it)
+SimInstallResult_T simAppInstall(uint8_t slot, const uint8_t *image, AppInfo_T info); // Install an image (simulator addressable, double-word padded) to an application space
+void simAppSetFlashRam(uint8_t mode); // Run the flash operations of later installs from RAM flash routines (0 off, 1 rows programmed a double-word at a time, 2 fast programmed rows)
+SimInstallResult_T simAppInstallStream(uint8_t slot, const uint8_t *image, AppInfo_T info, uint32_t chunk); // Install an image (simulator addressable) through the streaming writer in chunks of chunk bytes (0 to write with app_write)
+SimInstallResult_T simAppInstallCompressed(uint8_t slot, const uint8_t *image, uint32_t length, uint32_t id, uint32_t version, uint32_t chunk); // Install an application to slot from a compressed update image (simulator addressable), delivered in chunks of chunk bytes
+SimInstallResult_T simAppInstallPatch(uint8_t slot, uint8_t oldSlot, const uint8_t *patch, uint32_t length, uint32_t id, uint32_t version, uint32_t chunk); // Install an application to slot from a delta update patch (simulator addressable) of the application in oldSlot, delivered in chunks of chunk bytes
+SimInstallResult_T simAppInstallOta(uint8_t slot, const uint8_t *image, AppInfo_T info, uint32_t chunk, uint32_t baud, uint8_t async); // Install an image (simulator addressable) received over a link at baud in chunks of chunk bytes, through the streaming writer or the asynchronous writer
+BootloaderStatus_T simAppSetSetting(SimSetting_T setting, uint32_t value, SimResult_T *result); // Change a bootloader setting
+SimResult_T simAppWait(uint64_t cycles); // Let simulated time pass in a running application that does not refresh the watchdog
+SimResult_T simAppHardFault(uint32_t address); // Hard fault in a running application at address (its HardFault_Handler branches to the bootloader hard fault handler)
+BootloaderStatus_T simAppConfirm(SimResult_T *result); // Confirm the running application (ends its trial)
+BootloaderStatus_T simAppTransaction(SimTransaction_T action, SimResult_T *result); // Begin, commit or abort a metadata transaction
+SimAppState_T simAppGetState(); // Read bootloader settings and application info through a read-only view of bootloader data
+BootloaderStatus_T simAppWriteInfo(uint8_t slot, AppInfo_T info, SimResult_T *result); // Write application info (in programming mode) without touching the application space
+SimVerifyResult_T simAppVerifySlot(uint8_t slot, uint32_t budget); // Verify an application space in the background, budget bytes per step, until the pass ends
+
+// Power-cut fuzzing (sim_powercut.c)
+int simPowerCut(); // Cut power at every flash operation of bootloader data updates and boots, checking that settings are never lost (run on blank flash)
+
+// Benchmarks (sim_bench.c)
+int simBench(const char *baselineFile); // Run the boot latency benchmarks (compared against baselineFile if not NULL)
+
+// USART, DMA, SysTick and TIM2, host end of the recovery transport (sim_usart.c)
+void simUsartReset(); // Reset USART2, DMA1 channel 1, SysTick and TIM2 (the host end is unaffected)
+void simUsartUpload(const uint8_t *data, uint32_t length); // Connect the host end with a recovery upload to send when the bootloader is ready (NULL to disconnect)
+SimRecoveryResult_T simUsartGetResult(); // Result of the recovery upload as seen by the host end
+
+// IWDG (sim_iwdg.c)
+void simIwdgReset(); // Stop the watchdog (reset)
+void simIwdgCheck(uint64_t cycles); // Expire the watchdog if its timeout has elapsed at cycles
+
+#endif
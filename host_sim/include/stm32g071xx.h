@@ -0,0 +1,231 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Host simulator device header (header)
+Stand-in for the CMSIS STM32G071 device header when building the bootloader for the host simulator
+*/
+
+/* INCLUDE GUARD */
+#pragma once
+#ifndef HOST_SIM_STM32G071XX_H
+#define HOST_SIM_STM32G071XX_H
+
+/* DEPENDENCIES */
+#include <stdint.h>                 // Fixed width integer data types
+
+/* CONSTANT DEFINITIONS AND MACROS */
+#define STM32G071xx
+
+#define FLASH_BASE (0x08000000UL)   // Flash base address
+#define SRAM_BASE (0x20000000UL)    // SRAM base address
+
+// RCC control/status register reset flags (same bit positions as the device)
+#define RCC_CSR_RMVF (0x1UL << 23)
+#define RCC_CSR_OBLRSTF (0x1UL << 25)
+#define RCC_CSR_PINRSTF (0x1UL << 26)
+#define RCC_CSR_PWRRSTF (0x1UL << 27)
+#define RCC_CSR_SFTRSTF (0x1UL << 28)
+#define RCC_CSR_IWDGRSTF (0x1UL << 29)
+#define RCC_CSR_WWDGRSTF (0x1UL << 30)
+#define RCC_CSR_LPWRRSTF (0x1UL << 31)
+#define RCC_CSR_RESET_FLAGS (RCC_CSR_OBLRSTF | RCC_CSR_PINRSTF | RCC_CSR_PWRRSTF | RCC_CSR_SFTRSTF | RCC_CSR_IWDGRSTF | RCC_CSR_WWDGRSTF | RCC_CSR_LPWRRSTF)
+
+// RCC peripheral clock enables (same bit positions as the device)
+#define RCC_IOPENR_GPIOAEN (0x1UL << 0)
+#define RCC_AHBENR_DMA1EN (0x1UL << 0)
+#define RCC_APBENR1_TIM2EN (0x1UL << 0)
+#define RCC_APBENR1_USART2EN (0x1UL << 17)
+
+// GPIO mode, pull-up/pull-down and alternate function fields (same bit positions as the device)
+#define GPIO_MODER_MODE2_Pos 4U
+#define GPIO_MODER_MODE2 (0x3UL << GPIO_MODER_MODE2_Pos)
+#define GPIO_MODER_MODE2_1 (0x2UL << GPIO_MODER_MODE2_Pos)
+#define GPIO_MODER_MODE3_Pos 6U
+#define GPIO_MODER_MODE3 (0x3UL << GPIO_MODER_MODE3_Pos)
+#define GPIO_MODER_MODE3_1 (0x2UL << GPIO_MODER_MODE3_Pos)
+#define GPIO_PUPDR_PUPD3_Pos 6U
+#define GPIO_PUPDR_PUPD3 (0x3UL << GPIO_PUPDR_PUPD3_Pos)
+#define GPIO_PUPDR_PUPD3_0 (0x1UL << GPIO_PUPDR_PUPD3_Pos)
+#define GPIO_AFRL_AFSEL2_Pos 8U
+#define GPIO_AFRL_AFSEL2 (0xFUL << GPIO_AFRL_AFSEL2_Pos)
+#define GPIO_AFRL_AFSEL3_Pos 12U
+#define GPIO_AFRL_AFSEL3 (0xFUL << GPIO_AFRL_AFSEL3_Pos)
+
+// DMA channel control (same bit positions as the device)
+#define DMA_CCR_EN (0x1UL << 0)
+#define DMA_CCR_CIRC (0x1UL << 5)
+#define DMA_CCR_DIR (0x1UL << 4)
+#define DMA_CCR_MINC (0x1UL << 7)
+#define DMA_CCR_PSIZE_1 (0x2UL << 8)
+#define DMA_CCR_MSIZE_1 (0x2UL << 10)
+#define DMA_CCR_MEM2MEM (0x1UL << 14)
+#define DMA_ISR_GIF2 (0x1UL << 4)
+#define DMA_ISR_TCIF2 (0x1UL << 5)
+#define DMA_ISR_TEIF2 (0x1UL << 7)
+#define DMA_IFCR_CGIF2 (0x1UL << 4)
+
+// USART control and status (same bit positions as the device)
+#define USART_CR1_UE (0x1UL << 0)
+#define USART_CR1_RE (0x1UL << 2)
+#define USART_CR1_TE (0x1UL << 3)
+#define USART_CR1_OVER8 (0x1UL << 15)
+#define USART_CR3_DMAR (0x1UL << 6)
+#define USART_CR3_OVRDIS (0x1UL << 12)
+#define USART_ISR_TC (0x1UL << 6)
+#define USART_ISR_TXE_TXFNF (0x1UL << 7)
+
+// Flash status and control (same bit positions as the device)
+#define FLASH_SR_BSY1 (0x1UL << 16)
+#define FLASH_SR_CFGBSY (0x1UL << 18)
+#define FLASH_CR_PG (0x1UL << 0)
+#define FLASH_CR_PER (0x1UL << 1)
+#define FLASH_CR_PNB_Pos 3U
+#define FLASH_CR_PNB (0x3FUL << FLASH_CR_PNB_Pos)
+#define FLASH_CR_STRT (0x1UL << 16)
+#define FLASH_CR_FSTPG (0x1UL << 18)
+
+// Timer control and event generation (same bit positions as the device)
+#define TIM_CR1_CEN (0x1UL << 0)
+#define TIM_EGR_UG (0x1UL << 0)
+
+// SysTick control (same bit positions as the device)
+#define SysTick_CTRL_ENABLE_Msk (0x1UL << 0)
+#define SysTick_CTRL_CLKSOURCE_Msk (0x1UL << 2)
+#define SysTick_CTRL_COUNTFLAG_Msk (0x1UL << 16)
+
+// Simulated core and peripheral register blocks
+#define SCB (&simSCB)
+#define RCC (&simRCC)
+#define CRC (&simCRC)
+#define IWDG (&simIWDG)
+#define GPIOA (&simGPIOA)
+#define DMAMUX1_Channel0 (&simDMAMUX1_Channel0)
+#define DMA1 (simDma1()) // Accesses run a memory to memory transfer started on channel 2
+#define DMA1_Channel1 (simDmaChannel1()) // Accesses let simulated time pass and deliver bytes received by USART2
+#define DMA1_Channel2 (simDmaChannel2()) // Memory to memory transfers to the CRC unit
+#define USART2 (simUsart2()) // Accesses let simulated time pass and collect transmitted bytes
+#define SysTick (simSysTick()) // Accesses let simulated time pass and update the count flag
+#define TIM2 (simTim2()) // Accesses bring the counter up to the current simulated time
+#define FLASH (simFlashRegisters()) // Accesses start a page erase set up in the control register and let simulated time pass while an operation is busy
+
+#define __ASM __asm__
+#define __WFI() simWaitForInterrupt() // Sleep until an interrupt (with none that can come the simulated core stalls)
+#define __RBIT(value) simReverseBits(value) // Reverse bit order (CMSIS, software on Cortex-M0+)
+#define __ISB() // Instruction synchronisation barrier (nothing to synchronise on the host)
+#define NVIC_SystemReset() simSystemReset() // Software reset (ends the current simulator run)
+#define NVIC_EnableIRQ(irq) simNvicEnableIRQ(irq) // Enable an interrupt (only the flash interrupt is simulated)
+#define NVIC_DisableIRQ(irq) simNvicDisableIRQ(irq) // Disable an interrupt
+#define NVIC_GetEnableIRQ(irq) simNvicIsEnabled(irq) // Check whether an interrupt is enabled
+#define __disable_irq() simSetPrimask(1) // Mask interrupts (PRIMASK)
+#define __enable_irq() simSetPrimask(0) // Unmask interrupts (an interrupt that became due while masked is taken now)
+#define __get_PRIMASK() simGetPrimask() // Interrupt mask (PRIMASK)
+#define __set_PRIMASK(mask) simSetPrimask(mask) // Restore the interrupt mask
+
+/* TYPE DEFINITIONS AND ENUMERATIONS */
+
+typedef enum { // Interrupt numbers (only those used by the bootloader)
+    FLASH_IRQn = 3                          // Flash global interrupt
+} IRQn_Type;
+
+typedef struct { // System control block (only the registers used by the bootloader)
+    volatile uint32_t VTOR; // Vector table offset register
+} SCB_Type;
+
+typedef struct { // Reset and clock control (only the registers used by the bootloader)
+    volatile uint32_t IOPENR; // GPIO clock enable register
+    volatile uint32_t AHBENR; // AHB peripheral clock enable register
+    volatile uint32_t APBENR1; // APB peripheral clock enable register 1
+    volatile uint32_t CSR; // Control/status register (reset flags)
+} RCC_TypeDef;
+
+typedef struct { // CRC calculation unit
+    volatile uint32_t DR; // Data register (current CRC value)
+    volatile uint32_t CR; // Control register
+    volatile uint32_t INIT; // Initial CRC value
+    volatile uint32_t POL; // Polynomial
+} CRC_TypeDef;
+
+typedef struct { // Flash interface (only the registers used by the bootloader)
+    volatile uint32_t SR; // Status register
+    volatile uint32_t CR; // Control register
+} FLASH_TypeDef;
+
+typedef struct { // Independent watchdog
+    volatile uint32_t PR; // Prescaler register
+    volatile uint32_t RLR; // Reload register
+} IWDG_TypeDef;
+
+typedef struct { // General purpose I/O port (only the registers used by the bootloader)
+    volatile uint32_t MODER; // Mode register
+    volatile uint32_t PUPDR; // Pull-up/pull-down register
+    volatile uint32_t AFR[2]; // Alternate function registers
+} GPIO_TypeDef;
+
+typedef struct { // DMA channel
+    volatile uint32_t CCR; // Channel configuration register
+    volatile uint32_t CNDTR; // Number of data to transfer (remaining before the buffer wraps)
+    volatile uint32_t CPAR; // Peripheral address
+    volatile uint32_t CMAR; // Memory address
+} DMA_Channel_TypeDef;
+
+typedef struct { // DMA controller (interrupt status, only channel 2 is simulated)
+    volatile uint32_t ISR; // Interrupt status register
+    volatile uint32_t IFCR; // Interrupt flag clear register
+} DMA_TypeDef;
+
+typedef struct { // DMA request multiplexer channel
+    volatile uint32_t CCR; // Channel configuration register (request ID)
+} DMAMUX_Channel_TypeDef;
+
+typedef struct { // USART (only the registers used by the bootloader)
+    volatile uint32_t CR1; // Control register 1
+    volatile uint32_t CR3; // Control register 3
+    volatile uint32_t BRR; // Baud rate register
+    volatile uint32_t ISR; // Interrupt and status register
+    volatile uint32_t RDR; // Receive data register
+    volatile uint32_t TDR; // Transmit data register
+} USART_TypeDef;
+
+typedef struct { // General purpose timer (only the registers used by the bootloader, up-counting)
+    volatile uint32_t CR1; // Control register 1
+    volatile uint32_t SR; // Status register
+    volatile uint32_t EGR; // Event generation register
+    volatile uint32_t CNT; // Counter
+    volatile uint32_t PSC; // Prescaler
+    volatile uint32_t ARR; // Auto-reload register
+} TIM_TypeDef;
+
+typedef struct { // SysTick timer
+    volatile uint32_t CTRL; // Control and status register
+    volatile uint32_t LOAD; // Reload value register
+    volatile uint32_t VAL; // Current value register
+} SysTick_Type;
+
+/* GLOBAL VARIABLES */
+extern SCB_Type simSCB;
+extern RCC_TypeDef simRCC;
+extern CRC_TypeDef simCRC;
+extern IWDG_TypeDef simIWDG;
+extern GPIO_TypeDef simGPIOA;
+extern DMAMUX_Channel_TypeDef simDMAMUX1_Channel0;
+
+/* FUNCTIONS */
+void simWaitForInterrupt(void); // Sleep until the flash interrupt is taken (stalls the simulated core, ending the run, if no interrupt can come)
+uint32_t simReverseBits(uint32_t value); // Reverse the bit order of a word
+void simSystemReset(void); // Software reset of the simulated device (ends the current simulator run)
+DMA_Channel_TypeDef *simDmaChannel1(void); // DMA1 channel 1 registers (delivers bytes received by USART2 up to the current simulated time)
+DMA_Channel_TypeDef *simDmaChannel2(void); // DMA1 channel 2 registers (memory to memory transfers to the CRC unit)
+DMA_TypeDef *simDma1(void); // DMA1 status registers (runs a memory to memory transfer enabled on channel 2 and applies flag clears)
+USART_TypeDef *simUsart2(void); // USART2 registers (collects transmitted bytes)
+SysTick_Type *simSysTick(void); // SysTick registers (count flag set if a period has elapsed since the last access)
+TIM_TypeDef *simTim2(void); // TIM2 registers (counter advanced by the cycles elapsed since the last access while enabled and clocked)
+FLASH_TypeDef *simFlashRegisters(void); // Flash registers (a page erase set up in the control register starts, accesses let simulated time pass while an operation is busy)
+void simFlashWriteWord(uint32_t address, uint32_t word); // Word write to flash memory (programs a double-word, or a fast programming row, once all of it is written with PG or FSTPG set)
+void simNvicEnableIRQ(IRQn_Type irq); // Enable an interrupt in the simulated NVIC
+void simNvicDisableIRQ(IRQn_Type irq); // Disable an interrupt in the simulated NVIC
+uint8_t simNvicIsEnabled(IRQn_Type irq); // Check whether an interrupt is enabled in the simulated NVIC
+void simSetPrimask(uint8_t masked); // Mask or unmask interrupts on the simulated core
+uint8_t simGetPrimask(void); // Get whether interrupts are masked on the simulated core
+
+#endif
@@ -0,0 +1,192 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Host simulator HAL (header)
+Stand-in for the subset of the STM32G0 HAL used by the bootloader, backed by the simulated peripherals
+*/
+
+/* INCLUDE GUARD */
+#pragma once
+#ifndef HOST_SIM_STM32G0XX_HAL_H
+#define HOST_SIM_STM32G0XX_HAL_H
+
+/* DEPENDENCIES */
+#include <stdint.h>                 // Fixed width integer data types
+#include <stddef.h>                 // NULL (as provided by the HAL)
+#include "stm32g071xx.h"            // Simulated device registers
+
+/* CONSTANT DEFINITIONS AND MACROS */
+
+// Flash
+#define FLASH_PAGE_SIZE 0x00000800U         // Flash page size (2K)
+#define FLASH_ROW_SIZE 32U                  // Fast programming row size (double-words)
+
+#define FLASH_TYPEERASE_PAGES (0x1UL << 1)  // Page erase
+#define FLASH_TYPEERASE_MASS (0x1UL << 2)   // Mass erase
+#define FLASH_TYPEPROGRAM_DOUBLEWORD (0x1UL << 0) // Program a double-word
+#define FLASH_TYPEPROGRAM_FAST (0x1UL << 18) // Fast program a row of 32 double-words
+
+#define FLASH_FLAG_EOP (0x1UL << 0)         // End of operation
+#define FLASH_FLAG_OPERR (0x1UL << 1)       // Operation error
+#define FLASH_FLAG_PROGERR (0x1UL << 3)     // Programming error (target not erased)
+#define FLASH_FLAG_WRPERR (0x1UL << 4)      // Write protection error
+#define FLASH_FLAG_PGAERR (0x1UL << 5)      // Programming alignment error
+#define FLASH_FLAG_SIZERR (0x1UL << 6)      // Size error
+#define FLASH_FLAG_PGSERR (0x1UL << 7)      // Programming sequence error
+#define FLASH_FLAG_MISERR (0x1UL << 8)      // Fast programming data miss error
+#define FLASH_FLAG_FASTERR (0x1UL << 9)     // Fast programming error
+#define FLASH_FLAG_OPTVERR (0x1UL << 15)    // Option validity error
+#define FLASH_FLAG_BSY (0x1UL << 16)        // Operation busy
+#define FLASH_FLAG_ALL_ERRORS (FLASH_FLAG_OPERR | FLASH_FLAG_PROGERR | FLASH_FLAG_WRPERR | FLASH_FLAG_PGAERR | FLASH_FLAG_SIZERR | FLASH_FLAG_PGSERR | FLASH_FLAG_MISERR | FLASH_FLAG_FASTERR | FLASH_FLAG_OPTVERR)
+
+#define __HAL_FLASH_GET_FLAG(flag) ((simFlashGetFlags() & (flag)) != 0U)
+#define __HAL_FLASH_CLEAR_FLAG(flag) simFlashClearFlags(flag)
+
+// CRC
+#define DEFAULT_POLYNOMIAL_ENABLE ((uint8_t)0x00U)
+#define DEFAULT_POLYNOMIAL_DISABLE ((uint8_t)0x01U)
+#define DEFAULT_INIT_VALUE_ENABLE ((uint8_t)0x00U)
+#define DEFAULT_INIT_VALUE_DISABLE ((uint8_t)0x01U)
+#define DEFAULT_CRC32_POLY 0x04C11DB7U
+#define DEFAULT_CRC_INITVALUE 0xFFFFFFFFU
+#define CRC_POLYLENGTH_32B 0x00000000U
+#define CRC_INPUTDATA_INVERSION_NONE 0x00000000U
+#define CRC_INPUTDATA_INVERSION_BYTE (0x1UL << 5)
+#define CRC_INPUTDATA_INVERSION_HALFWORD (0x2UL << 5)
+#define CRC_INPUTDATA_INVERSION_WORD (0x3UL << 5)
+#define CRC_OUTPUTDATA_INVERSION_DISABLE 0x00000000U
+#define CRC_OUTPUTDATA_INVERSION_ENABLE (0x1UL << 7)
+#define CRC_INPUTDATA_FORMAT_BYTES 0x00000001U
+#define CRC_INPUTDATA_FORMAT_HALFWORDS 0x00000002U
+#define CRC_INPUTDATA_FORMAT_WORDS 0x00000003U
+#define __HAL_CRC_DR_RESET(handle) ((handle)->Instance->DR = (handle)->Instance->INIT) // Reset the calculation to the initial value (CR RESET bit)
+
+// IWDG
+#define IWDG_PRESCALER_4 0x00000000U
+#define IWDG_PRESCALER_8 0x00000001U
+#define IWDG_PRESCALER_16 0x00000002U
+#define IWDG_PRESCALER_32 0x00000003U
+#define IWDG_PRESCALER_64 0x00000004U
+#define IWDG_PRESCALER_128 0x00000005U
+#define IWDG_PRESCALER_256 0x00000006U
+#define IWDG_WINDOW_DISABLE 0x00000FFFU
+
+// RCC
+#define RCC_FLAG_OBLRST RCC_CSR_OBLRSTF     // Option byte loader reset
+#define RCC_FLAG_PINRST RCC_CSR_PINRSTF     // Pin reset
+#define RCC_FLAG_PWRRST RCC_CSR_PWRRSTF     // BOR or POR/PDR reset
+#define RCC_FLAG_SFTRST RCC_CSR_SFTRSTF     // Software reset
+#define RCC_FLAG_IWDGRST RCC_CSR_IWDGRSTF   // Independent watchdog reset
+#define RCC_FLAG_WWDGRST RCC_CSR_WWDGRSTF   // Window watchdog reset
+#define RCC_FLAG_LPWRRST RCC_CSR_LPWRRSTF   // Low-power reset
+
+#define __HAL_RCC_GET_FLAG(flag) ((RCC->CSR & (flag)) != 0U)
+#define __HAL_RCC_CLEAR_RESET_FLAGS() (RCC->CSR &= ~RCC_CSR_RESET_FLAGS)
+
+#define __HAL_RCC_SYSCFG_CLK_ENABLE() simClockEnable(SIM_CLOCK_SYSCFG)
+#define __HAL_RCC_PWR_CLK_ENABLE() simClockEnable(SIM_CLOCK_PWR)
+#define __HAL_RCC_CRC_CLK_ENABLE() simClockEnable(SIM_CLOCK_CRC)
+#define __HAL_RCC_CRC_CLK_DISABLE() simClockDisable(SIM_CLOCK_CRC)
+#define __HAL_RCC_CRC_IS_CLK_ENABLED() simClockIsEnabled(SIM_CLOCK_CRC)
+
+/* TYPE DEFINITIONS AND ENUMERATIONS */
+
+typedef enum { // HAL status
+    HAL_OK = 0x00U,
+    HAL_ERROR = 0x01U,
+    HAL_BUSY = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum { // HAL lock
+    HAL_UNLOCKED = 0x00U,
+    HAL_LOCKED = 0x01U
+} HAL_LockTypeDef;
+
+typedef enum { // Simulated peripheral clocks
+    SIM_CLOCK_SYSCFG,
+    SIM_CLOCK_PWR,
+    SIM_CLOCK_CRC
+} SimClock_T;
+
+typedef struct { // Flash erase parameters
+    uint32_t TypeErase; // Mass erase or page erase
+    uint32_t Page; // Initial page to erase
+    uint32_t NbPages; // Number of pages to erase
+} FLASH_EraseInitTypeDef;
+
+typedef enum { // CRC state
+    HAL_CRC_STATE_RESET = 0x00U,
+    HAL_CRC_STATE_READY = 0x01U,
+    HAL_CRC_STATE_BUSY = 0x02U,
+    HAL_CRC_STATE_TIMEOUT = 0x03U,
+    HAL_CRC_STATE_ERROR = 0x04U
+} HAL_CRC_StateTypeDef;
+
+typedef struct { // CRC configuration
+    uint8_t DefaultPolynomialUse;
+    uint8_t DefaultInitValueUse;
+    uint32_t GeneratingPolynomial;
+    uint32_t CRCLength;
+    uint32_t InitValue;
+    uint32_t InputDataInversionMode;
+    uint32_t OutputDataInversionMode;
+} CRC_InitTypeDef;
+
+typedef struct { // CRC handle
+    CRC_TypeDef *Instance;
+    CRC_InitTypeDef Init;
+    HAL_LockTypeDef Lock;
+    volatile HAL_CRC_StateTypeDef State;
+    uint32_t InputDataFormat;
+} CRC_HandleTypeDef;
+
+typedef struct { // IWDG configuration
+    uint32_t Prescaler;
+    uint32_t Reload;
+    uint32_t Window;
+} IWDG_InitTypeDef;
+
+typedef struct { // IWDG handle
+    IWDG_TypeDef *Instance;
+    IWDG_InitTypeDef Init;
+} IWDG_HandleTypeDef;
+
+/* GLOBAL VARIABLES */
+
+
+/* FUNCTIONS */
+
+// Flash (sim_flash.c)
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError);
+HAL_StatusTypeDef HAL_FLASH_Program_IT(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase_IT(FLASH_EraseInitTypeDef *pEraseInit);
+void HAL_FLASH_IRQHandler(void);
+void HAL_FLASH_EndOfOperationCallback(uint32_t ReturnValue); // Provided by the bootloader (weak in the device HAL)
+void HAL_FLASH_OperationErrorCallback(uint32_t ReturnValue); // Provided by the bootloader (weak in the device HAL)
+uint32_t simFlashGetFlags(void);
+void simFlashClearFlags(uint32_t flags);
+void simFlashRead(uint32_t words); // Let the time the core takes to read and test words of flash pass (the host reads them for free)
+
+// CRC (sim_crc.c)
+HAL_StatusTypeDef HAL_CRC_Init(CRC_HandleTypeDef *hcrc);
+HAL_StatusTypeDef HAL_CRC_DeInit(CRC_HandleTypeDef *hcrc);
+uint32_t HAL_CRC_Calculate(CRC_HandleTypeDef *hcrc, uint32_t pBuffer[], uint32_t BufferLength);
+uint32_t HAL_CRC_Accumulate(CRC_HandleTypeDef *hcrc, uint32_t pBuffer[], uint32_t BufferLength);
+HAL_StatusTypeDef HAL_CRCEx_Input_Data_Reverse(CRC_HandleTypeDef *hcrc, uint32_t InputReverseMode);
+void simCrcSoftware(uint32_t length); // Let the time a software CRC over length bytes takes pass (the host runs the loop for free)
+
+// IWDG (sim_iwdg.c)
+HAL_StatusTypeDef HAL_IWDG_Init(IWDG_HandleTypeDef *hiwdg);
+HAL_StatusTypeDef HAL_IWDG_Refresh(IWDG_HandleTypeDef *hiwdg);
+
+// RCC (sim_core.c)
+void simClockEnable(SimClock_T clock);
+void simClockDisable(SimClock_T clock);
+uint8_t simClockIsEnabled(SimClock_T clock);
+
+#endif
@@ -0,0 +1,525 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Host simulator (implementation)
+Command line front end: runs the bootloader and application-side update flows against the simulated device
+*/
+
+/* DEPENDENCIES */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "host_sim.h"
+#include "recovery.h"               // Recovery transport protocol
+
+/* CONSTANT DEFINITIONS AND MACROS */
+#define DEFAULT_FLASH_FILE "host_sim_flash.bin" // Default flash backing file
+
+/* GLOBAL VARIABLES */
+
+
+/* FUNCTIONS */
+
+static void printUsage() { // Print command line usage
+    printf("Usage: host_sim [-f <flash file>] <command> [<command> ...]\n");
+    printf("Commands:\n");
+    printf("  blank                                  erase the entire simulated flash\n");
+    printf("  reset <power|pin|software|iwdg|wwdg|lowpower|obl>  reset the simulated device\n");
+    printf("  boot                                   run the bootloader\n");
+    printf("  install <1|2> <binary> <id> <version>  install an application binary through the bootloader API\n");
+    printf("  stream <1|2> <binary> <id> <version> <chunk>  install an application binary through the streaming writer (unaligned chunks of <chunk> bytes, pages erased as they are first written)\n");
+    printf("  ota <1|2> <binary> <id> <version> <chunk> <baud> <sync|async>  install an application binary received over a link at <baud> in chunks of <chunk> bytes, written through the streaming writer (link waits while each chunk is written) or the asynchronous writer (flash programs while the link receives)\n");
+    printf("  patch <1|2> <1|2> <patch> <id> <version> <chunk>  install an application to the first application space from a delta update patch of the second (make_delta_update.py, chunks of <chunk> bytes)\n");
+    printf("  unpack <1|2> <image> <id> <version> <chunk>  install an application from a compressed update image (make_compressed_update.py, chunks of <chunk> bytes)\n");
+    printf("  recover <1|2> <binary|image> <id> <version>  boot with the host connected to the recovery transport, uploading an application binary or compressed update image (installed if no application can be started)\n");
+    printf("  priority <auto|1|2>                    set the boot priority\n");
+    printf("  verification <off|info|vectbl|app|full> set the verification mode\n");
+    printf("  watchdog <off|long|medium|short>       set the watchdog mode\n");
+    printf("  fastboot <off|on>                      set the fast boot mode (power-on and pin resets start the last application after checking only its vector table)\n");
+    printf("  policy <mask>                          set the fault policy (bit n counts reset cause n as an application fault: 2 software, 3 hard fault, 4 iwdg, 5 wwdg, 6 low-power, 7 option bytes, 8 unknown)\n");
+    printf("  trial <boots>                          set the trial boots given to each update (0 for off)\n");
+    printf("  confirm                                confirm the running application (ends its trial)\n");
+    printf("  begin                                  begin a metadata transaction (settings changes and installs are kept in RAM until commit)\n");
+    printf("  commit                                 commit a metadata transaction (one bootloader data record)\n");
+    printf("  abort                                  abort a metadata transaction (discards its changes)\n");
+    printf("  ramflash <off|rows|fast>               run the flash operations of later installs from RAM flash routines (rows programmed a double-word at a time, or fast programmed with interrupts masked)\n");
+    printf("  verifyslot <1|2> <budget>              verify an application space from the running application, <budget> bytes per step (result recorded for the next boot)\n");
+    printf("  corrupt <1|2> <offset>                 flip a bit of the byte at <offset> in an application space (flash corruption)\n");
+    printf("  wait <ms>                              let simulated time pass (without refreshing the watchdog)\n");
+    printf("  fault <address>                        hard fault in the running application at <address> (reset by the bootloader hard fault handler)\n");
+    printf("  info                                   print bootloader settings and application info\n");
+    printf("  stats                                  print the boot and update statistics\n");
+    printf("  resets                                 print the cause of the last reset, the fault policy and the reset counts\n");
+    printf("  bench [<baseline file>]                run the boot latency benchmarks on blank flash (fail on regression against a baseline)\n");
+    printf("  powercut                               cut power at every flash operation of settings changes and boots (erases the simulated flash)\n");
+}
+
+static int lookup(const char *name, const char *const *names, uint32_t count) { // Find name in names (-1 if not found)
+    for (uint32_t i = 0; i < count; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static const char *eventName(SimEvent_T event) { // Describe a simulator event
+    switch (event) {
+        case SIM_EVENT_RETURNED: return "returned";
+        case SIM_EVENT_APP_STARTED: return "application started";
+        case SIM_EVENT_STALLED: return "stalled";
+        case SIM_EVENT_WATCHDOG_RESET: return "watchdog reset";
+        case SIM_EVENT_POWER_LOST: return "power lost";
+        case SIM_EVENT_SOFTWARE_RESET: return "software reset";
+    }
+    return "unknown";
+}
+
+static int commandBoot() { // Run the bootloader once and report the boot decision
+    simFlashResetStats();
+    SimResult_T result = simBoot();
+    printf("boot: %s", eventName(result.event));
+    if (result.event == SIM_EVENT_APP_STARTED) {
+        printf(" (app %u, SP 0x%08X, PC 0x%08X, VTOR 0x%08X)", simBootSlot(result), result.stackPointer, result.startupAddress, result.vectorTable);
+    }
+    SimFlashStats_T stats = simFlashGetStats();
+    printf(" after %llu us [%u pages erased, %u double-words programmed]\n", (unsigned long long) SIM_CYCLES_TO_US(result.cycles), stats.pagesErased, stats.doubleWordsProgrammed);
+    return 0;
+}
+
+static int commandInstall(const char *slotName, const char *path, const char *id, const char *version, uint32_t chunk, uint32_t baud, uint8_t async) { // Install an application binary (through the streaming writer in chunks of chunk bytes, 0 to write with app_write), received over a link at baud if not 0 (through the asynchronous writer if async)
+    uint8_t slot = (uint8_t) atoi(slotName);
+    if ((slot < 1) || (slot > BL_APP_SLOTS)) {
+        fprintf(stderr, "install: invalid application space %s\n", slotName);
+        return -1;
+    }
+
+    FILE *binfile = fopen(path, "rb");
+    if (binfile == NULL) {
+        perror("install");
+        return -1;
+    }
+    fseek(binfile, 0, SEEK_END);
+    long length = ftell(binfile);
+    fseek(binfile, 0, SEEK_SET);
+
+    uint32_t size = (length + 7) & ~7U; // Pad binary for double-word alignment (as make_update_header.py does)
+    uint8_t *image = simAlloc(size + 8);
+    if ((image != NULL) && (chunk != 0)) {
+        image += 1; // Streaming writer input is not double-word aligned
+    }
+    if ((image == NULL) || (length <= 0)) {
+        fprintf(stderr, "install: unable to load %s\n", path);
+        fclose(binfile);
+        return -1;
+    }
+    memset(image, 0xFF, size);
+    if (fread(image, 1, length, binfile) != (size_t) length) {
+        fprintf(stderr, "install: unable to read %s\n", path);
+        fclose(binfile);
+        return -1;
+    }
+    fclose(binfile);
+
+    simFlashResetStats();
+    AppInfo_T info = simAppGetInfo(image, size, strtoul(id, NULL, 0), strtoul(version, NULL, 0));
+    SimInstallResult_T result = baud ? simAppInstallOta(slot, image, info, chunk, baud, async) : simAppInstallStream(slot, image, info, chunk);
+    SimFlashStats_T stats = simFlashGetStats();
+    printf("install: app %u, %u bytes, %s, status %d\n", slot, size, eventName(result.event), result.status);
+    if (baud) { // Write time against the time the link alone takes
+        uint64_t linkUs = (uint64_t) size*10*1000000/baud;
+        uint64_t writeUs = SIM_CYCLES_TO_US(result.cycles[SIM_INSTALL_WRITE]);
+        printf("  %s writer at %u baud: link alone %llu us, received and written in %llu us (%llu bytes/s)\n", async ? "asynchronous" : "streaming", baud,
+            (unsigned long long) linkUs, (unsigned long long) writeUs, (unsigned long long) (writeUs ? (uint64_t) size*1000000/writeUs : 0));
+    }
+    printf("  programming mode %llu us, erase %llu us, write %llu us, write info %llu us, total %llu us\n",
+        (unsigned long long) SIM_CYCLES_TO_US(result.cycles[SIM_INSTALL_PROGRAMMING_MODE]), (unsigned long long) SIM_CYCLES_TO_US(result.cycles[SIM_INSTALL_ERASE]),
+        (unsigned long long) SIM_CYCLES_TO_US(result.cycles[SIM_INSTALL_WRITE]), (unsigned long long) SIM_CYCLES_TO_US(result.cycles[SIM_INSTALL_WRITE_INFO]),
+        (unsigned long long) SIM_CYCLES_TO_US(result.totalCycles));
+    printf("  %u pages erased (%u application pages), %u double-words programmed, %u flash errors\n", stats.pagesErased, result.erasedPages, stats.doubleWordsProgrammed, stats.errors);
+    if (result.flashRam.operations) { // Interrupts left in flash wait for whole operations, RAM-resident interrupts only while masked
+        printf("  %u operations from RAM, longest %llu us (flash interrupt latency), interrupts masked up to %llu us (RAM interrupt latency)\n", result.flashRam.operations,
+            (unsigned long long) SIM_CYCLES_TO_US(result.flashRam.worstCycles), (unsigned long long) SIM_CYCLES_TO_US(result.flashRam.worstMaskedCycles));
+    }
+    return (result.status == BL_OK) ? 0 : -1;
+}
+
+static int commandPatch(const char *command, const char *slotName, const char *oldSlotName, const char *path, const char *id, const char *version, uint32_t chunk) { // Install an application from a delta update patch (make_delta_update.py) of another application space, or from a compressed update image (make_compressed_update.py, oldSlotName NULL), delivered in chunks of chunk bytes
+    uint8_t slot = (uint8_t) atoi(slotName);
+    uint8_t oldSlot = oldSlotName ? (uint8_t) atoi(oldSlotName) : slot;
+    if ((slot < 1) || (slot > BL_APP_SLOTS) || (oldSlot < 1) || (oldSlot > BL_APP_SLOTS)) {
+        fprintf(stderr, "%s: invalid application space\n", command);
+        return -1;
+    }
+
+    FILE *patchfile = fopen(path, "rb");
+    if (patchfile == NULL) {
+        perror(command);
+        return -1;
+    }
+    fseek(patchfile, 0, SEEK_END);
+    long length = ftell(patchfile);
+    fseek(patchfile, 0, SEEK_SET);
+    uint8_t *patch = simAlloc(length + 1);
+    if ((patch == NULL) || (length <= 0) || (fread(patch, 1, length, patchfile) != (size_t) length)) {
+        fprintf(stderr, "%s: unable to read %s\n", command, path);
+        fclose(patchfile);
+        return -1;
+    }
+    fclose(patchfile);
+
+    simFlashResetStats();
+    SimInstallResult_T result;
+    if (oldSlotName) {
+        result = simAppInstallPatch(slot, oldSlot, patch, length, strtoul(id, NULL, 0), strtoul(version, NULL, 0), chunk);
+        printf("%s: app %u from app %u, %ld byte patch, %s, status %d\n", command, slot, oldSlot, length, eventName(result.event), result.status);
+    } else {
+        result = simAppInstallCompressed(slot, patch, length, strtoul(id, NULL, 0), strtoul(version, NULL, 0), chunk);
+        printf("%s: app %u, %ld byte image, %s, status %d\n", command, slot, length, eventName(result.event), result.status);
+    }
+    SimFlashStats_T stats = simFlashGetStats();
+    printf("  programming mode %llu us, %s %llu us, write info %llu us, total %llu us\n",
+        (unsigned long long) SIM_CYCLES_TO_US(result.cycles[SIM_INSTALL_PROGRAMMING_MODE]), command, (unsigned long long) SIM_CYCLES_TO_US(result.cycles[SIM_INSTALL_WRITE]),
+        (unsigned long long) SIM_CYCLES_TO_US(result.cycles[SIM_INSTALL_WRITE_INFO]), (unsigned long long) SIM_CYCLES_TO_US(result.totalCycles));
+    printf("  %u pages erased (%u application pages), %u double-words programmed, %u flash errors\n", stats.pagesErased, result.erasedPages, stats.doubleWordsProgrammed, stats.errors);
+    return (result.status == BL_OK) ? 0 : -1;
+}
+
+static int commandRecover(const char *slotName, const char *path, const char *id, const char *version) { // Boot with the host end of the recovery transport sending an application binary or compressed update image (make_compressed_update.py)
+    uint8_t slot = (uint8_t) atoi(slotName);
+    if ((slot < 1) || (slot > BL_APP_SLOTS)) {
+        fprintf(stderr, "recover: invalid application space %s\n", slotName);
+        return -1;
+    }
+
+    FILE *binfile = fopen(path, "rb");
+    if (binfile == NULL) {
+        perror("recover");
+        return -1;
+    }
+    fseek(binfile, 0, SEEK_END);
+    long length = ftell(binfile);
+    fseek(binfile, 0, SEEK_SET);
+    uint32_t size = (length + 7) & ~7U; // Pad binary for double-word alignment (as make_update_header.py does)
+    uint8_t *upload = malloc(sizeof(RecoveryHeader_T) + size);
+    if ((upload == NULL) || (length <= 0)) {
+        fprintf(stderr, "recover: unable to load %s\n", path);
+        fclose(binfile);
+        free(upload);
+        return -1;
+    }
+    uint8_t *data = upload + sizeof(RecoveryHeader_T);
+    memset(data, 0xFF, size);
+    if (fread(data, 1, length, binfile) != (size_t) length) {
+        fprintf(stderr, "recover: unable to read %s\n", path);
+        fclose(binfile);
+        free(upload);
+        return -1;
+    }
+    fclose(binfile);
+
+    // Upload header (as recovery_upload.py sends it)
+    RecoveryHeader_T header;
+    memset(&header, 0, sizeof(header));
+    header.magic = RECOVERY_MAGIC;
+    header.app = slot;
+    CompressedImageHeader_T image;
+    memcpy(&image, data, (length < (long) sizeof(image)) ? length : (long) sizeof(image));
+    if ((length >= (long) sizeof(image)) && (image.magic == COMPRESSED_IMAGE_MAGIC)) { // Compressed update image, application info from its header
+        header.format = RECOVERY_FORMAT_COMPRESSED;
+        header.length = length;
+        header.info.ID = strtoul(id, NULL, 0);
+        header.info.version = strtoul(version, NULL, 0);
+        header.info.size = image.size;
+        header.info.vectblChecksum = image.vectblChecksum;
+        header.info.appChecksum = image.appChecksum;
+    } else {
+        header.format = RECOVERY_FORMAT_BINARY;
+        header.length = size;
+        header.info = simAppGetInfo(data, size, strtoul(id, NULL, 0), strtoul(version, NULL, 0));
+    }
+    header.headerChecksum = simCrc32((const uint8_t *) &header, offsetof(RecoveryHeader_T, headerChecksum));
+    memcpy(upload, &header, sizeof(header));
+
+    simFlashResetStats();
+    simUsartUpload(upload, sizeof(header) + header.length);
+    SimResult_T result = simBoot();
+    SimRecoveryResult_T recovery = simUsartGetResult();
+    simUsartUpload(NULL, 0);
+    free(upload);
+
+    SimFlashStats_T stats = simFlashGetStats();
+    printf("recover: app %u, %u byte %s upload, %s", slot, header.length, (header.format == RECOVERY_FORMAT_COMPRESSED) ? "compressed" : "binary", eventName(result.event));
+    if (recovery.complete) {
+        printf(", status %d", recovery.status);
+    }
+    printf(" after %llu us\n", (unsigned long long) SIM_CYCLES_TO_US(result.cycles));
+    uint64_t transferUs = SIM_CYCLES_TO_US(recovery.endCycles - recovery.startCycles);
+    printf("  %u bytes received, %u blocks acknowledged, transfer %llu us (%llu KB/s application data)\n", recovery.sent, recovery.acks,
+        (unsigned long long) transferUs, (unsigned long long) (recovery.complete && transferUs ? (uint64_t) header.info.size*1000/transferUs : 0));
+    printf("  %u pages erased, %u double-words programmed, %u rows fast programmed, %u flash errors\n", stats.pagesErased, stats.doubleWordsProgrammed, stats.rowsFastProgrammed, stats.errors);
+    return (recovery.complete && (recovery.status == BL_OK)) ? 0 : -1;
+}
+
+static int commandSetting(SimSetting_T setting, const char *name, const char *value, const char *const *values, uint32_t count) { // Change a bootloader setting
+    int index = lookup(value, values, count);
+    if (index < 0) {
+        fprintf(stderr, "%s: invalid value %s\n", name, value);
+        return -1;
+    }
+    SimResult_T result;
+    BootloaderStatus_T status = simAppSetSetting(setting, index, &result);
+    printf("%s: %s, %s, status %d after %llu us\n", name, value, eventName(result.event), status, (unsigned long long) SIM_CYCLES_TO_US(result.cycles));
+    return (status == BL_OK) ? 0 : -1;
+}
+
+static int commandPolicy(const char *mask) { // Set the fault policy
+    SimResult_T result;
+    BootloaderStatus_T status = simAppSetSetting(SIM_SETTING_FAULT_POLICY, strtoul(mask, NULL, 0), &result);
+    printf("policy: 0x%03lX, %s, status %d after %llu us\n", strtoul(mask, NULL, 0), eventName(result.event), status, (unsigned long long) SIM_CYCLES_TO_US(result.cycles));
+    return (status == BL_OK) ? 0 : -1;
+}
+
+static int commandTrial(const char *boots) { // Set the trial boots given to each update
+    SimResult_T result;
+    BootloaderStatus_T status = simAppSetSetting(SIM_SETTING_TRIAL_BOOTS, strtoul(boots, NULL, 0), &result);
+    printf("trial: %lu boots, %s, status %d after %llu us\n", strtoul(boots, NULL, 0), eventName(result.event), status, (unsigned long long) SIM_CYCLES_TO_US(result.cycles));
+    return (status == BL_OK) ? 0 : -1;
+}
+
+static int commandConfirm() { // Confirm the running application
+    SimResult_T result;
+    BootloaderStatus_T status = simAppConfirm(&result);
+    printf("confirm: %s, status %d after %llu us\n", eventName(result.event), status, (unsigned long long) SIM_CYCLES_TO_US(result.cycles));
+    return (status == BL_OK) ? 0 : -1;
+}
+
+static int commandTransaction(const char *name, SimTransaction_T action) { // Begin, commit or abort a metadata transaction
+    SimResult_T result;
+    simFlashResetStats();
+    BootloaderStatus_T status = simAppTransaction(action, &result);
+    SimFlashStats_T flash = simFlashGetStats();
+    printf("%s: %s, status %d after %llu us [%u pages erased, %u double-words programmed]\n", name, eventName(result.event), status, (unsigned long long) SIM_CYCLES_TO_US(result.cycles), flash.pagesErased, flash.doubleWordsProgrammed);
+    return (status == BL_OK) ? 0 : -1;
+}
+
+static int commandFault(const char *address) { // Hard fault in the running application
+    SimResult_T result = simAppHardFault(strtoul(address, NULL, 0));
+    printf("fault: %s after %llu us\n", eventName(result.event), (unsigned long long) SIM_CYCLES_TO_US(result.cycles));
+    return 0;
+}
+
+static int commandVerifySlot(const char *slot, const char *budget) { // Verify an application space in the background
+    SimVerifyResult_T result = simAppVerifySlot((uint8_t) strtoul(slot, NULL, 0), strtoul(budget, NULL, 0));
+    printf("verifyslot: app %s, %s, status %d after %u steps in %llu us (longest step %llu us)\n", slot, eventName(result.event), result.status, result.steps,
+        (unsigned long long) SIM_CYCLES_TO_US(result.totalCycles), (unsigned long long) SIM_CYCLES_TO_US(result.longestStep));
+    return (result.status == BL_OK) ? 0 : -1;
+}
+
+static int commandCorrupt(const char *slot, const char *offset) { // Corrupt a byte of an application space
+    uint8_t app = (uint8_t) strtoul(slot, NULL, 0);
+    uint32_t address = strtoul(offset, NULL, 0);
+    if (!IS_APP_SLOT(app) || address >= APP_SLOT_LENGTH(app)) {
+        fprintf(stderr, "corrupt: invalid application space or offset\n");
+        return -1;
+    }
+    simFlashCorrupt(APP_SLOT_START(app) + address);
+    printf("corrupt: app %u, offset 0x%X\n", app, address);
+    return 0;
+}
+
+static int commandWait(const char *ms) { // Let simulated time pass (a running application that does not refresh the watchdog)
+    SimResult_T result = simAppWait(strtoull(ms, NULL, 0)*(SIM_SYSCLK_HZ/1000));
+    printf("wait: %s after %llu us\n", eventName(result.event), (unsigned long long) SIM_CYCLES_TO_US(result.cycles));
+    return 0;
+}
+
+static void printAppInfo(uint8_t slot, AppInfo_T info, uint8_t faultCount) { // Print application info
+    printf("  app %u: ID 0x%08X, version 0x%08X, size %u, vector table CRC 0x%08X, app CRC 0x%08X, faults %u\n", slot, info.ID, info.version, info.size, info.vectblChecksum, info.appChecksum, faultCount);
+}
+
+static void infoEntry() { // Print bootloader settings and application info through the bootloader API
+    printf("info: bootloader version 0x%08X, priority %u, verification %u, watchdog %u, fast boot %u\n", simBootloader->getVersion(), simBootloader->getBootPriority(), simBootloader->getVerificationMode(), simBootloader->getWatchdogMode(), simBootloader->getFastBootMode());
+    TrialInfo_T trial;
+    if (simBootloader->getTrialInfo(&trial) == BL_OK) {
+        printf("  trial boots %u, app on trial %u, %u used, fallback priority %u\n", trial.trialBoots, trial.app, trial.attempts, trial.fallbackPriority);
+    }
+    for (uint8_t slot = 1; slot <= BL_APP_SLOTS; slot++) {
+        printAppInfo(slot, simBootloader->app_getInfo(slot), simBootloader->app_getFaultCount(slot));
+    }
+}
+
+static void statsEntry() { // Print the boot and update statistics through the bootloader API
+    BootStats_T stats;
+    if (simBootloader->getBootStats(&stats) != BL_OK) {
+        printf("stats: unavailable\n");
+        return;
+    }
+    printf("stats: %u boots, last boot %llu us", stats.boots, (unsigned long long) SIM_CYCLES_TO_US(stats.bootCycles));
+    for (uint8_t slot = 1; slot <= BL_APP_SLOTS; slot++) {
+        printf(", app %u verified in %llu us", slot, (unsigned long long) SIM_CYCLES_TO_US(stats.verifyCycles[slot - 1]));
+    }
+    printf("\n  %u pages erased in %llu us, %u bytes programmed in %llu us, %u verify failures, %u write failures\n", stats.erasePages, (unsigned long long) SIM_CYCLES_TO_US(stats.eraseCycles),
+        stats.programBytes, (unsigned long long) SIM_CYCLES_TO_US(stats.programCycles), stats.verifyFailures, stats.writeFailures);
+}
+
+static void resetsEntry() { // Print the cause of the last reset, the fault policy and the reset counts through the bootloader API
+    static const char *const causeNames[RESET_CAUSES] = {"power", "pin", "software", "hard fault", "iwdg", "wwdg", "low-power", "option bytes", "unknown"};
+    ResetInfo_T reset;
+    if (simBootloader->getResetInfo(&reset) == BL_OK) {
+        printf("resets: last reset %s, app %u, fault address 0x%08X, fault policy 0x%03X\n", causeNames[reset.cause], reset.app, reset.faultAddress, simBootloader->getFaultPolicy());
+    } else {
+        printf("resets: last reset not decoded, fault policy 0x%03X\n", simBootloader->getFaultPolicy());
+    }
+    for (uint8_t slot = 1; slot <= BL_APP_SLOTS; slot++) {
+        printf("  app %u:", slot);
+        for (uint8_t cause = RESET_CAUSE_SOFTWARE; cause < RESET_CAUSES; cause++) {
+            printf(" %s %u%s", causeNames[cause], simBootloader->app_getResetCount(slot, (ResetCause_T) cause), (cause + 1 < RESET_CAUSES) ? "," : "");
+        }
+        printf(" (faults %u)\n", simBootloader->app_getFaultCount(slot));
+    }
+}
+
+int main(int argc, char **argv) { // Simulator entry point
+    static const char *const resetNames[] = {"power", "pin", "software", "iwdg", "wwdg", "lowpower", "obl"};
+    static const char *const priorityNames[] = {"auto", "1", "2"};
+    static const char *const verificationNames[] = {"off", "info", "vectbl", "app", "full"};
+    static const char *const watchdogNames[] = {"off", "long", "medium", "short"};
+    static const char *const fastBootNames[] = {"off", "on"};
+    static const char *const writerNames[] = {"sync", "async"};
+    static const char *const flashRamNames[] = {"off", "rows", "fast"};
+
+    const char *flashFile = DEFAULT_FLASH_FILE;
+    int arg = 1;
+    if ((argc > 2) && (strcmp(argv[1], "-f") == 0)) {
+        flashFile = argv[2];
+        arg = 3;
+    }
+    if (arg >= argc) {
+        printUsage();
+        return 1;
+    }
+
+    if (simInit(flashFile) != 0) {
+        return 1;
+    }
+
+    while (arg < argc) {
+        const char *command = argv[arg++];
+        int args = argc - arg;
+        int status = 0;
+
+        if (strcmp(command, "blank") == 0) {
+            simFlashEraseAll();
+            printf("blank: flash erased\n");
+        } else if ((strcmp(command, "reset") == 0) && (args >= 1)) {
+            int cause = lookup(argv[arg++], resetNames, 7);
+            if (cause < 0) {
+                fprintf(stderr, "reset: invalid reset cause %s\n", argv[arg - 1]);
+                return 1;
+            }
+            simReset((SimResetCause_T) cause);
+        } else if (strcmp(command, "boot") == 0) {
+            status = commandBoot();
+        } else if ((strcmp(command, "install") == 0) && (args >= 4)) {
+            status = commandInstall(argv[arg], argv[arg + 1], argv[arg + 2], argv[arg + 3], 0, 0, 0);
+            arg += 4;
+        } else if ((strcmp(command, "stream") == 0) && (args >= 5)) {
+            uint32_t chunk = strtoul(argv[arg + 4], NULL, 0);
+            if (chunk == 0) {
+                fprintf(stderr, "stream: invalid chunk size %s\n", argv[arg + 4]);
+                return 1;
+            }
+            status = commandInstall(argv[arg], argv[arg + 1], argv[arg + 2], argv[arg + 3], chunk, 0, 0);
+            arg += 5;
+        } else if ((strcmp(command, "ota") == 0) && (args >= 7)) {
+            uint32_t chunk = strtoul(argv[arg + 4], NULL, 0);
+            uint32_t baud = strtoul(argv[arg + 5], NULL, 0);
+            int async = lookup(argv[arg + 6], writerNames, 2);
+            if ((chunk == 0) || (baud == 0) || (async < 0)) {
+                fprintf(stderr, "ota: invalid chunk size, baud rate or writer\n");
+                return 1;
+            }
+            status = commandInstall(argv[arg], argv[arg + 1], argv[arg + 2], argv[arg + 3], chunk, baud, (uint8_t) async);
+            arg += 7;
+        } else if ((strcmp(command, "patch") == 0) && (args >= 6)) {
+            uint32_t chunk = strtoul(argv[arg + 5], NULL, 0);
+            if (chunk == 0) {
+                fprintf(stderr, "patch: invalid chunk size %s\n", argv[arg + 5]);
+                return 1;
+            }
+            status = commandPatch(command, argv[arg], argv[arg + 1], argv[arg + 2], argv[arg + 3], argv[arg + 4], chunk);
+            arg += 6;
+        } else if ((strcmp(command, "unpack") == 0) && (args >= 5)) {
+            uint32_t chunk = strtoul(argv[arg + 4], NULL, 0);
+            if (chunk == 0) {
+                fprintf(stderr, "unpack: invalid chunk size %s\n", argv[arg + 4]);
+                return 1;
+            }
+            status = commandPatch(command, argv[arg], NULL, argv[arg + 1], argv[arg + 2], argv[arg + 3], chunk);
+            arg += 5;
+        } else if ((strcmp(command, "recover") == 0) && (args >= 4)) {
+            status = commandRecover(argv[arg], argv[arg + 1], argv[arg + 2], argv[arg + 3]);
+            arg += 4;
+        } else if ((strcmp(command, "priority") == 0) && (args >= 1)) {
+            status = commandSetting(SIM_SETTING_PRIORITY, command, argv[arg++], priorityNames, 3);
+        } else if ((strcmp(command, "verification") == 0) && (args >= 1)) {
+            status = commandSetting(SIM_SETTING_VERIFICATION, command, argv[arg++], verificationNames, 5);
+        } else if ((strcmp(command, "watchdog") == 0) && (args >= 1)) {
+            status = commandSetting(SIM_SETTING_WATCHDOG, command, argv[arg++], watchdogNames, 4);
+        } else if ((strcmp(command, "fastboot") == 0) && (args >= 1)) {
+            status = commandSetting(SIM_SETTING_FASTBOOT, command, argv[arg++], fastBootNames, 2);
+        } else if ((strcmp(command, "policy") == 0) && (args >= 1)) {
+            status = commandPolicy(argv[arg++]);
+        } else if ((strcmp(command, "trial") == 0) && (args >= 1)) {
+            status = commandTrial(argv[arg++]);
+        } else if (strcmp(command, "confirm") == 0) {
+            status = commandConfirm();
+        } else if (strcmp(command, "begin") == 0) {
+            status = commandTransaction(command, SIM_TRANSACTION_BEGIN);
+        } else if (strcmp(command, "commit") == 0) {
+            status = commandTransaction(command, SIM_TRANSACTION_COMMIT);
+        } else if (strcmp(command, "abort") == 0) {
+            status = commandTransaction(command, SIM_TRANSACTION_ABORT);
+        } else if ((strcmp(command, "ramflash") == 0) && (args >= 1)) {
+            int mode = lookup(argv[arg], flashRamNames, 3);
+            if (mode < 0) {
+                fprintf(stderr, "ramflash: invalid mode %s\n", argv[arg]);
+                return 1;
+            }
+            simAppSetFlashRam((uint8_t) mode);
+            arg++;
+        } else if ((strcmp(command, "verifyslot") == 0) && (args >= 2)) {
+            status = commandVerifySlot(argv[arg], argv[arg + 1]);
+            arg += 2;
+        } else if ((strcmp(command, "corrupt") == 0) && (args >= 2)) {
+            status = commandCorrupt(argv[arg], argv[arg + 1]);
+            arg += 2;
+        } else if ((strcmp(command, "wait") == 0) && (args >= 1)) {
+            status = commandWait(argv[arg++]);
+        } else if ((strcmp(command, "fault") == 0) && (args >= 1)) {
+            status = commandFault(argv[arg++]);
+        } else if (strcmp(command, "info") == 0) {
+            simRun(infoEntry);
+        } else if (strcmp(command, "stats") == 0) {
+            simRun(statsEntry);
+        } else if (strcmp(command, "resets") == 0) {
+            simRun(resetsEntry);
+        } else if (strcmp(command, "bench") == 0) {
+            status = simBench((args >= 1) ? argv[arg++] : NULL);
+        } else if (strcmp(command, "powercut") == 0) {
+            status = simPowerCut();
+        } else {
+            printUsage();
+            return 1;
+        }
+
+        if (status != 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
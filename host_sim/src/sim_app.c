@@ -0,0 +1,480 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Host simulator application (implementation)
+Simulated boot and application-side flows (install, settings) that call the bootloader through its dispatch table
+*/
+
+/* DEPENDENCIES */
+#include <string.h>
+#include "host_sim.h"
+#include "bootloader.h"             // Application space descriptors
+
+/* CONSTANT DEFINITIONS AND MACROS */
+
+/* GLOBAL VARIABLES */
+extern struct BootloaderFunctions dispatchTable; // Bootloader dispatch table (bootloader.c)
+struct BootloaderFunctions *simBootloader = &dispatchTable; // Simulated applications call the bootloader through the dispatch table
+
+static uint8_t installSlot; // Application space to install to
+static const uint8_t *installImage; // Application image to install (simulator addressable)
+static AppInfo_T installInfo; // Application info of the image to install
+static SimInstallResult_T installResult; // Result of the install
+static uint32_t installChunk; // Streaming writer chunk size (bytes) (0 to write with app_write)
+static AppWriter_T *installWriter; // Streaming writer (simulator addressable)
+static uint8_t installFlashRam; // Install flash operations run from RAM flash routines (0 off, 1 rows a double-word at a time, 2 fast programmed rows)
+static uint8_t installOldSlot; // Application space a delta update patch applies to
+static uint32_t installPatchLength; // Delta update patch or compressed update image length (bytes)
+static DeltaPatch_T *installPatch; // Delta update patch applier (simulator addressable)
+static CompressedImage_T *installCompressed; // Compressed update image decompressor (simulator addressable)
+static uint32_t installBaud; // Link baud rate an over-the-air update is received at
+static uint8_t installAsync; // Over-the-air update written through the asynchronous writer (streaming writer otherwise)
+static AsyncWriter_T *installAsyncWriter; // Asynchronous writer (simulator addressable)
+static uint8_t *installRing; // Asynchronous writer ring buffer (simulator addressable, SIM_OTA_RING_SIZE bytes)
+
+static SimSetting_T setting; // Setting to change
+static uint32_t settingValue; // Value to set
+static BootloaderStatus_T settingStatus; // Status of the setting change
+
+static uint64_t waitCycles; // Simulated time to let pass
+
+static SimAppState_T appState; // Bootloader settings and application info read through the API
+
+static uint8_t writeInfoSlot; // Application space to write info for
+static AppInfo_T writeInfoInfo; // Application info to write
+static BootloaderStatus_T writeInfoStatus; // Status of the info write
+
+static uint8_t verifySlot; // Application space to verify in the background
+static uint32_t verifyBudget; // Bytes checked per step
+static SlotVerifier_T verifier; // Background verifier (as an application would allocate it)
+static SimVerifyResult_T verifyResult; // Result of the background verification
+
+/* FUNCTIONS */
+void bootloader_main(); // Bootloader main (bootloader/src/main.c, renamed for the host build)
+
+static void bootEntry() { // Run the bootloader
+    bootloader_main();
+}
+
+SimResult_T simBoot() { // Run the bootloader until it starts an application (or stalls/is reset)
+    return simRun(bootEntry);
+}
+
+uint8_t simBootSlot(SimResult_T result) { // Application space started by a boot (0 if none)
+    if (result.event != SIM_EVENT_APP_STARTED) {return 0;}
+    for (uint8_t slot = 1; slot <= BL_APP_SLOTS; slot++) {
+        if (result.vectorTable == APP_SLOT_START(slot)) {return slot;}
+    }
+    return 0;
+}
+
+void simAppFillImage(uint8_t *image, uint8_t slot, uint32_t size, uint32_t seed) { // Fill image with a test application for slot (valid SP/PC, pseudo-random body)
+    uint32_t base = APP_SLOT_START(slot);
+    uint32_t state = seed ? seed : 1;
+    for (uint32_t i = 0; i < size; i++) { // xorshift32 body
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        image[i] = (uint8_t) state;
+    }
+    uint32_t vectors[2] = {(uint32_t) &__SRAM_START + (uint32_t) &__SRAM_LEN, base + 4*VECTOR_TABLE_SIZE + 1}; // Initial SP, Reset_Handler (thumb)
+    memcpy(image, vectors, (size < sizeof(vectors)) ? size : sizeof(vectors));
+}
+
+AppInfo_T simAppGetInfo(const uint8_t *image, uint32_t size, uint32_t id, uint32_t version) { // Application info for an image (as make_update_header.py generates it)
+    AppInfo_T info;
+    info.ID = id;
+    info.version = version;
+    info.size = size;
+    info.vectblChecksum = simCrc32(image, (size < VECTOR_TABLE_SIZE*4) ? size : VECTOR_TABLE_SIZE*4);
+    info.appChecksum = simCrc32(image, size);
+    return info;
+}
+
+static void installSteps() { // Install an application through the bootloader API (steps of installEntry)
+    uint64_t start = simGetCycles();
+    installResult.status = simBootloader->enableProgrammingMode();
+    installResult.cycles[SIM_INSTALL_PROGRAMMING_MODE] = simGetCycles() - start;
+    if (installResult.status != BL_OK) {return;}
+
+    if (installChunk == 0) { // Streaming writer erases pages as it goes
+        start = simGetCycles();
+        installResult.status = simBootloader->app_eraseRange(installSlot, 0, installInfo.size); // Only the pages the application occupies
+        installResult.cycles[SIM_INSTALL_ERASE] = simGetCycles() - start;
+        if (installResult.status != BL_OK) {return;}
+    }
+
+    start = simGetCycles();
+    if (installChunk == 0) {
+        installResult.status = simBootloader->app_write(installSlot, 0, (uint64_t *) installImage, (installInfo.size + 7)/8);
+    } else { // Streaming writer, fed in chunks as a transport would deliver them
+        installResult.status = simBootloader->appWriter_openErase(installWriter, installSlot, 0);
+        for (uint32_t offset = 0; (installResult.status == BL_OK) && (offset < installInfo.size); offset += installChunk) {
+            uint32_t length = (installInfo.size - offset < installChunk) ? installInfo.size - offset : installChunk;
+            installResult.status = simBootloader->appWriter_push(installWriter, installImage + offset, length);
+        }
+        if (installResult.status == BL_OK) {
+            installResult.status = simBootloader->appWriter_close(installWriter);
+        }
+    }
+    installResult.cycles[SIM_INSTALL_WRITE] = simGetCycles() - start;
+    installResult.erasedPages = simBootloader->getErasedPageCount();
+    if (installResult.status != BL_OK) {return;}
+
+    start = simGetCycles();
+    installResult.status = simBootloader->app_writeInfo(installSlot, installInfo);
+    installResult.cycles[SIM_INSTALL_WRITE_INFO] = simGetCycles() - start;
+    if (installResult.status != BL_OK) {return;}
+
+    installResult.status = simBootloader->disableProgrammingMode();
+}
+
+static void installEntry() { // Install an application through the bootloader API (as the TEST_IAP_ASx applications do)
+    FlashRam_T *ram = NULL;
+    if (installFlashRam) { // Vector table moved to the start of SRAM, RAM flash routines after it
+        SCB->VTOR = (uint32_t) &__SRAM_START;
+        ram = (FlashRam_T *) (uintptr_t) ((uint32_t) &__SRAM_START + 4*VECTOR_TABLE_SIZE);
+        installResult.status = simBootloader->extensions->setFlashRam(ram, 0, installFlashRam == 2);
+        if (installResult.status != BL_OK) {return;}
+    }
+    installSteps();
+    if (ram != NULL) {
+        installResult.flashRam = *ram;
+        simBootloader->extensions->setFlashRam(NULL, 0, 0);
+    }
+}
+
+SimInstallResult_T simAppInstall(uint8_t slot, const uint8_t *image, AppInfo_T info) { // Install an image (simulator addressable, double-word padded) to an application space
+    return simAppInstallStream(slot, image, info, 0);
+}
+
+void simAppSetFlashRam(uint8_t mode) { // Run the flash operations of later installs from RAM flash routines (0 off, 1 rows programmed a double-word at a time, 2 fast programmed rows)
+    installFlashRam = mode;
+}
+
+SimInstallResult_T simAppInstallStream(uint8_t slot, const uint8_t *image, AppInfo_T info, uint32_t chunk) { // Install an image (simulator addressable) through the streaming writer in chunks of chunk bytes (0 to write with app_write)
+    memset(&installResult, 0, sizeof(installResult));
+    installResult.status = BL_ERROR;
+    if ((chunk != 0) && (installWriter == NULL)) {
+        installWriter = simAlloc(sizeof(AppWriter_T));
+        if (installWriter == NULL) {return installResult;}
+    }
+    installChunk = chunk;
+    installSlot = slot;
+    installImage = image;
+    installInfo = info;
+
+    SimResult_T result = simRun(installEntry);
+    installResult.event = result.event;
+    installResult.totalCycles = result.cycles;
+    return installResult;
+}
+
+static void patchEntry() { // Install an application from a delta update patch through the bootloader API (patch delivered in chunks)
+    uint64_t start = simGetCycles();
+    installResult.status = simBootloader->enableProgrammingMode();
+    installResult.cycles[SIM_INSTALL_PROGRAMMING_MODE] = simGetCycles() - start;
+    if (installResult.status != BL_OK) {return;}
+
+    start = simGetCycles(); // Pages are erased as the patched application is written
+    installResult.status = simBootloader->deltaPatch_open(installPatch, installOldSlot, installSlot);
+    for (uint32_t offset = 0; (installResult.status == BL_OK) && (offset < installPatchLength); offset += installChunk) {
+        uint32_t length = (installPatchLength - offset < installChunk) ? installPatchLength - offset : installChunk;
+        installResult.status = simBootloader->deltaPatch_push(installPatch, installImage + offset, length);
+    }
+    if (installResult.status == BL_OK) {
+        installResult.status = simBootloader->deltaPatch_close(installPatch);
+    }
+    installResult.cycles[SIM_INSTALL_WRITE] = simGetCycles() - start;
+    installResult.erasedPages = simBootloader->getErasedPageCount();
+    if (installResult.status != BL_OK) {return;}
+
+    start = simGetCycles();
+    installInfo.size = installPatch->header.newSize; // Patched application info from the patch header
+    installInfo.vectblChecksum = installPatch->header.newVectblChecksum;
+    installInfo.appChecksum = installPatch->header.newChecksum;
+    installResult.status = simBootloader->app_writeInfo(installSlot, installInfo);
+    installResult.cycles[SIM_INSTALL_WRITE_INFO] = simGetCycles() - start;
+    if (installResult.status != BL_OK) {return;}
+
+    installResult.status = simBootloader->disableProgrammingMode();
+}
+
+SimInstallResult_T simAppInstallPatch(uint8_t slot, uint8_t oldSlot, const uint8_t *patch, uint32_t length, uint32_t id, uint32_t version, uint32_t chunk) { // Install an application to slot from a delta update patch (simulator addressable) of the application in oldSlot, delivered in chunks of chunk bytes
+    memset(&installResult, 0, sizeof(installResult));
+    installResult.status = BL_ERROR;
+    if (installPatch == NULL) {
+        installPatch = simAlloc(sizeof(DeltaPatch_T));
+        if (installPatch == NULL) {return installResult;}
+    }
+    installChunk = chunk ? chunk : length;
+    installSlot = slot;
+    installOldSlot = oldSlot;
+    installImage = patch;
+    installPatchLength = length;
+    memset(&installInfo, 0, sizeof(installInfo));
+    installInfo.ID = id;
+    installInfo.version = version;
+
+    SimResult_T result = simRun(patchEntry);
+    installResult.event = result.event;
+    installResult.totalCycles = result.cycles;
+    return installResult;
+}
+
+static void compressedEntry() { // Install an application from a compressed update image through the bootloader API (image delivered in chunks)
+    uint64_t start = simGetCycles();
+    installResult.status = simBootloader->enableProgrammingMode();
+    installResult.cycles[SIM_INSTALL_PROGRAMMING_MODE] = simGetCycles() - start;
+    if (installResult.status != BL_OK) {return;}
+
+    start = simGetCycles(); // Pages are erased as the application is written
+    installResult.status = simBootloader->compressedImage_open(installCompressed, installSlot);
+    for (uint32_t offset = 0; (installResult.status == BL_OK) && (offset < installPatchLength); offset += installChunk) {
+        uint32_t length = (installPatchLength - offset < installChunk) ? installPatchLength - offset : installChunk;
+        installResult.status = simBootloader->compressedImage_push(installCompressed, installImage + offset, length);
+    }
+    if (installResult.status == BL_OK) {
+        installResult.status = simBootloader->compressedImage_close(installCompressed);
+    }
+    installResult.cycles[SIM_INSTALL_WRITE] = simGetCycles() - start;
+    installResult.erasedPages = simBootloader->getErasedPageCount();
+    if (installResult.status != BL_OK) {return;}
+
+    start = simGetCycles();
+    installInfo.size = installCompressed->header.size; // Application info from the image header
+    installInfo.vectblChecksum = installCompressed->header.vectblChecksum;
+    installInfo.appChecksum = installCompressed->header.appChecksum;
+    installResult.status = simBootloader->app_writeInfo(installSlot, installInfo);
+    installResult.cycles[SIM_INSTALL_WRITE_INFO] = simGetCycles() - start;
+    if (installResult.status != BL_OK) {return;}
+
+    installResult.status = simBootloader->disableProgrammingMode();
+}
+
+SimInstallResult_T simAppInstallCompressed(uint8_t slot, const uint8_t *image, uint32_t length, uint32_t id, uint32_t version, uint32_t chunk) { // Install an application to slot from a compressed update image (simulator addressable), delivered in chunks of chunk bytes
+    memset(&installResult, 0, sizeof(installResult));
+    installResult.status = BL_ERROR;
+    if (installCompressed == NULL) {
+        installCompressed = simAlloc(sizeof(CompressedImage_T));
+        if (installCompressed == NULL) {return installResult;}
+    }
+    installChunk = chunk ? chunk : length;
+    installSlot = slot;
+    installImage = image;
+    installPatchLength = length;
+    memset(&installInfo, 0, sizeof(installInfo));
+    installInfo.ID = id;
+    installInfo.version = version;
+
+    SimResult_T result = simRun(compressedEntry);
+    installResult.event = result.event;
+    installResult.totalCycles = result.cycles;
+    return installResult;
+}
+
+static void otaFlashIrqHandler() { // Application FLASH_IRQHandler (forwards to the bootloader)
+    simBootloader->asyncWriter_irqHandler();
+}
+
+static void otaEntry() { // Install an application received over a link in chunks, through the streaming writer (the link waits while each chunk is written) or the asynchronous writer (flash programs while the link receives)
+    uint64_t start = simGetCycles();
+    installResult.status = simBootloader->enableProgrammingMode();
+    installResult.cycles[SIM_INSTALL_PROGRAMMING_MODE] = simGetCycles() - start;
+    if (installResult.status != BL_OK) {return;}
+
+    start = simGetCycles(); // Pages are erased as the application is written
+    if (installAsync) {
+        installResult.status = simBootloader->asyncWriter_open(installAsyncWriter, installSlot, 0, installRing, SIM_OTA_RING_SIZE, NULL);
+    } else {
+        installResult.status = simBootloader->appWriter_openErase(installWriter, installSlot, 0);
+    }
+    for (uint32_t offset = 0; (installResult.status == BL_OK) && (offset < installInfo.size); offset += installChunk) {
+        uint32_t length = (installInfo.size - offset < installChunk) ? installInfo.size - offset : installChunk;
+        simAdvanceCycles((uint64_t) length*10*SIM_SYSCLK_HZ/installBaud); // Receive the chunk (DMA or radio, the core sleeps and takes flash interrupts)
+        if (installAsync) {
+            while ((installResult.status = simBootloader->asyncWriter_push(installAsyncWriter, installImage + offset, length)) == BL_BUSY) {
+                __WFI(); // Ring buffer full, sleep until an operation ends and frees some
+            }
+        } else {
+            installResult.status = simBootloader->appWriter_push(installWriter, installImage + offset, length);
+        }
+    }
+    if (installResult.status == BL_OK) {
+        if (installAsync) {
+            installResult.status = simBootloader->asyncWriter_close(installAsyncWriter);
+            while ((installResult.status == BL_OK) && (simBootloader->asyncWriter_getStatus(installAsyncWriter) == BL_BUSY)) {
+                __WFI(); // Sleep until the remaining data is programmed
+            }
+            if (installResult.status == BL_OK) {
+                installResult.status = simBootloader->asyncWriter_getStatus(installAsyncWriter);
+            }
+        } else {
+            installResult.status = simBootloader->appWriter_close(installWriter);
+        }
+    }
+    installResult.cycles[SIM_INSTALL_WRITE] = simGetCycles() - start;
+    installResult.erasedPages = simBootloader->getErasedPageCount();
+    if (installResult.status != BL_OK) {return;}
+
+    start = simGetCycles();
+    installResult.status = simBootloader->app_writeInfo(installSlot, installInfo);
+    installResult.cycles[SIM_INSTALL_WRITE_INFO] = simGetCycles() - start;
+    if (installResult.status != BL_OK) {return;}
+
+    installResult.status = simBootloader->disableProgrammingMode();
+}
+
+SimInstallResult_T simAppInstallOta(uint8_t slot, const uint8_t *image, AppInfo_T info, uint32_t chunk, uint32_t baud, uint8_t async) { // Install an image (simulator addressable) received over a link at baud in chunks of chunk bytes, through the streaming writer or the asynchronous writer
+    memset(&installResult, 0, sizeof(installResult));
+    installResult.status = BL_ERROR;
+    if (installWriter == NULL) {installWriter = simAlloc(sizeof(AppWriter_T));}
+    if (installAsyncWriter == NULL) {installAsyncWriter = simAlloc(sizeof(AsyncWriter_T));}
+    if (installRing == NULL) {installRing = simAlloc(SIM_OTA_RING_SIZE);}
+    if ((installWriter == NULL) || (installAsyncWriter == NULL) || (installRing == NULL) || (chunk == 0) || (baud == 0)) {return installResult;}
+    installChunk = chunk;
+    installBaud = baud;
+    installAsync = async;
+    installSlot = slot;
+    installImage = image;
+    installInfo = info;
+
+    simFlashSetIrqHandler(otaFlashIrqHandler); // Vector table of the running application
+    SimResult_T result = simRun(otaEntry);
+    simFlashSetIrqHandler(NULL);
+    installResult.event = result.event;
+    installResult.totalCycles = result.cycles;
+    return installResult;
+}
+
+static void settingEntry() { // Change a bootloader setting through the bootloader API
+    if (setting == SIM_SETTING_PRIORITY) {
+        settingStatus = simBootloader->setBootPriority((BootPriority_T) settingValue);
+    } else if (setting == SIM_SETTING_VERIFICATION) {
+        settingStatus = simBootloader->setVerificationMode((VerificationMode_T) settingValue);
+    } else if (setting == SIM_SETTING_WATCHDOG) {
+        settingStatus = simBootloader->setWatchdogMode((WatchdogMode_T) settingValue);
+    } else if (setting == SIM_SETTING_FASTBOOT) {
+        settingStatus = simBootloader->setFastBootMode((FastBootMode_T) settingValue);
+    } else if (setting == SIM_SETTING_FAULT_POLICY) {
+        settingStatus = simBootloader->setFaultPolicy((uint16_t) settingValue);
+    } else if (setting == SIM_SETTING_TRIAL_BOOTS) {
+        settingStatus = simBootloader->setTrialBoots((uint8_t) settingValue);
+    }
+}
+
+BootloaderStatus_T simAppSetSetting(SimSetting_T settingToChange, uint32_t value, SimResult_T *result) { // Change a bootloader setting
+    setting = settingToChange;
+    settingValue = value;
+    settingStatus = BL_ERROR;
+    SimResult_T run = simRun(settingEntry);
+    if (result != NULL) {*result = run;}
+    return settingStatus;
+}
+
+static void waitEntry() { // Let simulated time pass
+    simAdvanceCycles(waitCycles);
+}
+
+SimResult_T simAppWait(uint64_t cycles) { // Let simulated time pass in a running application that does not refresh the watchdog
+    waitCycles = cycles;
+    return simRun(waitEntry);
+}
+
+static void faultEntry() { // Hard fault in a running application (HardFault_Handler branches to the bootloader hard fault handler)
+    simBootloader->hardFaultHandler();
+}
+
+SimResult_T simAppHardFault(uint32_t address) { // Hard fault in a running application at address (its HardFault_Handler branches to the bootloader hard fault handler)
+    simFaultAddress = address;
+    return simRun(faultEntry);
+}
+
+static void confirmEntry() { // Confirm the running application through the bootloader API
+    settingStatus = simBootloader->confirmImage();
+}
+
+BootloaderStatus_T simAppConfirm(SimResult_T *result) { // Confirm the running application (ends its trial)
+    settingStatus = BL_ERROR;
+    SimResult_T run = simRun(confirmEntry);
+    if (result != NULL) {*result = run;}
+    return settingStatus;
+}
+
+static void beginEntry() { // Begin a metadata transaction through the bootloader API
+    settingStatus = simBootloader->beginMetadataTransaction();
+}
+
+static void commitEntry() { // Commit a metadata transaction through the bootloader API
+    settingStatus = simBootloader->commitMetadataTransaction();
+}
+
+static void abortEntry() { // Abort a metadata transaction through the bootloader API
+    settingStatus = simBootloader->abortMetadataTransaction();
+}
+
+BootloaderStatus_T simAppTransaction(SimTransaction_T action, SimResult_T *result) { // Begin, commit or abort a metadata transaction
+    static void (*const entries[])(void) = {beginEntry, commitEntry, abortEntry};
+    settingStatus = BL_ERROR;
+    SimResult_T run = simRun(entries[action]);
+    if (result != NULL) {*result = run;}
+    return settingStatus;
+}
+
+static void stateEntry() { // Read bootloader settings and application info through a read-only view of bootloader data
+    BootloaderView_T view;
+    if (simBootloader->getBootloaderView(&view) != BL_OK) {return;}
+    appState.priority = *view.bootPriority;
+    appState.verification = *view.verificationMode;
+    appState.watchdog = *view.watchdogMode;
+    appState.fastBoot = (*view.fastBootMode == FASTBOOT_ON) ? FASTBOOT_ON : FASTBOOT_OFF;
+    for (uint8_t slot = 1; slot <= BL_APP_SLOTS; slot++) {
+        appState.appInfo[slot - 1] = *view.appInfo[slot - 1];
+        appState.faultCount[slot - 1] = *view.faultCount[slot - 1];
+    }
+}
+
+SimAppState_T simAppGetState() { // Read bootloader settings and application info through a read-only view of bootloader data
+    memset(&appState, 0, sizeof(appState));
+    simRun(stateEntry);
+    return appState;
+}
+
+static void writeInfoEntry() { // Write application info through the bootloader API
+    writeInfoStatus = simBootloader->enableProgrammingMode();
+    if (writeInfoStatus != BL_OK) {return;}
+    writeInfoStatus = simBootloader->app_writeInfo(writeInfoSlot, writeInfoInfo);
+    if (writeInfoStatus != BL_OK) {return;}
+    writeInfoStatus = simBootloader->disableProgrammingMode();
+}
+
+BootloaderStatus_T simAppWriteInfo(uint8_t slot, AppInfo_T info, SimResult_T *result) { // Write application info (in programming mode) without touching the application space
+    writeInfoSlot = slot;
+    writeInfoInfo = info;
+    writeInfoStatus = BL_ERROR;
+    SimResult_T run = simRun(writeInfoEntry);
+    if (result != NULL) {*result = run;}
+    return writeInfoStatus;
+}
+
+static void verifyEntry() { // Verify an application space in the background through the bootloader API (one step per pass of the application's idle loop)
+    do {
+        uint64_t start = simGetCycles();
+        verifyResult.status = simBootloader->verifySlotStep(&verifier, verifySlot, verifyBudget);
+        uint64_t cycles = simGetCycles() - start;
+        verifyResult.steps++;
+        verifyResult.totalCycles += cycles;
+        if (cycles > verifyResult.longestStep) {verifyResult.longestStep = cycles;}
+    } while (verifyResult.status == BL_BUSY && verifyResult.steps <= APP_SLOT_LENGTH(verifySlot)/verifyBudget + 2); // Stops, still busy, if the result cannot be recorded (metadata transaction open)
+}
+
+SimVerifyResult_T simAppVerifySlot(uint8_t slot, uint32_t budget) { // Verify an application space in the background, budget bytes per step, until the pass ends
+    verifySlot = slot;
+    verifyBudget = budget;
+    memset(&verifier, 0, sizeof(verifier));
+    memset(&verifyResult, 0, sizeof(verifyResult));
+    verifyResult.status = BL_ERROR;
+    verifyResult.event = simRun(verifyEntry).event;
+    return verifyResult;
+}
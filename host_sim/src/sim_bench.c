@@ -0,0 +1,219 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Host simulator benchmarks (implementation)
+Boot latency (reset to application start) for each verification mode and application size, with regression checking against a baseline, and CRC engine backend throughput
+*/
+
+/* DEPENDENCIES */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host_sim.h"
+#include "bootloader.h"             // Verification re-check interval
+#include "crc_engine.h"             // CRC engine backends
+
+/* CONSTANT DEFINITIONS AND MACROS */
+#define BENCH_COLUMNS 8             // Number of benchmark columns
+#define BENCH_SIZES 8               // Number of application sizes
+#define BENCH_LINE_LENGTH 256       // Maximum baseline file line length
+#define BENCH_CRC_BACKENDS 4        // Number of CRC backends benchmarked (the HAL byte feed, then the CRC engine backends)
+
+/* TYPE DEFINITIONS AND ENUMERATIONS */
+
+typedef struct { // Benchmark column
+    const char *name; // Column name
+    VerificationMode_T mode; // Verification mode
+    uint32_t boot; // Boot measured after the verification mode is set (1 is the first boot)
+    FastBootMode_T fastBoot; // Fast boot mode (set with the verification mode if on, columns with fast boot on must come last)
+} BenchColumn_T;
+
+/* GLOBAL VARIABLES */
+static const BenchColumn_T benchColumns[BENCH_COLUMNS] = { // Columns (first boot in each verification mode after install, applications verified as they were written, then the periodic full re-verification boot, then a fast boot)
+    {"off", VERIFICATION_OFF, 1, FASTBOOT_OFF},
+    {"info", VERIFICATION_APP_INFO, 1, FASTBOOT_OFF},
+    {"vectbl", VERIFICATION_VECTOR_TABLE, 1, FASTBOOT_OFF},
+    {"app", VERIFICATION_APPLICATION, 1, FASTBOOT_OFF},
+    {"full", VERIFICATION_FULL, 1, FASTBOOT_OFF},
+    {"app-recheck", VERIFICATION_APPLICATION, VERIFICATION_RECHECK_INTERVAL, FASTBOOT_OFF},
+    {"full-recheck", VERIFICATION_FULL, VERIFICATION_RECHECK_INTERVAL, FASTBOOT_OFF},
+    {"fast", VERIFICATION_FULL, 2, FASTBOOT_ON} // First boot records the application for the fast boot path
+};
+static const uint32_t benchSizes[BENCH_SIZES] = {1024, 2048, 4096, 8192, 16384, 32765, 32768, 55296}; // Application sizes (bytes)
+static const char *benchCrcBackends[BENCH_CRC_BACKENDS] = {"bytes", "word", "dma", "software"}; // CRC backend names (bytes: the HAL byte feed verification used before the CRC engine)
+static uint32_t benchCrcBackend; // CRC backend of the current CRC run
+static const uint8_t *benchCrcData; // Data of the current CRC run
+static uint32_t benchCrcLength; // Length of the current CRC run (bytes)
+static uint32_t benchCrcResult; // Checksum calculated by the current CRC run
+
+/* FUNCTIONS */
+
+static int benchLoadBaseline(const char *baselineFile, uint64_t baseline[BENCH_SIZES][BENCH_COLUMNS]) { // Load a baseline table (as printed by simBench) (0 on success)
+    FILE *file = fopen(baselineFile, "r");
+    if (file == NULL) {
+        perror("bench");
+        return -1;
+    }
+
+    char line[BENCH_LINE_LENGTH];
+    uint32_t rows = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if ((line[0] == '#') || (strncmp(line, "size", 4) == 0) || (line[0] == '\n')) {continue;} // Comments and header
+
+        char *cursor = line;
+        uint32_t size = strtoul(cursor, &cursor, 0);
+        int32_t index = -1;
+        for (uint32_t i = 0; i < BENCH_SIZES; i++) {
+            if (benchSizes[i] == size) {index = i;}
+        }
+        if (index < 0) {continue;} // Sizes that are no longer benchmarked are ignored
+
+        for (uint32_t column = 0; column < BENCH_COLUMNS; column++) {
+            baseline[index][column] = strtoull(cursor, &cursor, 0);
+        }
+        rows++;
+    }
+    fclose(file);
+
+    if (rows != BENCH_SIZES) {
+        fprintf(stderr, "bench: baseline %s has %u of %u rows\n", baselineFile, rows, BENCH_SIZES);
+        return -1;
+    }
+    return 0;
+}
+
+static void benchCrcEntry() { // Calculate the checksum of the current CRC run with its backend
+    if (benchCrcBackend == 0) {
+        CRC_HandleTypeDef crcHandle;
+        uint8_t clockEnabled = crc_hardwareBegin(&crcHandle, 0);
+        crc_hardwareFeedBytes(&crcHandle, benchCrcData, benchCrcLength);
+        benchCrcResult = crc_hardwareEnd(&crcHandle, clockEnabled);
+    } else if (benchCrcBackend == 1) {
+        benchCrcResult = crc_wordAccumulate(0, benchCrcData, benchCrcLength);
+    } else if (benchCrcBackend == 2) {
+        benchCrcResult = crc_dmaAccumulate(0, benchCrcData, benchCrcLength);
+    } else {
+        benchCrcResult = crc_softwareAccumulate(0, benchCrcData, benchCrcLength);
+    }
+}
+
+static int benchCrc(uint8_t *data) { // Run the CRC backend benchmarks over data (the largest application size), checking every backend against the reference CRC-32 (0 if all match)
+    int failures = 0;
+    printf("# CRC backend time (us, one checksum) by length (bytes, +1: one byte past a word boundary so head and tail bytes are fed separately) and backend (bytes: HAL byte feed, word, dma and software: CRC engine backends, built with %s)\n", (CRC_BACKEND == CRC_BACKEND_DMA) ? "DMA" : (CRC_BACKEND == CRC_BACKEND_SOFTWARE) ? "SOFTWARE" : "WORD");
+    printf("crc length");
+    for (uint32_t backend = 0; backend < BENCH_CRC_BACKENDS; backend++) {
+        printf(" %s", benchCrcBackends[backend]);
+    }
+    printf("\n");
+
+    for (uint32_t i = 0; i < BENCH_SIZES*2; i++) {
+        uint32_t offset = i % 2; // Aligned, then unaligned with an odd length
+        benchCrcData = data + offset;
+        benchCrcLength = benchSizes[i/2] - offset*2;
+        uint32_t expected = simCrc32(benchCrcData, benchCrcLength);
+        printf("crc %u%s", benchSizes[i/2], offset ? "+1" : "");
+        for (benchCrcBackend = 0; benchCrcBackend < BENCH_CRC_BACKENDS; benchCrcBackend++) {
+            simReset(SIM_RESET_PIN);
+            SimResult_T result = simRun(benchCrcEntry);
+            printf(" %llu", (unsigned long long) SIM_CYCLES_TO_US(result.cycles));
+            if ((result.event != SIM_EVENT_RETURNED) || (benchCrcResult != expected)) {
+                fprintf(stderr, "bench: CRC %s over %u bytes at offset %u: 0x%08X (expected 0x%08X, event %d)\n", benchCrcBackends[benchCrcBackend], benchCrcLength, offset, benchCrcResult, expected, result.event);
+                failures++;
+            }
+        }
+        printf("\n");
+    }
+    return failures;
+}
+
+int simBench(const char *baselineFile) { // Run the boot latency benchmarks (compared against baselineFile if not NULL)
+    uint64_t results[BENCH_SIZES][BENCH_COLUMNS]; // Boot latency (us)
+    uint64_t baseline[BENCH_SIZES][BENCH_COLUMNS];
+    if ((baselineFile != NULL) && (benchLoadBaseline(baselineFile, baseline) != 0)) {
+        return -1;
+    }
+
+    uint32_t maxSize = benchSizes[BENCH_SIZES - 1];
+    uint8_t *image1 = simAlloc(maxSize);
+    uint8_t *image2 = simAlloc(maxSize);
+    if ((image1 == NULL) || (image2 == NULL)) {
+        fprintf(stderr, "bench: unable to allocate application images\n");
+        return -1;
+    }
+
+    int failures = 0;
+    for (uint32_t i = 0; i < BENCH_SIZES; i++) {
+        uint32_t size = benchSizes[i];
+
+        // Factory state, first boot initialises bootloader data
+        simFlashEraseAll();
+        simReset(SIM_RESET_POWER);
+        simBoot();
+
+        // Application 2 is the newer version of application 1, so every mode should boot application 2
+        simAppFillImage(image1, 1, size, 0x1000 + i);
+        simAppFillImage(image2, 2, size, 0x2000 + i);
+        SimInstallResult_T install1 = simAppInstall(1, image1, simAppGetInfo(image1, size, 0x100, 1));
+        SimInstallResult_T install2 = simAppInstall(2, image2, simAppGetInfo(image2, size, 0x100, 2));
+        if ((install1.status != BL_OK) || (install2.status != BL_OK)) {
+            fprintf(stderr, "bench: install of %u byte applications failed (status %d, %d)\n", size, install1.status, install2.status);
+            return -1;
+        }
+
+        for (uint32_t column = 0; column < BENCH_COLUMNS; column++) {
+            if (simAppSetSetting(SIM_SETTING_VERIFICATION, benchColumns[column].mode, NULL) != BL_OK) {
+                fprintf(stderr, "bench: unable to set verification mode for %s\n", benchColumns[column].name);
+                return -1;
+            }
+            if ((benchColumns[column].fastBoot == FASTBOOT_ON) && (simAppSetSetting(SIM_SETTING_FASTBOOT, FASTBOOT_ON, NULL) != BL_OK)) {
+                fprintf(stderr, "bench: unable to turn fast boot on for %s\n", benchColumns[column].name);
+                return -1;
+            }
+
+            SimResult_T result;
+            for (uint32_t boot = 0; boot < benchColumns[column].boot; boot++) {
+                simReset(SIM_RESET_PIN);
+                result = simBoot();
+            }
+            results[i][column] = SIM_CYCLES_TO_US(result.cycles);
+            if (simBootSlot(result) != 2) {
+                fprintf(stderr, "bench: %u bytes, %s: expected app 2 to start, got app %u\n", size, benchColumns[column].name, simBootSlot(result));
+                failures++;
+            }
+        }
+    }
+
+    // Results table (can be saved as a baseline)
+    printf("# Boot latency (us, reset to application start) by application size (bytes) and verification mode (-recheck: periodic full re-verification of applications verified as they were written, fast: fast boot path)\n");
+    printf("# Cycle-cost model: %lu Hz SYSCLK, CRC %lu cycles/byte or word (HAL feed), %lu cycles/word (DMA), %lu cycles/word (software), flash read %lu cycles/word (journal scan, vector table check), double-word program %lu cycles, page erase %lu cycles\n", SIM_SYSCLK_HZ, SIM_CYCLES_CRC_BYTE, SIM_CYCLES_CRC_DMA_WORD, SIM_CYCLES_CRC_SOFTWARE_WORD, SIM_CYCLES_FLASH_READ_WORD, SIM_CYCLES_FLASH_PROGRAM, SIM_CYCLES_FLASH_ERASE);
+    printf("size");
+    for (uint32_t column = 0; column < BENCH_COLUMNS; column++) {
+        printf(" %s", benchColumns[column].name);
+    }
+    printf("\n");
+    for (uint32_t i = 0; i < BENCH_SIZES; i++) {
+        printf("%u", benchSizes[i]);
+        for (uint32_t column = 0; column < BENCH_COLUMNS; column++) {
+            printf(" %llu", (unsigned long long) results[i][column]);
+        }
+        printf("\n");
+    }
+
+    failures += benchCrc(image2);
+
+    // Regression check (1us allowance so zero-cost baselines do not trip on rounding)
+    if (baselineFile != NULL) {
+        for (uint32_t i = 0; i < BENCH_SIZES; i++) {
+            for (uint32_t column = 0; column < BENCH_COLUMNS; column++) {
+                uint64_t limit = baseline[i][column]*(100 + SIM_BENCH_TOLERANCE)/100 + 1;
+                if (results[i][column] > limit) {
+                    fprintf(stderr, "bench: regression at %u bytes, %s: %llu us (baseline %llu us)\n", benchSizes[i], benchColumns[column].name, (unsigned long long) results[i][column], (unsigned long long) baseline[i][column]);
+                    failures++;
+                }
+            }
+        }
+    }
+
+    return (failures == 0) ? 0 : -1;
+}
@@ -0,0 +1,228 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Host simulator core (implementation)
+Simulated memory, core registers, reset logic and execution contexts
+*/
+
+/* DEPENDENCIES */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include "host_sim.h"
+#include "bootloader.h"             // Bootloader .bss
+#include "async_writer.h"           // Asynchronous writer .bss
+#include "boot_stats.h"             // Boot statistics (bootloader static SRAM)
+#include "reset_cause.h"            // Reset record and application selection (bootloader static SRAM)
+#include "metadata_transaction.h"   // Metadata transaction .bss
+
+/* CONSTANT DEFINITIONS AND MACROS */
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+/* GLOBAL VARIABLES */
+SCB_Type simSCB; // Simulated system control block
+RCC_TypeDef simRCC; // Simulated reset and clock control
+uint32_t simFaultAddress; // Stacked PC the simulated hard fault handler finds (address of the faulting instruction)
+
+static uint64_t simCycles; // Simulated cycle count
+static uint32_t simClocks; // Enabled peripheral clocks (bitmask of SimClock_T)
+static uint32_t simNvicEnabled; // Enabled interrupts (bitmask of IRQn_Type)
+static uint8_t simPrimask; // Interrupts masked (PRIMASK)
+
+static ucontext_t hostContext; // Context of the caller of simRun
+static ucontext_t simContext; // Context of the simulated core
+static uint8_t *simStack; // Stack for the simulated core (low memory)
+static void (*simEntry)(void); // Entry function of the current run
+static SimResult_T simResult; // Result of the current run
+static uint8_t simRunning; // Simulated core is running (inside simRun)
+
+static uint8_t *simArena; // Low-memory arena for simAlloc
+static uint32_t simArenaUsed; // Bytes allocated from the arena
+
+/* FUNCTIONS */
+
+static void *mapLow(uint32_t size) { // Map anonymous memory in the low 2G of the address space
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    return (mem == MAP_FAILED) ? NULL : mem;
+}
+
+int simInit(const char *flashFile) { // Map the simulated flash (backed by flashFile) and SRAM at their device addresses
+    if (simFlashMap(flashFile) != 0) {
+        return -1;
+    }
+
+    // SRAM (application and bootloader static regions are contiguous)
+    uint32_t sramLen = (uint32_t) &__SRAM_LEN + (uint32_t) &__SRAM_BL_STATIC_LEN;
+    void *sram = mmap((void *) (uintptr_t) (uint32_t) &__SRAM_START, sramLen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (sram != (void *) (uintptr_t) (uint32_t) &__SRAM_START) {
+        fprintf(stderr, "host_sim: unable to map SRAM at 0x%08X\n", (uint32_t) &__SRAM_START);
+        return -1;
+    }
+
+    // Host stack and arena for simulated code (the bootloader stores addresses in 32-bit integers)
+    simStack = mapLow(SIM_STACK_SIZE);
+    simArena = mapLow(SIM_ARENA_SIZE);
+    if ((simStack == NULL) || (simArena == NULL)) {
+        fprintf(stderr, "host_sim: unable to map low memory\n");
+        return -1;
+    }
+
+    simReset(SIM_RESET_POWER);
+    return 0;
+}
+
+void simReset(SimResetCause_T cause) { // Reset the simulated device
+    if (cause == SIM_RESET_POWER) {
+        RCC->CSR = RCC_CSR_PWRRSTF | RCC_CSR_PINRSTF; // POR sets the power and pin reset flags
+        memset((void *) (uintptr_t) (uint32_t) &__SRAM_START, 0xA5, (uint32_t) &__SRAM_LEN + (uint32_t) &__SRAM_BL_STATIC_LEN); // SRAM contents are undefined after power-up
+        memset(&bootStats, 0xA5, sizeof(bootStats)); // Bootloader static SRAM variables are host variables in the simulator
+        memset(&resetRecord, 0xA5, sizeof(resetRecord));
+        appSelection = 0xA5;
+    } else if (cause == SIM_RESET_PIN) {
+        RCC->CSR |= RCC_CSR_PINRSTF;
+    } else if (cause == SIM_RESET_SOFTWARE) {
+        RCC->CSR |= RCC_CSR_SFTRSTF | RCC_CSR_PINRSTF; // Internal resets also drive NRST
+    } else if (cause == SIM_RESET_IWDG) {
+        RCC->CSR |= RCC_CSR_IWDGRSTF | RCC_CSR_PINRSTF;
+    } else if (cause == SIM_RESET_WWDG) {
+        RCC->CSR |= RCC_CSR_WWDGRSTF | RCC_CSR_PINRSTF;
+    } else if (cause == SIM_RESET_LOWPOWER) {
+        RCC->CSR |= RCC_CSR_LPWRRSTF | RCC_CSR_PINRSTF;
+    } else if (cause == SIM_RESET_OPTION_BYTES) {
+        RCC->CSR |= RCC_CSR_OBLRSTF | RCC_CSR_PINRSTF;
+    }
+
+    SCB->VTOR = FLASH_BASE;
+    RCC->IOPENR = 0;
+    RCC->AHBENR = 0;
+    RCC->APBENR1 = 0;
+    simClocks = 0;
+    simNvicEnabled = 0;
+    simPrimask = 0;
+    memset(writeChecksum, 0, sizeof(writeChecksum)); // Bootloader .bss (zeroed by the startup code on the device)
+    erasedPageCount = 0;
+    activeAsyncWriter = NULL;
+    currentBootloaderData = NULL;
+    memset(&metadataTransaction, 0, sizeof(metadataTransaction));
+    simFlashReset();
+    simCrcReset();
+    simIwdgReset();
+    simUsartReset();
+}
+
+static void simTrampoline() { // Run the entry function on the simulated core
+    simEntry();
+    simExit(SIM_EVENT_RETURNED);
+}
+
+SimResult_T simRun(void (*entry)(void)) { // Run entry on the simulated core until it returns, starts an application, stalls or is reset
+    memset(&simResult, 0, sizeof(simResult));
+    uint64_t startCycles = simCycles;
+    simEntry = entry;
+
+    getcontext(&simContext);
+    simContext.uc_stack.ss_sp = simStack;
+    simContext.uc_stack.ss_size = SIM_STACK_SIZE;
+    simContext.uc_link = NULL;
+    makecontext(&simContext, simTrampoline, 0);
+    simRunning = 1;
+    swapcontext(&hostContext, &simContext);
+    simRunning = 0;
+
+    simResult.cycles = simCycles - startCycles;
+    return simResult;
+}
+
+void simExit(SimEvent_T event) { // End the current simulator run
+    simResult.event = event;
+    if (simRunning) {
+        setcontext(&hostContext);
+    }
+}
+
+void simAdvanceCycles(uint64_t cycles) { // Advance simulated time (takes the flash interrupt when it becomes due, checks for watchdog expiry)
+    uint64_t end = simCycles + cycles;
+    uint64_t due;
+    while (!simPrimask && simFlashIrqDue(end, &due)) { // Interrupt taken part way through (handler time overlaps the time passing)
+        if (due > simCycles) {simCycles = due;}
+        simFlashIrq();
+    }
+    if (end > simCycles) {simCycles = end;}
+    simIwdgCheck(simCycles);
+}
+
+uint64_t simGetCycles() { // Get the simulated cycle count
+    return simCycles;
+}
+
+void *simAlloc(uint32_t size) { // Allocate a buffer addressable by the simulated core (32-bit address)
+    size = (size + 7) & ~7U; // Keep allocations double-word aligned
+    if (simArenaUsed + size > SIM_ARENA_SIZE) {
+        return NULL;
+    }
+    void *mem = simArena + simArenaUsed;
+    simArenaUsed += size;
+    return mem;
+}
+
+void simClockEnable(SimClock_T clock) { // Enable a peripheral clock
+    simClocks |= (1U << clock);
+}
+
+void simClockDisable(SimClock_T clock) { // Disable a peripheral clock
+    simClocks &= ~(1U << clock);
+}
+
+uint8_t simClockIsEnabled(SimClock_T clock) { // Check whether a peripheral clock is enabled
+    return (simClocks & (1U << clock)) != 0;
+}
+
+void simWaitForInterrupt(void) { // Sleep until the flash interrupt is taken (stalls the simulated core if no interrupt can come)
+    uint64_t due;
+    if (simPrimask || !simFlashIrqDue(UINT64_MAX, &due)) {
+        simExit(SIM_EVENT_STALLED);
+    }
+    simAdvanceCycles((due > simCycles) ? due - simCycles : 0);
+}
+
+void simNvicEnableIRQ(IRQn_Type irq) { // Enable an interrupt in the simulated NVIC
+    simNvicEnabled |= 1UL << irq;
+}
+
+void simNvicDisableIRQ(IRQn_Type irq) { // Disable an interrupt in the simulated NVIC
+    simNvicEnabled &= ~(1UL << irq);
+}
+
+uint8_t simNvicIsEnabled(IRQn_Type irq) { // Check whether an interrupt is enabled in the simulated NVIC
+    return (simNvicEnabled & (1UL << irq)) != 0;
+}
+
+void simSetPrimask(uint8_t masked) { // Mask or unmask interrupts on the simulated core
+    simPrimask = masked;
+    if (!masked) {simAdvanceCycles(0);} // Take an interrupt that became due while masked
+}
+
+uint8_t simGetPrimask(void) { // Get whether interrupts are masked on the simulated core
+    return simPrimask;
+}
+
+void simSystemReset(void) { // Software reset of the simulated device (ends the current simulator run)
+    simReset(SIM_RESET_SOFTWARE);
+    simExit(SIM_EVENT_SOFTWARE_RESET);
+}
+
+void hardFaultHandler(void) { // Simulated bootloader hard fault handler (the stacked PC is simFaultAddress)
+    resetCause_recordHardFault(simFaultAddress);
+}
+
+void startApplication(uint32_t stackPointer, uint32_t startupAddress) { // Simulated application start (records the jump)
+    simResult.stackPointer = stackPointer;
+    simResult.startupAddress = startupAddress;
+    simResult.vectorTable = SCB->VTOR;
+    simExit(SIM_EVENT_APP_STARTED);
+}
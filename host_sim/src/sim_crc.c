@@ -0,0 +1,170 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Host simulator CRC (implementation)
+Simulated STM32G0 CRC calculation unit (32-bit polynomial, input/output bit reversal) and DMA1 channel 2 memory to memory transfers feeding it
+*/
+
+/* DEPENDENCIES */
+#include <string.h>
+#include "host_sim.h"
+
+/* CONSTANT DEFINITIONS AND MACROS */
+#define CRC_CR_RESET (0x1UL << 0) // Reset CRC calculation unit
+#define CRC_CR_REV_IN_Msk (0x3UL << 5) // Input reversal mode
+#define CRC_CR_REV_OUT (0x1UL << 7) // Output reversal
+
+/* GLOBAL VARIABLES */
+CRC_TypeDef simCRC; // Simulated CRC registers (DR holds the internal, unreversed CRC value)
+static DMA_TypeDef dma1; // Simulated DMA1 status registers (channel 2 flags)
+static DMA_Channel_TypeDef dmaChannel2; // Simulated DMA1 channel 2 registers
+
+/* FUNCTIONS */
+
+static uint32_t reverseBits(uint32_t value, uint32_t bits) { // Reverse the order of the lowest bits bits of value
+    uint32_t result = 0;
+    for (uint32_t i = 0; i < bits; i++) {
+        result = (result << 1) | ((value >> i) & 1);
+    }
+    return result;
+}
+
+static uint32_t reverseInput(uint32_t value, uint32_t bits) { // Apply the configured input reversal to a bits-wide write
+    uint32_t mode = simCRC.CR & CRC_CR_REV_IN_Msk;
+    uint32_t unit = (mode == CRC_INPUTDATA_INVERSION_BYTE) ? 8 : (mode == CRC_INPUTDATA_INVERSION_HALFWORD) ? 16 : (mode == CRC_INPUTDATA_INVERSION_WORD) ? 32 : 0;
+    if (unit == 0) {return value;}
+    if (unit > bits) {unit = bits;}
+
+    uint32_t result = 0;
+    for (uint32_t shift = 0; shift < bits; shift += unit) {
+        result |= reverseBits(value >> shift, unit) << shift;
+    }
+    return result;
+}
+
+static void crcFeed(uint32_t value, uint32_t bits) { // Write bits bits of data to the CRC data register
+    value = reverseInput(value, bits);
+    uint32_t crc = simCRC.DR;
+    for (int32_t i = bits - 1; i >= 0; i--) { // Data is processed MSB first
+        uint32_t bit = ((crc >> 31) ^ (value >> i)) & 1;
+        crc <<= 1;
+        if (bit) {crc ^= simCRC.POL;}
+    }
+    simCRC.DR = crc;
+}
+
+static uint32_t crcRead() { // Read the CRC data register
+    if (!simClockIsEnabled(SIM_CLOCK_CRC)) {return 0;} // Clock gated peripheral reads as zero
+    return (simCRC.CR & CRC_CR_REV_OUT) ? reverseBits(simCRC.DR, 32) : simCRC.DR;
+}
+
+uint32_t simReverseBits(uint32_t value) { // Reverse the bit order of a word
+    return reverseBits(value, 32);
+}
+
+void simCrcReset() { // Reset the CRC peripheral and DMA1 channel 2
+    simCRC.DR = 0xFFFFFFFF;
+    simCRC.CR = 0;
+    simCRC.INIT = 0xFFFFFFFF;
+    simCRC.POL = DEFAULT_CRC32_POLY;
+    memset(&dma1, 0, sizeof(dma1));
+    memset(&dmaChannel2, 0, sizeof(dmaChannel2));
+}
+
+void simCrcSoftware(uint32_t length) { // Let the time a software CRC over length bytes takes pass (the host runs the loop for free)
+    simAdvanceCycles((uint64_t)(length/4)*SIM_CYCLES_CRC_SOFTWARE_WORD + (length%4)*SIM_CYCLES_CRC_SOFTWARE_BYTE);
+}
+
+DMA_Channel_TypeDef *simDmaChannel2(void) { // DMA1 channel 2 registers (memory to memory transfers to the CRC unit)
+    return &dmaChannel2;
+}
+
+DMA_TypeDef *simDma1(void) { // DMA1 status registers (runs a memory to memory transfer enabled on channel 2 and applies flag clears)
+    dma1.ISR &= ~dma1.IFCR; // Flag clears written since the last access
+    dma1.IFCR = 0;
+    simAdvanceCycles(SIM_CYCLES_PERIPHERAL_ACCESS);
+
+    if ((dmaChannel2.CCR & DMA_CCR_EN) && (dmaChannel2.CCR & DMA_CCR_MEM2MEM) && dmaChannel2.CNDTR > 0) { // Transfer enabled since the last access, run it to completion
+        if (!(simRCC.AHBENR & RCC_AHBENR_DMA1EN)) { // Clock gated DMA never transfers, polling for completion would never end
+            simExit(SIM_EVENT_STALLED);
+        }
+        uint32_t *memory = (uint32_t *) (uintptr_t) dmaChannel2.CMAR; // Word transfers from memory (DIR set: memory is the source)
+        uint8_t toCrc = (dmaChannel2.CPAR == (uint32_t) (uintptr_t) &simCRC.DR) && simClockIsEnabled(SIM_CLOCK_CRC);
+        simAdvanceCycles((uint64_t) dmaChannel2.CNDTR*SIM_CYCLES_CRC_DMA_WORD);
+        for (uint32_t i = 0; i < dmaChannel2.CNDTR; i++) {
+            if (toCrc) {crcFeed(memory[i], 32);}
+        }
+        dmaChannel2.CNDTR = 0;
+        dma1.ISR |= DMA_ISR_GIF2 | DMA_ISR_TCIF2;
+    }
+    return &dma1;
+}
+
+uint32_t simCrc32(const uint8_t *data, uint32_t length) { // Standard CRC-32 (as binascii.crc32) of a host buffer
+    uint32_t crc = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (uint32_t b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+        }
+    }
+    return ~crc;
+}
+
+HAL_StatusTypeDef HAL_CRC_Init(CRC_HandleTypeDef *hcrc) { // Initialise the CRC unit from the handle configuration
+    if (hcrc == NULL) {return HAL_ERROR;}
+    simAdvanceCycles(SIM_CYCLES_CRC_INIT);
+    if (!simClockIsEnabled(SIM_CLOCK_CRC)) { // Register writes are lost without a clock
+        hcrc->State = HAL_CRC_STATE_READY;
+        return HAL_OK;
+    }
+
+    simCRC.POL = (hcrc->Init.DefaultPolynomialUse == DEFAULT_POLYNOMIAL_ENABLE) ? DEFAULT_CRC32_POLY : hcrc->Init.GeneratingPolynomial;
+    simCRC.INIT = (hcrc->Init.DefaultInitValueUse == DEFAULT_INIT_VALUE_ENABLE) ? DEFAULT_CRC_INITVALUE : hcrc->Init.InitValue;
+    simCRC.CR = hcrc->Init.InputDataInversionMode | hcrc->Init.OutputDataInversionMode;
+    simCRC.DR = simCRC.INIT;
+    hcrc->State = HAL_CRC_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CRC_DeInit(CRC_HandleTypeDef *hcrc) { // De-initialise the CRC unit
+    if (hcrc == NULL) {return HAL_ERROR;}
+    simCrcReset();
+    hcrc->State = HAL_CRC_STATE_RESET;
+    return HAL_OK;
+}
+
+uint32_t HAL_CRC_Accumulate(CRC_HandleTypeDef *hcrc, uint32_t pBuffer[], uint32_t BufferLength) { // Feed data to the CRC unit without resetting it
+    if (hcrc->InputDataFormat == CRC_INPUTDATA_FORMAT_WORDS) {
+        simAdvanceCycles((uint64_t) BufferLength*SIM_CYCLES_CRC_WORD);
+        for (uint32_t i = 0; i < BufferLength; i++) {
+            crcFeed(pBuffer[i], 32);
+        }
+    } else if (hcrc->InputDataFormat == CRC_INPUTDATA_FORMAT_HALFWORDS) {
+        uint16_t *halfwords = (uint16_t *) pBuffer;
+        simAdvanceCycles((uint64_t) BufferLength*SIM_CYCLES_CRC_HALFWORD);
+        for (uint32_t i = 0; i < BufferLength; i++) {
+            crcFeed(halfwords[i], 16);
+        }
+    } else if (hcrc->InputDataFormat == CRC_INPUTDATA_FORMAT_BYTES) {
+        uint8_t *bytes = (uint8_t *) pBuffer;
+        simAdvanceCycles((uint64_t) BufferLength*SIM_CYCLES_CRC_BYTE);
+        for (uint32_t i = 0; i < BufferLength; i++) {
+            crcFeed(bytes[i], 8);
+        }
+    }
+    return crcRead();
+}
+
+HAL_StatusTypeDef HAL_CRCEx_Input_Data_Reverse(CRC_HandleTypeDef *hcrc, uint32_t InputReverseMode) { // Change the input reversal mode without resetting the calculation
+    if (hcrc == NULL) {return HAL_ERROR;}
+    if (simClockIsEnabled(SIM_CLOCK_CRC)) {simCRC.CR = (simCRC.CR & ~CRC_CR_REV_IN_Msk) | (InputReverseMode & CRC_CR_REV_IN_Msk);}
+    hcrc->Init.InputDataInversionMode = InputReverseMode;
+    return HAL_OK;
+}
+
+uint32_t HAL_CRC_Calculate(CRC_HandleTypeDef *hcrc, uint32_t pBuffer[], uint32_t BufferLength) { // Reset the CRC unit and feed data to it
+    simCRC.DR = simCRC.INIT;
+    return HAL_CRC_Accumulate(hcrc, pBuffer, BufferLength);
+}
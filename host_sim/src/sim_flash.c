@@ -0,0 +1,386 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Host simulator flash (implementation)
+Simulated STM32G0 flash controller (page erase, double-word and fast row programming, interrupt-driven and register-level operations, error flags, power cuts) backed by a memory-mapped file
+*/
+
+/* DEPENDENCIES */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "host_sim.h"
+
+/* CONSTANT DEFINITIONS AND MACROS */
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+#define FLASH_START ((uint32_t) &__FLASH_BL_CORE_START) // Start of simulated flash
+#define FLASH_END ((uint32_t) &__FLASH_BL_DATA_B_START + (uint32_t) &__FLASH_BL_DATA_B_LEN) // End of simulated flash (bootloader data page B is the last page)
+#define FLASH_ERASED_DW 0xFFFFFFFFFFFFFFFFULL // Erased double-word
+
+/* GLOBAL VARIABLES */
+static uint8_t *flashWrite; // Writable view of the flash backing file (the device address view is read-only)
+static uint8_t flashLocked; // Flash control register lock
+static uint32_t flashFlags; // Flash status register flags
+static SimFlashStats_T flashStats; // Flash operation statistics
+static uint32_t flashPowerCut; // Flash operations until power is cut (0 if disarmed)
+static uint32_t flashProcedure; // Interrupt-driven operation in progress (FLASH_TYPEERASE_PAGES, FLASH_TYPEPROGRAM_DOUBLEWORD or FLASH_TYPEPROGRAM_FAST, 0 if none) (HAL lock held until it ends)
+static uint32_t flashProcedureParameter; // Page being erased or address being programmed (passed to the HAL callbacks)
+static uint32_t flashPagesLeft; // Pages left to erase in an interrupt-driven erase (the page being erased included)
+static uint64_t flashBusyUntil; // Cycle count at which the interrupt-driven operation in progress ends
+static void (*flashIrqHandler)(void); // Application FLASH_IRQHandler (vector table entry, NULL if none)
+static uint8_t flashIrqActive; // Flash interrupt handler running (not re-entered)
+static FLASH_TypeDef flashRegisters; // Flash status and control registers (register-level operations, RAM flash routines)
+static uint32_t flashLatch[FLASH_ROW_SIZE*2]; // Words written to flash memory for the double-word or fast programming row being started (simulator addressable)
+static uint32_t flashLatchAddress; // Address of the first word written
+static uint32_t flashLatchCount; // Words written
+
+/* FUNCTIONS */
+
+int simFlashMap(const char *flashFile) { // Map the flash backing file at the device flash address
+    uint32_t flashLen = FLASH_END - FLASH_START;
+
+    int fd = open(flashFile, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror("host_sim: flash file");
+        return -1;
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+    if ((uint32_t) st.st_size < flashLen) { // New (or short) flash file, extend with erased flash
+        uint8_t erased[FLASH_PAGE_SIZE];
+        memset(erased, 0xFF, sizeof(erased));
+        lseek(fd, 0, SEEK_END);
+        for (uint32_t len = st.st_size; len < flashLen; len += sizeof(erased)) {
+            if (write(fd, erased, (flashLen - len) < sizeof(erased) ? (flashLen - len) : sizeof(erased)) < 0) {
+                perror("host_sim: flash file");
+                close(fd);
+                return -1;
+            }
+        }
+    }
+
+    // Device address view (read-only, as flash is only written through the controller)
+    void *flash = mmap((void *) (uintptr_t) FLASH_START, flashLen, PROT_READ, MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+    if (flash != (void *) (uintptr_t) FLASH_START) {
+        fprintf(stderr, "host_sim: unable to map flash at 0x%08X\n", FLASH_START);
+        close(fd);
+        return -1;
+    }
+
+    // Controller view
+    flashWrite = mmap(NULL, flashLen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (flashWrite == MAP_FAILED) {
+        fprintf(stderr, "host_sim: unable to map flash file\n");
+        return -1;
+    }
+
+    simFlashReset();
+    return 0;
+}
+
+void simFlashReset() { // Reset the flash controller (locked, flags cleared, no operation in progress)
+    flashLocked = 1;
+    flashFlags = 0;
+    flashProcedure = 0;
+    flashIrqActive = 0;
+    memset(&flashRegisters, 0, sizeof(flashRegisters));
+    flashLatchCount = 0;
+}
+
+void simFlashSetIrqHandler(void (*handler)(void)) { // Set the application FLASH_IRQHandler (NULL for none)
+    flashIrqHandler = handler;
+}
+
+uint8_t simFlashIrqDue(uint64_t cycles, uint64_t *due) { // Check whether the flash interrupt will be taken by cycles (enabled, handler set, interrupt-driven operation ending), due is set to when
+    if (!flashProcedure || flashIrqActive || flashIrqHandler == NULL || !simNvicIsEnabled(FLASH_IRQn) || flashBusyUntil > cycles) {return 0;}
+    *due = flashBusyUntil;
+    return 1;
+}
+
+void simFlashIrq() { // Take the flash interrupt (runs the application FLASH_IRQHandler)
+    flashIrqActive = 1;
+    simAdvanceCycles(SIM_CYCLES_INTERRUPT);
+    flashIrqHandler();
+    flashIrqActive = 0;
+    if (flashProcedure && flashBusyUntil <= simGetCycles()) { // Operation end not handled, the interrupt would be taken again forever
+        simExit(SIM_EVENT_STALLED);
+    }
+}
+
+void simFlashEraseAll() { // Erase the entire simulated flash (factory state)
+    memset(flashWrite, 0xFF, FLASH_END - FLASH_START);
+}
+
+SimFlashStats_T simFlashGetStats() { // Get flash operation statistics
+    return flashStats;
+}
+
+void simFlashResetStats() { // Reset flash operation statistics
+    memset(&flashStats, 0, sizeof(flashStats));
+}
+
+void simFlashSetPowerCut(uint32_t operation) { // Cut power during the operation'th flash operation from now (tearing it and ending the run), 0 to disarm
+    flashPowerCut = operation;
+}
+
+uint32_t simFlashSize() { // Size of the simulated flash (bytes)
+    return FLASH_END - FLASH_START;
+}
+
+void simFlashSave(uint8_t *buffer) { // Copy the simulated flash contents to buffer (simFlashSize bytes)
+    memcpy(buffer, flashWrite, FLASH_END - FLASH_START);
+}
+
+void simFlashLoad(const uint8_t *buffer) { // Restore the simulated flash contents from buffer (simFlashSize bytes)
+    memcpy(flashWrite, buffer, FLASH_END - FLASH_START);
+}
+
+void simFlashCorrupt(uint32_t address) { // Flip the lowest bit of the flash byte at address (data corrupted in place, no flash operation)
+    if (address < FLASH_START || address >= FLASH_END) {return;}
+    flashWrite[address - FLASH_START] ^= 0x01;
+}
+
+static uint8_t flashOperation() { // Start a program or erase operation (1 if power is cut during it)
+    flashStats.operations++;
+    if (flashPowerCut == 0) {return 0;}
+    flashPowerCut--;
+    return flashPowerCut == 0;
+}
+
+static void flashPowerLost() { // Power cut during a flash operation (the torn operation has been applied)
+    simExit(SIM_EVENT_POWER_LOST);
+}
+
+static HAL_StatusTypeDef flashError(uint32_t flags) { // Record a failed flash operation
+    flashFlags |= flags;
+    flashStats.errors++;
+    return HAL_ERROR;
+}
+
+static HAL_StatusTypeDef flashWaitForLastOperation() { // Check for errors left by a previous operation (HAL reports and clears them)
+    if (flashFlags & FLASH_FLAG_ALL_ERRORS) {
+        flashFlags &= ~FLASH_FLAG_ALL_ERRORS;
+        flashStats.errors++;
+        return HAL_ERROR;
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void) { // Unlock the flash control register
+    flashLocked = 0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void) { // Lock the flash control register
+    flashLocked = 1;
+    return HAL_OK;
+}
+
+uint32_t simFlashGetFlags(void) { // Get flash status register flags
+    return flashFlags;
+}
+
+void simFlashClearFlags(uint32_t flags) { // Clear flash status register flags
+    flashFlags &= ~flags;
+}
+
+void simFlashRead(uint32_t words) { // Let the time the core takes to read and test words of flash pass (the host reads them for free)
+    simAdvanceCycles((uint64_t) words*SIM_CYCLES_FLASH_READ_WORD);
+}
+
+static void flashBusy(uint64_t cycles, uint8_t wait) { // Flash controller busy with an operation for cycles (waited for, or ending at flashBusyUntil)
+    if (wait) {
+        simAdvanceCycles(cycles);
+    } else {
+        flashBusyUntil = simGetCycles() + cycles;
+    }
+}
+
+static HAL_StatusTypeDef flashProgram(uint32_t TypeProgram, uint32_t Address, uint64_t Data, uint8_t wait) { // Program a double-word or a fast programming row (waiting for it to end, or leaving the controller busy until it does)
+    if (flashLocked) {return flashError(FLASH_FLAG_PGSERR);} // Control register writes are ignored while locked
+
+    if (TypeProgram == FLASH_TYPEPROGRAM_DOUBLEWORD) {
+        if (Address % 8) {return flashError(FLASH_FLAG_PGAERR);}
+        if ((Address < FLASH_START) || (Address + 8 > FLASH_END)) {return flashError(FLASH_FLAG_PGSERR);}
+
+        uint64_t current;
+        memcpy(&current, flashWrite + (Address - FLASH_START), 8);
+        flashBusy(SIM_CYCLES_FLASH_PROGRAM, wait);
+        if ((current != FLASH_ERASED_DW) && (Data != 0)) { // Only erased double-words (or a write of all zeros) can be programmed
+            return flashError(FLASH_FLAG_PROGERR);
+        }
+        if (flashOperation()) { // Torn program, only the first word reaches flash
+            uint32_t word = (uint32_t) Data;
+            memcpy(flashWrite + (Address - FLASH_START), &word, 4);
+            flashPowerLost();
+        }
+        memcpy(flashWrite + (Address - FLASH_START), &Data, 8);
+        flashStats.doubleWordsProgrammed++;
+        flashFlags |= FLASH_FLAG_EOP;
+        return HAL_OK;
+    }
+
+    if (TypeProgram == FLASH_TYPEPROGRAM_FAST) { // Data holds the (32-bit) address of the 32 source double-words
+        uint32_t rowSize = FLASH_ROW_SIZE*8;
+        if (Address % rowSize) {return flashError(FLASH_FLAG_PGAERR);}
+        if ((Address < FLASH_START) || (Address + rowSize > FLASH_END)) {return flashError(FLASH_FLAG_PGSERR);}
+
+        uint8_t *target = flashWrite + (Address - FLASH_START);
+        flashBusy(SIM_CYCLES_FLASH_FAST_ROW, wait);
+        for (uint32_t i = 0; i < rowSize; i++) { // The whole row must be erased
+            if (target[i] != 0xFF) {
+                return flashError(FLASH_FLAG_FASTERR);
+            }
+        }
+        if (flashOperation()) { // Torn row, only the first half reaches flash
+            memcpy(target, (const void *) (uintptr_t) (uint32_t) Data, rowSize/2);
+            flashPowerLost();
+        }
+        memcpy(target, (const void *) (uintptr_t) (uint32_t) Data, rowSize);
+        flashStats.rowsFastProgrammed++;
+        flashStats.doubleWordsProgrammed += FLASH_ROW_SIZE;
+        flashFlags |= FLASH_FLAG_EOP;
+        return HAL_OK;
+    }
+
+    return flashError(FLASH_FLAG_PGSERR);
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data) { // Program a double-word or a fast programming row
+    if (flashProcedure) {return HAL_BUSY;} // HAL locked by an interrupt-driven operation
+    if (flashWaitForLastOperation() != HAL_OK) {return HAL_ERROR;}
+    return flashProgram(TypeProgram, Address, Data, 1);
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program_IT(uint32_t TypeProgram, uint32_t Address, uint64_t Data) { // Start programming a double-word or a fast programming row, ended by the flash interrupt (errors are reported there)
+    if (flashProcedure) {return HAL_BUSY;}
+    if (flashWaitForLastOperation() != HAL_OK) {return HAL_ERROR;}
+    flashProcedure = TypeProgram;
+    flashProcedureParameter = Address;
+    flashBusyUntil = simGetCycles();
+    if (TypeProgram == FLASH_TYPEPROGRAM_FAST) { // HAL FLASH_Program_Fast writes the row with interrupts masked and the core stalls on flash until it is programmed, only the end of operation interrupt is left
+        uint8_t primask = __get_PRIMASK();
+        __disable_irq();
+        flashProgram(TypeProgram, Address, Data, 1);
+        flashBusyUntil = simGetCycles();
+        __set_PRIMASK(primask);
+        return HAL_OK;
+    }
+    flashProgram(TypeProgram, Address, Data, 0);
+    return HAL_OK;
+}
+
+static HAL_StatusTypeDef flashErasePage(uint32_t page, uint8_t wait) { // Erase a flash page (waiting for it to end, or leaving the controller busy until it does)
+    uint32_t pageAddress = FLASH_BASE + page*FLASH_PAGE_SIZE;
+    if ((pageAddress < FLASH_START) || (pageAddress + FLASH_PAGE_SIZE > FLASH_END)) {
+        return flashError(FLASH_FLAG_PGSERR);
+    }
+    flashBusy(SIM_CYCLES_FLASH_ERASE, wait);
+    if (flashOperation()) { // Torn erase, only the first half of the page is erased
+        memset(flashWrite + (pageAddress - FLASH_START), 0xFF, FLASH_PAGE_SIZE/2);
+        flashPowerLost();
+    }
+    memset(flashWrite + (pageAddress - FLASH_START), 0xFF, FLASH_PAGE_SIZE);
+    flashStats.pagesErased++;
+    flashFlags |= FLASH_FLAG_EOP;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError) { // Erase flash pages
+    *PageError = 0xFFFFFFFF;
+    if (flashProcedure) {return HAL_BUSY;} // HAL locked by an interrupt-driven operation
+    if (flashWaitForLastOperation() != HAL_OK) {return HAL_ERROR;}
+    if (flashLocked) {return flashError(FLASH_FLAG_PGSERR);}
+    if (pEraseInit->TypeErase != FLASH_TYPEERASE_PAGES) {return flashError(FLASH_FLAG_PGSERR);}
+
+    for (uint32_t page = pEraseInit->Page; page < pEraseInit->Page + pEraseInit->NbPages; page++) {
+        if (flashErasePage(page, 1) != HAL_OK) {
+            *PageError = page;
+            return HAL_ERROR;
+        }
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase_IT(FLASH_EraseInitTypeDef *pEraseInit) { // Start erasing flash pages, each ended by the flash interrupt (errors are reported there)
+    if (flashProcedure) {return HAL_BUSY;}
+    if (flashWaitForLastOperation() != HAL_OK) {return HAL_ERROR;}
+    if (flashLocked) {return flashError(FLASH_FLAG_PGSERR);}
+    if (pEraseInit->TypeErase != FLASH_TYPEERASE_PAGES || pEraseInit->NbPages == 0) {return flashError(FLASH_FLAG_PGSERR);}
+    flashProcedure = FLASH_TYPEERASE_PAGES;
+    flashProcedureParameter = pEraseInit->Page;
+    flashPagesLeft = pEraseInit->NbPages;
+    flashBusyUntil = simGetCycles();
+    flashErasePage(flashProcedureParameter, 0);
+    return HAL_OK;
+}
+
+FLASH_TypeDef *simFlashRegisters(void) { // Flash registers (a page erase set up in the control register starts, accesses let simulated time pass while an operation is busy)
+    if (flashRegisters.CR & FLASH_CR_STRT) { // Start bit set since the last access
+        flashRegisters.CR &= ~FLASH_CR_STRT;
+        if (flashLocked || !(flashRegisters.CR & FLASH_CR_PER)) {
+            flashError(FLASH_FLAG_PGSERR);
+        } else {
+            flashErasePage((flashRegisters.CR & FLASH_CR_PNB) >> FLASH_CR_PNB_Pos, 0);
+        }
+    }
+    uint8_t busy = flashBusyUntil > simGetCycles();
+    if (busy) {simAdvanceCycles(SIM_CYCLES_PERIPHERAL_ACCESS);} // Polled until the operation ends
+    flashRegisters.SR = flashFlags | (busy ? FLASH_SR_BSY1 : 0); // Flags are cleared with __HAL_FLASH_CLEAR_FLAG, not register writes
+    return &flashRegisters;
+}
+
+void simFlashWriteWord(uint32_t address, uint32_t word) { // Word write to flash memory (programs a double-word, or a fast programming row, once all of it is written with PG or FSTPG set)
+    uint32_t control = flashRegisters.CR;
+    if (flashLocked || !(control & (FLASH_CR_PG | FLASH_CR_FSTPG))) { // Not programming, the write is a sequence error
+        flashLatchCount = 0;
+        flashError(FLASH_FLAG_PGSERR);
+        return;
+    }
+    if (flashLatchCount == 0) {flashLatchAddress = address;}
+    if (address != flashLatchAddress + 4*flashLatchCount) { // Words must follow each other
+        flashLatchCount = 0;
+        flashError(FLASH_FLAG_PGSERR);
+        return;
+    }
+    flashLatch[flashLatchCount++] = word;
+
+    if ((control & FLASH_CR_PG) && (flashLatchCount == 2)) { // Double-word complete
+        flashLatchCount = 0;
+        flashProgram(FLASH_TYPEPROGRAM_DOUBLEWORD, flashLatchAddress, flashLatch[0] | ((uint64_t) flashLatch[1] << 32), 0);
+    } else if ((control & FLASH_CR_FSTPG) && (flashLatchCount == FLASH_ROW_SIZE*2)) { // Row complete
+        flashLatchCount = 0;
+        flashProgram(FLASH_TYPEPROGRAM_FAST, flashLatchAddress, (uint32_t) (uintptr_t) flashLatch, 0);
+    }
+}
+
+void HAL_FLASH_IRQHandler(void) { // Flash interrupt, ends the interrupt-driven operation (HAL callbacks, called for each page of an erase) and releases the HAL lock
+    if (!flashProcedure || flashBusyUntil > simGetCycles()) {return;} // Nothing has ended
+    uint32_t parameter = flashProcedureParameter;
+
+    if (flashFlags & FLASH_FLAG_ALL_ERRORS) { // Operation failed, procedure stopped
+        flashFlags &= ~FLASH_FLAG_ALL_ERRORS;
+        flashProcedure = 0;
+        HAL_FLASH_OperationErrorCallback(parameter);
+        return;
+    }
+
+    flashFlags &= ~FLASH_FLAG_EOP;
+    if (flashProcedure == FLASH_TYPEERASE_PAGES && --flashPagesLeft) { // Erase the next page
+        flashProcedureParameter++;
+        flashErasePage(flashProcedureParameter, 0);
+    } else {
+        flashProcedure = 0;
+    }
+    HAL_FLASH_EndOfOperationCallback(parameter);
+}
@@ -0,0 +1,56 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Host simulator IWDG (implementation)
+Simulated STM32G0 independent watchdog (clocked from the LSI)
+*/
+
+/* DEPENDENCIES */
+#include "host_sim.h"
+
+/* CONSTANT DEFINITIONS AND MACROS */
+
+
+/* GLOBAL VARIABLES */
+IWDG_TypeDef simIWDG; // Simulated IWDG registers
+
+static uint8_t iwdgRunning; // Watchdog has been started (it can only be stopped by a reset)
+static uint64_t iwdgDeadline; // Cycle count at which the watchdog expires
+
+/* FUNCTIONS */
+
+static uint64_t iwdgTimeout() { // Watchdog timeout in simulated cycles
+    uint64_t lsiTicks = ((uint64_t) 4 << simIWDG.PR)*(simIWDG.RLR + 1);
+    return lsiTicks*SIM_SYSCLK_HZ/SIM_LSI_HZ;
+}
+
+void simIwdgReset() { // Stop the watchdog (reset)
+    iwdgRunning = 0;
+    simIWDG.PR = IWDG_PRESCALER_4;
+    simIWDG.RLR = 0x0FFF;
+}
+
+void simIwdgCheck(uint64_t cycles) { // Expire the watchdog if its timeout has elapsed at cycles
+    if (iwdgRunning && (cycles >= iwdgDeadline)) {
+        simReset(SIM_RESET_IWDG);
+        simExit(SIM_EVENT_WATCHDOG_RESET);
+    }
+}
+
+HAL_StatusTypeDef HAL_IWDG_Init(IWDG_HandleTypeDef *hiwdg) { // Start the watchdog with the handle configuration
+    if (hiwdg == NULL) {return HAL_ERROR;}
+    simAdvanceCycles(SIM_CYCLES_IWDG_INIT);
+    simIWDG.PR = hiwdg->Init.Prescaler;
+    simIWDG.RLR = hiwdg->Init.Reload;
+    iwdgDeadline = simGetCycles() + iwdgTimeout();
+    iwdgRunning = 1;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_IWDG_Refresh(IWDG_HandleTypeDef *hiwdg) { // Reload the watchdog counter
+    if (iwdgRunning) {
+        iwdgDeadline = simGetCycles() + iwdgTimeout();
+    }
+    return HAL_OK;
+}
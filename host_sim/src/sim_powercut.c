@@ -0,0 +1,150 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Host simulator power-cut fuzzing (implementation)
+Cuts power at every flash operation of bootloader data updates and boots (boot tick marks and fast boot marks), at every journal fill level, and checks that the bootloader always comes back with either the old or the new settings
+*/
+
+/* DEPENDENCIES */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host_sim.h"
+#include "bootloader.h"             // Bootloader data journal layout
+
+/* CONSTANT DEFINITIONS AND MACROS */
+#define POWERCUT_APP_SIZE 1024      // Size of the installed test applications (bytes)
+#define POWERCUT_FILL_LEVELS (BL_JOURNAL_MAX_RECORDS + 2) // Journal fill levels tested (records appended before the operation, covers compaction into both pages)
+#define POWERCUT_MAX_REPORTS 10     // Maximum number of failures reported in detail
+
+/* TYPE DEFINITIONS AND ENUMERATIONS */
+
+typedef enum { // Operations interrupted by power cuts
+    POWERCUT_OP_PRIORITY,           // Change the boot priority
+    POWERCUT_OP_VERIFICATION,       // Change the verification mode
+    POWERCUT_OP_WRITE_INFO,         // Write application 2 info (new version)
+    POWERCUT_OP_BOOT,               // Boot (verification records and boot tick marks)
+    POWERCUT_OPS
+} PowerCutOp_T;
+
+/* GLOBAL VARIABLES */
+static const char *const powerCutOpNames[POWERCUT_OPS] = {"priority", "verification", "write info", "boot"}; // Operation names
+static uint32_t powerCutFailures; // Failed power cuts
+
+/* FUNCTIONS */
+
+static uint8_t powerCutRunOp(PowerCutOp_T op, SimAppState_T state) { // Run an operation from state (1 if it completed)
+    SimResult_T result;
+    if (op == POWERCUT_OP_PRIORITY) {
+        return (simAppSetSetting(SIM_SETTING_PRIORITY, (state.priority + 1) % 3, &result) == BL_OK) && (result.event == SIM_EVENT_RETURNED);
+    }
+    if (op == POWERCUT_OP_VERIFICATION) {
+        VerificationMode_T mode = (state.verification == VERIFICATION_APPLICATION) ? VERIFICATION_FULL : VERIFICATION_APPLICATION;
+        return (simAppSetSetting(SIM_SETTING_VERIFICATION, mode, &result) == BL_OK) && (result.event == SIM_EVENT_RETURNED);
+    }
+    if (op == POWERCUT_OP_WRITE_INFO) {
+        AppInfo_T info = state.appInfo[1];
+        info.version++;
+        return (simAppWriteInfo(2, info, &result) == BL_OK) && (result.event == SIM_EVENT_RETURNED);
+    }
+    result = simBoot();
+    return result.event == SIM_EVENT_APP_STARTED;
+}
+
+static void powerCutFail(PowerCutOp_T op, uint32_t fill, uint32_t cut, const char *reason) { // Record a failed power cut
+    if (powerCutFailures < POWERCUT_MAX_REPORTS) {
+        fprintf(stderr, "powercut: %s, %u records appended, power cut in flash operation %u: %s\n", powerCutOpNames[op], fill, cut, reason);
+    }
+    powerCutFailures++;
+}
+
+static uint32_t powerCutCheck(PowerCutOp_T op, uint32_t fill, const uint8_t *snapshot) { // Cut power at every flash operation of op from the flash contents in snapshot (returns the number of power cuts)
+    // Uninterrupted run (reference for the old and new state and the number of flash operations)
+    simFlashLoad(snapshot);
+    simReset(SIM_RESET_POWER);
+    SimAppState_T oldState = simAppGetState();
+    simFlashResetStats();
+    if (!powerCutRunOp(op, oldState)) {
+        powerCutFail(op, fill, 0, "operation failed without a power cut");
+        return 0;
+    }
+    uint32_t operations = simFlashGetStats().operations;
+    SimAppState_T newState = simAppGetState();
+
+    for (uint32_t cut = 1; cut <= operations; cut++) {
+        simFlashLoad(snapshot);
+        simReset(SIM_RESET_POWER);
+        simFlashSetPowerCut(cut);
+        powerCutRunOp(op, oldState);
+        simFlashSetPowerCut(0);
+
+        simReset(SIM_RESET_POWER); // Power returns
+        if (simBootSlot(simBoot()) == 0) {
+            powerCutFail(op, fill, cut, "no application started");
+            continue;
+        }
+        SimAppState_T state = simAppGetState();
+        if ((memcmp(&state, &oldState, sizeof(state)) != 0) && (memcmp(&state, &newState, sizeof(state)) != 0)) {
+            powerCutFail(op, fill, cut, "settings are neither the old nor the new settings");
+            continue;
+        }
+
+        // Bootloader data must still be writable
+        if (simAppSetSetting(SIM_SETTING_WATCHDOG, state.watchdog, NULL) != BL_OK) {
+            powerCutFail(op, fill, cut, "bootloader data write failed after power returned");
+            continue;
+        }
+        SimAppState_T rewritten = simAppGetState();
+        if (memcmp(&state, &rewritten, sizeof(state)) != 0) {
+            powerCutFail(op, fill, cut, "settings changed by a bootloader data write after power returned");
+        }
+    }
+    return operations;
+}
+
+int simPowerCut() { // Cut power at every flash operation of bootloader data updates and boots, checking that settings are never lost (run on blank flash)
+    uint32_t flashSize = simFlashSize();
+    uint8_t *snapshot = malloc(flashSize);
+    uint8_t *image = simAlloc(POWERCUT_APP_SIZE);
+    if ((snapshot == NULL) || (image == NULL)) {
+        fprintf(stderr, "powercut: out of memory\n");
+        free(snapshot);
+        return -1;
+    }
+
+    // Both application spaces hold a valid application, boots verify them
+    simFlashEraseAll();
+    simReset(SIM_RESET_POWER);
+    simBoot(); // First boot initialises bootloader data
+    for (uint8_t slot = 1; slot <= 2; slot++) {
+        simAppFillImage(image, slot, POWERCUT_APP_SIZE, slot);
+        if (simAppInstall(slot, image, simAppGetInfo(image, POWERCUT_APP_SIZE, 1, slot)).status != BL_OK) {
+            fprintf(stderr, "powercut: install of application %u failed\n", slot);
+            free(snapshot);
+            return -1;
+        }
+    }
+    simAppSetSetting(SIM_SETTING_VERIFICATION, VERIFICATION_APPLICATION, NULL);
+    simAppSetSetting(SIM_SETTING_FASTBOOT, FASTBOOT_ON, NULL); // Boots also append fast boot marks
+    simReset(SIM_RESET_POWER);
+    simBoot();
+
+    powerCutFailures = 0;
+    uint32_t cuts = 0;
+    for (uint32_t fill = 0; fill < POWERCUT_FILL_LEVELS; fill++) {
+        simFlashSave(snapshot);
+        for (PowerCutOp_T op = 0; op < POWERCUT_OPS; op++) { // Each operation from the same fill level
+            cuts += powerCutCheck(op, fill, snapshot);
+        }
+
+        // Next fill level (one more record in the journal)
+        simFlashLoad(snapshot);
+        simReset(SIM_RESET_POWER);
+        simAppSetSetting(SIM_SETTING_WATCHDOG, simAppGetState().watchdog, NULL);
+    }
+
+    free(snapshot);
+    printf("powercut: %u power cuts over %u journal fill levels, %u failures\n", cuts, (uint32_t) POWERCUT_FILL_LEVELS, powerCutFailures);
+    return (powerCutFailures == 0) ? 0 : -1;
+}
@@ -0,0 +1,194 @@
+/*
+STM32G0 Bootloader
+Jonah Swain
+
+Host simulator USART (implementation)
+Simulated USART2 with DMA1 channel 1 circular reception, the SysTick and TIM2 timers, and the host end of the recovery transport (uploads paced by the baud rate and flow controlled by block acknowledgements)
+*/
+
+/* DEPENDENCIES */
+#include <string.h>
+#include "host_sim.h"
+#include "recovery.h"               // Recovery transport protocol
+
+/* CONSTANT DEFINITIONS AND MACROS */
+#define USART_TDR_EMPTY 0xFFFFFFFFU // Transmit data register value when no byte is waiting to be sent (bytes written are collected by the next register access)
+
+/* GLOBAL VARIABLES */
+GPIO_TypeDef simGPIOA; // Simulated GPIOA registers
+DMAMUX_Channel_TypeDef simDMAMUX1_Channel0; // Simulated DMAMUX channel 0 registers (DMA1 channel 1 requests)
+
+static DMA_Channel_TypeDef dmaChannel1; // Simulated DMA1 channel 1 registers
+static USART_TypeDef usart2; // Simulated USART2 registers
+static SysTick_Type sysTick; // Simulated SysTick registers
+static TIM_TypeDef tim2; // Simulated TIM2 registers
+
+static uint8_t dmaRunning; // DMA channel enabled (seen by a register access)
+static uint32_t dmaReload; // Transfer count the channel was enabled with (reloaded when a circular transfer wraps)
+static uint8_t sysTickRunning; // SysTick enabled (seen by a register access)
+static uint64_t sysTickWrapped; // Cycle count of the last SysTick period boundary
+static uint8_t tim2Running; // TIM2 counting (seen by a register access)
+static uint64_t tim2Counted; // Cycle count up to which TIM2 has counted
+static uint64_t tim2Accessed; // Cycle count of the last TIM2 register access (registers written then take effect from it)
+
+static const uint8_t *uploadData; // Recovery upload the host end sends (NULL if the host is not connected)
+static uint32_t uploadLength; // Recovery upload length (bytes)
+static uint32_t uploadSent; // Bytes of the upload received by USART2
+static uint32_t uploadLimit; // Bytes of the upload the host may send (acknowledged blocks plus the window)
+static uint64_t segmentStart; // Cycle count at which the host started (or resumed) sending
+static uint32_t segmentIndex; // First upload byte sent from segmentStart
+static uint8_t uploadStarted; // Host has seen the bootloader ready and started sending
+static uint8_t resultExpected; // Next byte from the bootloader is the upload status
+static SimRecoveryResult_T recoveryResult; // Result of the upload as seen by the host
+
+/* FUNCTIONS */
+
+static uint64_t byteCycles() { // Simulated cycles per byte at the configured baud rate (start bit, 8 data bits, stop bit), 0 if not configured
+    uint32_t bitCycles2 = (usart2.CR1 & USART_CR1_OVER8) ? ((usart2.BRR & 0xFFF0) | ((usart2.BRR & 0x7) << 1)) : 2*usart2.BRR; // Twice the cycles per bit
+    return 5*(uint64_t) bitCycles2;
+}
+
+static void hostReceive(uint8_t byte) { // Host end of the recovery transport receives a byte from the bootloader
+    uint64_t now = simGetCycles() + byteCycles();
+    if (resultExpected) { // Upload status
+        resultExpected = 0;
+        recoveryResult.complete = 1;
+        recoveryResult.status = (BootloaderStatus_T) byte;
+        recoveryResult.endCycles = now;
+    } else if (byte == RECOVERY_READY && uploadData != NULL && !uploadStarted && !recoveryResult.complete) { // Start sending the upload
+        uploadStarted = 1;
+        uploadLimit = SIM_RECOVERY_WINDOW*RECOVERY_BLOCK_SIZE;
+        segmentStart = now + SIM_RECOVERY_HOST_LATENCY;
+        segmentIndex = 0;
+        recoveryResult.startCycles = now;
+    } else if (byte == RECOVERY_ACK && uploadStarted) { // Block written, the host may send one more
+        recoveryResult.acks++;
+        uint64_t resume = now + SIM_RECOVERY_HOST_LATENCY;
+        if (segmentStart + (uint64_t)(uploadLimit - segmentIndex)*byteCycles() < resume) { // Host was waiting for the acknowledgement
+            segmentStart = resume;
+            segmentIndex = uploadLimit;
+        }
+        uploadLimit += RECOVERY_BLOCK_SIZE;
+    } else if (byte == RECOVERY_RESULT) {
+        resultExpected = 1;
+    }
+}
+
+static void dmaReceive(uint8_t byte) { // USART2 receives a byte, moved to memory by DMA1 channel 1 if reception is set up (dropped otherwise)
+    if (!dmaRunning || !(usart2.CR1 & USART_CR1_UE) || !(usart2.CR1 & USART_CR1_RE) || !(usart2.CR3 & USART_CR3_DMAR) || dmaChannel1.CNDTR == 0) {
+        return;
+    }
+    uint8_t *memory = (uint8_t *) (uintptr_t) dmaChannel1.CMAR;
+    memory[dmaReload - dmaChannel1.CNDTR] = byte;
+    usart2.RDR = byte;
+    if (--dmaChannel1.CNDTR == 0 && (dmaChannel1.CCR & DMA_CCR_CIRC)) {
+        dmaChannel1.CNDTR = dmaReload; // Circular mode wraps to the start of the buffer
+    }
+}
+
+static void usartService() { // Let simulated time pass for a peripheral register access, collect a transmitted byte and deliver bytes received by now
+    simAdvanceCycles(SIM_CYCLES_PERIPHERAL_ACCESS);
+    usart2.ISR = USART_ISR_TC | USART_ISR_TXE_TXFNF; // Bytes are sent as soon as they are written
+    if (usart2.TDR != USART_TDR_EMPTY) {
+        if ((usart2.CR1 & USART_CR1_UE) && (usart2.CR1 & USART_CR1_TE)) {hostReceive((uint8_t) usart2.TDR);}
+        usart2.TDR = USART_TDR_EMPTY;
+    }
+
+    if ((dmaChannel1.CCR & DMA_CCR_EN) && !dmaRunning) { // Channel enabled since the last access
+        dmaRunning = 1;
+        dmaReload = dmaChannel1.CNDTR;
+    } else if (!(dmaChannel1.CCR & DMA_CCR_EN)) {
+        dmaRunning = 0;
+    }
+
+    uint64_t cycles = byteCycles();
+    while (uploadStarted && cycles && uploadSent < uploadLength && uploadSent < uploadLimit && segmentStart + (uint64_t)(uploadSent - segmentIndex + 1)*cycles <= simGetCycles()) {
+        dmaReceive(uploadData[uploadSent++]);
+    }
+}
+
+void simUsartReset() { // Reset USART2, DMA1 channel 1, SysTick and TIM2 (the host end is unaffected)
+    memset(&simGPIOA, 0, sizeof(simGPIOA));
+    memset(&simDMAMUX1_Channel0, 0, sizeof(simDMAMUX1_Channel0));
+    memset(&dmaChannel1, 0, sizeof(dmaChannel1));
+    memset(&usart2, 0, sizeof(usart2));
+    memset(&sysTick, 0, sizeof(sysTick));
+    memset(&tim2, 0, sizeof(tim2));
+    usart2.TDR = USART_TDR_EMPTY;
+    tim2.ARR = 0xFFFFFFFF;
+    dmaRunning = 0;
+    sysTickRunning = 0;
+    tim2Running = 0;
+    tim2Accessed = simGetCycles();
+}
+
+void simUsartUpload(const uint8_t *data, uint32_t length) { // Connect the host end with a recovery upload to send when the bootloader is ready (NULL to disconnect)
+    uploadData = data;
+    uploadLength = length;
+    uploadSent = 0;
+    uploadLimit = 0;
+    uploadStarted = 0;
+    resultExpected = 0;
+    memset(&recoveryResult, 0, sizeof(recoveryResult));
+}
+
+SimRecoveryResult_T simUsartGetResult() { // Result of the recovery upload as seen by the host end
+    recoveryResult.sent = uploadSent;
+    return recoveryResult;
+}
+
+DMA_Channel_TypeDef *simDmaChannel1(void) { // DMA1 channel 1 registers (delivers bytes received by USART2 up to the current simulated time)
+    usartService();
+    if (uploadData == NULL || recoveryResult.complete) { // No host sending, polling for data would never end
+        simExit(SIM_EVENT_STALLED);
+    }
+    return &dmaChannel1;
+}
+
+USART_TypeDef *simUsart2(void) { // USART2 registers (collects transmitted bytes)
+    usartService();
+    return &usart2;
+}
+
+SysTick_Type *simSysTick(void) { // SysTick registers (count flag set if a period has elapsed since the last access)
+    usartService();
+    uint64_t now = simGetCycles();
+    if (!(sysTick.CTRL & SysTick_CTRL_ENABLE_Msk)) {
+        sysTickRunning = 0;
+    } else if (!sysTickRunning) { // Enabled since the last access
+        sysTickRunning = 1;
+        sysTickWrapped = now;
+    } else {
+        uint64_t period = (uint64_t) sysTick.LOAD + 1;
+        if (now - sysTickWrapped >= period) {
+            sysTick.CTRL |= SysTick_CTRL_COUNTFLAG_Msk;
+            sysTickWrapped += ((now - sysTickWrapped)/period)*period;
+        } else {
+            sysTick.CTRL &= ~SysTick_CTRL_COUNTFLAG_Msk; // Cleared by the previous read
+        }
+    }
+    return &sysTick;
+}
+
+TIM_TypeDef *simTim2(void) { // TIM2 registers (counter advanced by the cycles elapsed since the last access while enabled and clocked)
+    uint64_t now = simGetCycles(); // Register accesses take no simulated time (not a polling loop)
+    if (tim2.EGR & TIM_EGR_UG) { // Update event (counter cleared, self-clearing bit)
+        tim2.EGR = 0;
+        tim2.CNT = 0;
+        tim2Counted = tim2Accessed;
+    }
+    if (!(tim2.CR1 & TIM_CR1_CEN) || !(RCC->APBENR1 & RCC_APBENR1_TIM2EN)) {
+        tim2Running = 0;
+    } else if (!tim2Running) { // Enabled by the last access
+        tim2Running = 1;
+        tim2Counted = tim2Accessed;
+    }
+    if (tim2Running) {
+        uint64_t prescaler = (uint64_t) tim2.PSC + 1;
+        uint64_t ticks = (now - tim2Counted)/prescaler;
+        tim2.CNT = (uint32_t) ((tim2.CNT + ticks) % ((uint64_t) tim2.ARR + 1));
+        tim2Counted += ticks*prescaler;
+    }
+    tim2Accessed = now;
+    return &tim2;
+}
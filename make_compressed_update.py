@@ -0,0 +1,110 @@
+# STM32G0 Bootloader
+# Jonah Swain
+# Python script to compress application binaries into compressed update images
+
+# === DEPENDENCIES ===
+import sys
+import struct
+import binascii
+
+# === GLOBAL VARIABLES ===
+vector_table_size = 47 # Application vector table length (words/entries) (STM32G071: 16 Cortex-M entries + 31 peripheral entries)
+
+image_magic = 0x5A444C42 # Image header magic number ("BLDZ", COMPRESSED_IMAGE_MAGIC in bootloader_common.h)
+min_match = 4 # Shortest match (COMPRESSED_MIN_MATCH)
+max_offset = 0xFFFF # Furthest match (16-bit offset, the bootloader reads matches back from the application space, so no RAM window limits it)
+max_candidates = 256 # Positions checked for each match (most recent first)
+
+# === FUNCTIONS ====
+
+def pad(binary): # Pad binary for double-word alignment (as make_update_header.py does)
+    if (len(binary) % 8):
+        binary += b'\xff'*(8 - (len(binary) % 8))
+    return binary
+
+def length_bytes(length): # Length extension bytes (after a token field of 15)
+    extension = bytearray()
+    length -= 15
+    while (length >= 255):
+        extension.append(255)
+        length -= 255
+    extension.append(length)
+    return extension
+
+def sequence(literals, match_length, offset): # Encode a sequence (literals, then a match unless match_length is 0)
+    literal_field = min(len(literals), 15)
+    match_field = min(match_length - min_match, 15) if (match_length) else 0
+    encoded = bytearray([(literal_field << 4) | match_field])
+    if (literal_field == 15):
+        encoded += length_bytes(len(literals))
+    encoded += literals
+    if (match_length):
+        encoded += struct.pack("<H", offset)
+        if (match_field == 15):
+            encoded += length_bytes(match_length - min_match)
+    return encoded
+
+def find_match(binary, pos, chains): # Longest earlier match for binary from pos (length, offset)
+    best_length = 0
+    best_offset = 0
+    for candidate in reversed(chains.get(binary[pos:pos + min_match], [])[-max_candidates:]):
+        if (pos - candidate > max_offset):
+            break
+        length = min_match
+        while (pos + length < len(binary)) and (binary[candidate + length] == binary[pos + length]):
+            length += 1
+        if (length > best_length):
+            best_length = length
+            best_offset = pos - candidate
+    return best_length, best_offset
+
+def compress(binary): # Compress binary into LZ4-style sequences
+    chains = {} # Earlier positions of each match key
+    compressed = bytearray()
+    literals = bytearray()
+    pos = 0
+    while (pos < len(binary)):
+        length, offset = find_match(binary, pos, chains)
+        if (length >= min_match) and (pos + 1 < len(binary)): # Lazy matching (take a literal if the next match is longer)
+            chains.setdefault(binary[pos:pos + min_match], []).append(pos)
+            next_length, _ = find_match(binary, pos + 1, chains)
+            chains[binary[pos:pos + min_match]].pop()
+            if (next_length > length):
+                length = 0
+        if (length < min_match):
+            chains.setdefault(binary[pos:pos + min_match], []).append(pos)
+            literals.append(binary[pos])
+            pos += 1
+            continue
+
+        compressed += sequence(literals, length, offset)
+        literals = bytearray()
+        for i in range(pos, pos + length):
+            chains.setdefault(binary[i:i + min_match], []).append(i)
+        pos += length
+
+    if (literals): # Last sequence (literals only)
+        compressed += sequence(literals, 0, 0)
+    return compressed
+
+def main(): # Main function
+    # Check command line arguments
+    if (len(sys.argv) != 3):
+        print("Error: Incorrect command line arguments. Call the program as follows:\n python make_compressed_update.py <input_binary_file> <output_image_file>")
+        return
+
+    binfile = open(sys.argv[1], 'rb') # Open binary file
+    binary = pad(binfile.read()) # Read bytes from file (padded as installed)
+    binfile.close() # Close binary file
+
+    header = struct.pack("<4I", image_magic, len(binary), binascii.crc32(binary[0:4*vector_table_size]) & 0xFFFFFFFF, binascii.crc32(binary) & 0xFFFFFFFF) # Image header (CompressedImageHeader_T)
+    image = header + compress(binary)
+
+    imagefile = open(sys.argv[2], 'wb') # Open/create image file
+    imagefile.write(image) # Write image to file
+    imagefile.close() # Close image file
+    print("%s: %u bytes (%.1f%% of %u bytes)"%(sys.argv[2], len(image), 100.0*len(image)/len(binary), len(binary)))
+
+# === RUN ===
+if (__name__ == "__main__"):
+    main() # Run main function if file is being run as main
@@ -0,0 +1,117 @@
+# STM32G0 Bootloader
+# Jonah Swain
+# Python script to make delta update patches (the changes from an installed application binary to a new one)
+
+# === DEPENDENCIES ===
+import sys
+import struct
+import binascii
+
+# === GLOBAL VARIABLES ===
+vector_table_size = 47 # Application vector table length (words/entries) (STM32G071: 16 Cortex-M entries + 31 peripheral entries)
+
+patch_magic = 0x50444C42 # Patch header magic number ("BLDP", DELTA_PATCH_MAGIC in bootloader_common.h)
+op_end = 0x00 # End of patch (DELTA_OP_END)
+op_copy = 0x01 # Copy bytes from the old application (DELTA_OP_COPY, length and offset from the end of the previous copy)
+op_insert = 0x02 # Insert bytes from the patch (DELTA_OP_INSERT, length then the bytes)
+
+key_length = 4 # Bytes hashed to find matches in the old application
+min_match = 12 # Shortest match worth copying from a new position in the old application (a copy costs 3-6 bytes)
+min_continue = 4 # Shortest match worth copying where the previous copy left off (a copy costs 2 bytes)
+max_candidates = 64 # Positions checked for each key (most recent first)
+
+# === FUNCTIONS ====
+
+def pad(binary): # Pad binary for double-word alignment (as make_update_header.py does)
+    if (len(binary) % 8):
+        binary += b'\xff'*(8 - (len(binary) % 8))
+    return binary
+
+def varint(value): # Encode an unsigned variable-length integer (7 bits per byte, least significant first)
+    encoded = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if (value):
+            encoded.append(byte | 0x80)
+        else:
+            encoded.append(byte)
+            return encoded
+
+def zigzag(value): # Map a signed offset to an unsigned value (0, -1, 1, -2, ... to 0, 1, 2, 3, ...)
+    return (value << 1) if (value >= 0) else ((-value << 1) - 1)
+
+def match_length(old, old_pos, new, new_pos): # Length of the match between old from old_pos and new from new_pos
+    length = 0
+    limit = min(len(old) - old_pos, len(new) - new_pos)
+    while (length + 64 <= limit) and (old[old_pos + length:old_pos + length + 64] == new[new_pos + length:new_pos + length + 64]): # Compare in blocks
+        length += 64
+    while (length < limit) and (old[old_pos + length] == new[new_pos + length]):
+        length += 1
+    return length
+
+def make_patch(old, new): # Make the patch operations that turn old into new
+    index = {} # Positions of each key in the old application
+    for i in range(len(old) - key_length + 1):
+        index.setdefault(old[i:i + key_length], []).append(i)
+
+    ops = bytearray()
+    literal = bytearray() # Bytes to insert before the next copy
+    copy_end = 0 # Offset in the old application after the previous copy (where the patch applier is)
+    old_pos = 0 # Expected position in the old application (advances over inserted bytes, as most changes replace bytes)
+    new_pos = 0
+    while (new_pos < len(new)):
+        length = match_length(old, old_pos, new, new_pos) if (old_pos < len(old)) else 0
+        if (length < min_continue): # Look for a match elsewhere in the old application
+            best_length = 0
+            best_pos = old_pos
+            for candidate in reversed(index.get(new[new_pos:new_pos + key_length], [])[-max_candidates:]): # Longest match, nearest the expected position
+                candidate_length = match_length(old, candidate, new, new_pos)
+                if (candidate_length > best_length) or ((candidate_length == best_length) and (abs(candidate - old_pos) < abs(best_pos - old_pos))):
+                    best_length = candidate_length
+                    best_pos = candidate
+            if (best_length < min_match): # No match worth copying, insert the byte
+                literal.append(new[new_pos])
+                new_pos += 1
+                old_pos += 1
+                continue
+            length = best_length
+            old_pos = best_pos
+
+        if (literal):
+            ops += bytes([op_insert]) + varint(len(literal)) + literal
+            literal = bytearray()
+        ops += bytes([op_copy]) + varint(length) + varint(zigzag(old_pos - copy_end))
+        old_pos += length
+        new_pos += length
+        copy_end = old_pos
+
+    if (literal):
+        ops += bytes([op_insert]) + varint(len(literal)) + literal
+    ops.append(op_end)
+    return ops
+
+def main(): # Main function
+    # Check command line arguments
+    if (len(sys.argv) != 4):
+        print("Error: Incorrect command line arguments. Call the program as follows:\n python make_delta_update.py <installed_binary_file> <new_binary_file> <output_patch_file>")
+        return
+
+    oldfile = open(sys.argv[1], 'rb') # Open binary files
+    old = pad(oldfile.read()) # Read bytes from file (padded as installed)
+    oldfile.close()
+    newfile = open(sys.argv[2], 'rb')
+    new = pad(newfile.read())
+    newfile.close()
+
+    header = struct.pack("<6I", patch_magic, len(old), binascii.crc32(old) & 0xFFFFFFFF, len(new), binascii.crc32(new[0:4*vector_table_size]) & 0xFFFFFFFF, binascii.crc32(new) & 0xFFFFFFFF) # Patch header (DeltaPatchHeader_T)
+    patch = header + make_patch(old, new)
+
+    patchfile = open(sys.argv[3], 'wb') # Open/create patch file
+    patchfile.write(patch) # Write patch to file
+    patchfile.close() # Close patch file
+    print("%s: %u bytes (%.1f%% of %u bytes)"%(sys.argv[3], len(patch), 100.0*len(patch)/len(new), len(new)))
+
+# === RUN ===
+if (__name__ == "__main__"):
+    main() # Run main function if file is being run as main
@@ -0,0 +1,99 @@
+# STM32G0 Bootloader
+# Jonah Swain
+# Python script to upload an application binary or compressed update image to the bootloader recovery transport (USART2, the ST-LINK virtual COM port) (requires pyserial)
+
+# === DEPENDENCIES ===
+import sys
+import struct
+import binascii
+import serial
+
+# === GLOBAL VARIABLES ===
+vector_table_size = 47 # Application vector table length (words/entries) (STM32G071: 16 Cortex-M entries + 31 peripheral entries)
+
+baud_rate = 1000000 # USART2 baud rate (RECOVERY_BAUD_RATE in recovery.h)
+block_size = 2048 # Upload block, acknowledged once written (RECOVERY_BLOCK_SIZE)
+window = 2 # Blocks sent ahead of acknowledgements (the bootloader receive buffer holds two)
+timeout = 5 # Seconds to wait for a reply from the bootloader
+
+recovery_magic = 0x52444C42 # Upload header magic number ("BLDR", RECOVERY_MAGIC)
+recovery_ready = 0x52 # Bootloader waiting for an upload (RECOVERY_READY)
+recovery_ack = 0x06 # Block written (RECOVERY_ACK)
+recovery_result = 0x53 # Upload status follows (RECOVERY_RESULT)
+format_binary = 0 # Application binary (RECOVERY_FORMAT_BINARY)
+format_compressed = 1 # Compressed update image (RECOVERY_FORMAT_COMPRESSED)
+image_magic = 0x5A444C42 # Compressed update image header magic number ("BLDZ", COMPRESSED_IMAGE_MAGIC)
+
+# === FUNCTIONS ====
+
+def pad(binary): # Pad binary for double-word alignment (as make_update_header.py does)
+    if (len(binary) % 8):
+        binary += b'\xff'*(8 - (len(binary) % 8))
+    return binary
+
+def read_byte(port): # Read a byte from the bootloader (None on timeout)
+    byte = port.read(1)
+    return byte[0] if (byte) else None
+
+def main(): # Main function
+    # Check command line arguments
+    if (len(sys.argv) != 6):
+        print("Error: Incorrect command line arguments. Call the program as follows:\n python recovery_upload.py <serial_port> <application_space> <binary_or_compressed_image_file> <app_id> <app_version>")
+        return
+
+    datafile = open(sys.argv[3], 'rb') # Open binary or image file
+    data = datafile.read() # Read bytes from file
+    datafile.close() # Close file
+
+    if (len(data) >= 16) and (struct.unpack_from("<I", data)[0] == image_magic): # Compressed update image, application size and checksums from its header
+        upload_format = format_compressed
+        size, vtcrc32, appcrc32 = struct.unpack_from("<3I", data, 4)
+    else:
+        upload_format = format_binary
+        data = pad(data)
+        size = len(data)
+        vtcrc32 = binascii.crc32(data[0:4*vector_table_size]) & 0xFFFFFFFF
+        appcrc32 = binascii.crc32(data) & 0xFFFFFFFF
+
+    header = struct.pack("<IBB2xI5I", recovery_magic, int(sys.argv[2]), upload_format, len(data), int(sys.argv[4], 0), int(sys.argv[5], 0), size, vtcrc32, appcrc32) # Upload header (RecoveryHeader_T)
+    header += struct.pack("<I", binascii.crc32(header) & 0xFFFFFFFF)
+    upload = header + data
+
+    port = serial.Serial(sys.argv[1], baud_rate, timeout=timeout) # Open serial port
+    print("Waiting for the bootloader (reset the device if no application can start)...")
+    port.timeout = None
+    while (read_byte(port) != recovery_ready):
+        pass
+    port.timeout = timeout
+
+    # Send the upload, keeping at most window blocks ahead of the blocks written
+    sent = 0
+    acknowledged = 0
+    status = None
+    while (status is None):
+        limit = min(len(upload), (acknowledged + window)*block_size)
+        if (sent < limit):
+            port.write(upload[sent:limit])
+            sent = limit
+            continue
+
+        byte = read_byte(port)
+        if (byte == recovery_ack):
+            acknowledged += 1
+            print("\r%u/%u bytes written"%(min(acknowledged*block_size, len(upload)), len(upload)), end='')
+        elif (byte == recovery_result):
+            status = read_byte(port)
+        elif (byte is None):
+            print("\nError: No reply from the bootloader")
+            port.close()
+            return
+    port.close()
+
+    if (status == 0):
+        print("\nApplication installed in application space %s (%s, %u bytes), the device is resetting"%(sys.argv[2], "compressed" if (upload_format == format_compressed) else "binary", size))
+    else:
+        print("\nError: Upload failed with bootloader status %s"%(status))
+
+# === RUN ===
+if (__name__ == "__main__"):
+    main() # Run main function if file is being run as main